@@ -52,6 +52,9 @@
  If everything is OK, the command displays:
  SNMPv2-MIB::sysContact.0 = STRING: patricklaf
 
+ sysContact.0, sysName.0 and sysLocation.0 are persisted in EEPROM by a
+ journal. Values set are restored after a reset.
+
  snmpbulkget -v 2c -c public -Cn1 -Cr2 192.168.2.2 sysDescr sysUpTime
 
  If everything is OK, the command displays:
@@ -93,10 +96,69 @@ EthernetUDP udp;
 NetworkUDP udp;
 #endif
 
-#include <SNMP.h>
+#include <EEPROM.h>
+#include <SNMPJournal.h>
 
 SNMP::Agent snmp;
 
+// Block device over EEPROM
+// EEPROM bytes are erased one by one, a block is half the device
+class EEPROMDevice: public SNMP::Device {
+public:
+    static constexpr uint32_t SIZE = 512;
+
+    void begin() {
+#if ARDUINO_ARCH_ESP32
+        EEPROM.begin(SIZE);
+#endif
+    }
+
+    virtual const uint32_t getSize() const {
+        return SIZE;
+    }
+
+    virtual const uint32_t getBlockSize() const {
+        return SIZE / 2;
+    }
+
+    virtual bool read(const uint32_t address, uint8_t *buffer, const uint32_t length) {
+        for (uint32_t index = 0; index < length; ++index) {
+            buffer[index] = EEPROM.read(address + index);
+        }
+        return true;
+    }
+
+    virtual bool write(const uint32_t address, const uint8_t *buffer, const uint32_t length) {
+        for (uint32_t index = 0; index < length; ++index) {
+            // Avoid useless writes
+            if (EEPROM.read(address + index) != buffer[index]) {
+                EEPROM.write(address + index, buffer[index]);
+            }
+        }
+        return commit();
+    }
+
+    virtual bool erase(const uint32_t address) {
+        for (uint32_t index = 0; index < SIZE / 2; ++index) {
+            if (EEPROM.read(address + index) != 0xFF) {
+                EEPROM.write(address + index, 0xFF);
+            }
+        }
+        return commit();
+    }
+
+private:
+    bool commit() {
+#if ARDUINO_ARCH_ESP32
+        return EEPROM.commit();
+#else
+        return true;
+#endif
+    }
+};
+
+EEPROMDevice device;
+
 // Use some SNMP classes
 using SNMP::IntegerBER;
 using SNMP::ObjectIdentifierBER;
@@ -254,18 +316,30 @@ public:
         return message;
     }
 
+    // Restore values persisted in journal
+    // Use default value if none
+    void begin(const char *contact, const char *name, const char *location) {
+        _journal.begin();
+        restore(OID::SYSCONTACT, &_contact, contact);
+        restore(OID::SYSNAME, &_name, name);
+        restore(OID::SYSLOCATION, &_location, location);
+    }
+
     // Setters
     void setContact(const char *contact) {
         update(&_contact, contact);
+        persist(OID::SYSCONTACT, contact);
     }
 
     void setLocation(const char *location) {
         update(&_location, location);
+        persist(OID::SYSLOCATION, location);
     }
 
     void setName(const char *name) {
         update(&_name, name);
-      }
+        persist(OID::SYSNAME, name);
+    }
 
 private:
     // Add a MIB node specified by its index as a variable binding to an SNMP message.
@@ -308,8 +382,8 @@ private:
         } else {
             // Set error status and index
             response->setError(SNMP::Error::WrongType, index + 1);
-            // Add OID to response with null value
-            response->add(varbind->getName());
+            // Move OID to response with null value
+            response->take(varbind, new SNMP::NullBER());
         }
     }
 
@@ -337,8 +411,8 @@ private:
                         response->setError(SNMP::Error::NoSuchName, index + 1);
                         break;
                     case SNMP::Version::V2C:
-                        // No such object
-                        response->add(name, new SNMP::NoSuchObjectBER());
+                        // Move OID to response with no such object value
+                        response->take(varbind, new SNMP::NoSuchObjectBER());
                         break;
                     }
                     break;
@@ -375,12 +449,12 @@ private:
                     case SNMP::Version::V1:
                         // Set error, status and index
                         response->setError(SNMP::Error::NoSuchName, index + 1);
-                        // Add OID to response with null value;
-                        response->add(name);
+                        // Move OID and null value to response
+                        response->take(varbind);
                         break;
                     case SNMP::Version::V2C:
-                        // End of MIB view
-                        response->add(name, new SNMP::EndOfMIBViewBER());
+                        // Move OID to response with end of MIB view value
+                        response->take(varbind, new SNMP::EndOfMIBViewBER());
                         break;
                     }
                     break;
@@ -388,8 +462,8 @@ private:
                     // OID is unknown
                     // Set error, status and index
                     response->setError(SNMP::Error::GenErr, index + 1);
-                    // Add OID to response with null value;
-                    response->add(name);
+                    // Move OID and null value to response
+                    response->take(varbind);
                     break;
                 default:
                     // Add next object of the MIB
@@ -437,15 +511,15 @@ private:
                     // OID is unknown
                     // Set error, status and index
                     response->setError(SNMP::Error::GenErr, index + 1);
-                    // Add OID to response with null value;
-                    response->add(name);
+                    // Move OID to response with null value
+                    response->take(varbind, new SNMP::NullBER());
                     break;
                 default:
                     // The object can not be set
                     // Set error, status and index
                     response->setError(SNMP::Error::NoAccess, index + 1);
-                    // Add OID to response with null value;
-                    response->add(name);
+                    // Move OID to response with null value
+                    response->take(varbind, new SNMP::NullBER());
                     break;
                 }
             }
@@ -497,6 +571,25 @@ private:
         *member = strdup(value);
     }
 
+    // Append value to journal
+    // Unchanged value is not written
+    void persist(const uint8_t id, const char *value) {
+        const size_t length = strlen(value);
+        _journal.put(id, value, length < 255 ? length : 255);
+    }
+
+    // Read value from journal
+    void restore(const uint8_t id, char **member, const char *value) {
+        char buffer[256];
+        const int16_t length = _journal.get(id, buffer, 255);
+        if (length >= 0) {
+            buffer[length] = 0;
+            update(member, buffer);
+        } else {
+            update(member, value);
+        }
+    }
+
     // Variables to hold value of MIB nodes
     const char* _descr = BOARD;
     const char* _objectID = nullptr;
@@ -504,6 +597,8 @@ private:
     char* _name = nullptr;
     char* _location = nullptr;
     uint32_t _snmpOutTraps = 0;
+    // Persistent storage of writable objects, identified by their OID index
+    SNMP::Journal<OID::COUNT> _journal { device };
 };
 
 MIB mib;
@@ -546,9 +641,8 @@ void setup() {
             IPAddress(255, 255, 255, 0), IPAddress(192, 168, 2, 1));
 #endif
     // MIB
-    mib.setContact("Patrick Lafarguette");
-    mib.setLocation("Home");
-    mib.setName(BOARD);
+    device.begin();
+    mib.begin("Patrick Lafarguette", BOARD, "Home");
     // SNMP
     snmp.begin(udp);
     snmp.onMessage(onMessage);
@@ -0,0 +1,541 @@
+/*
+ Benchmark
+
+ This sketch measures the cost of the library on the microcontroller itself:
+ CPU cycles, stack and heap of each operation.
+
+ No network is needed. Agent and manager exchange datagrams through a pair of
+ loopback UDP objects. Operations are:
+ - encode, build and encode a GETRESPONSE with 4 variable bindings,
+ - decode, decode a GETREQUEST with 4 variable bindings and dispatch it to an
+ empty handler,
+ - request, a GETREQUEST from the manager, answered by the agent and decoded
+ by the manager.
+
+ For each operation, the sketch outputs on serial:
+ - average count of CPU cycles,
+ - stack high-water, in bytes,
+ - heap in use while the operation runs, in bytes.
+
+ Heap is sampled in a first pass, cycles and stack are measured in a second
+ pass, so the sampling cost is not counted.
+
+ Cycles are counted by Timer1 on AVR, by the DWT cycle counter on Cortex-M,
+ or by SysTick where DWT is not available.
+
+ No board is needed either, the sketch runs under simulators.
+ - ATmega2560 with simavr, which is cycle-accurate:
+   arduino-cli compile -b arduino:avr:mega --output-dir build
+   simavr -m atmega2560 -f 16000000 build/Benchmark.ino.elf
+ - Cortex-M4 with QEMU, which does not emulate DWT. Cycles are read from
+   SysTick, one instruction per cycle with -icount:
+   arduino-cli compile -b STMicroelectronics:stm32:GenF4:pnum=GENERIC_F405RGTX --output-dir build
+   qemu-system-arm -M netduinoplus2 -nographic -icount shift=0 -kernel build/Benchmark.ino.elf
+
+ Compare the results with each library configuration (SNMP_STREAM,
+ SNMP_VECTOR, SNMP_CAPACITY). Configuration is output at startup.
+ */
+
+#if ARDUINO_ARCH_AVR
+#define BOARD "Mega 2560"
+#endif
+
+#if ARDUINO_ARCH_STM32
+#define BOARD "STM32"
+
+#include <malloc.h>
+#endif
+
+#if ARDUINO_ARCH_ESP32
+#define BOARD "ESP32-POE"
+#endif
+
+#ifndef BOARD
+#define BOARD "Unknown"
+
+#include <malloc.h>
+#endif
+
+#include <SNMP.h>
+
+#if ARDUINO_ARCH_AVR
+// Free list of avr-libc malloc
+struct __freelist {
+    size_t sz;
+    __freelist *nx;
+};
+
+extern "C" {
+extern char *__brkval;
+extern __freelist *__flp;
+}
+#endif
+
+// Use some SNMP classes
+using SNMP::Counter32BER;
+using SNMP::IntegerBER;
+using SNMP::ObjectIdentifierBER;
+using SNMP::OctetStringBER;
+using SNMP::VarBindList;
+
+// Count of iterations of each operation
+const uint16_t ITERATIONS = 100;
+
+// Maximum datagram size, as required by RFC 3417
+const uint16_t SIZE = 484;
+
+// Bytes painted below the stack pointer
+#if ARDUINO_ARCH_AVR
+const uint16_t DEPTH = 1024;
+#else
+const uint16_t DEPTH = 4096;
+#endif
+
+// This class implements a loopback UDP
+// Datagrams written to one object are read from its peer
+class Loopback: public UDP {
+public:
+    Loopback(const IPAddress address) :
+            _address(address) {
+    }
+
+    void connect(Loopback *peer) {
+        _peer = peer;
+    }
+
+    uint8_t begin(uint16_t port) {
+        _port = port;
+        return 1;
+    }
+
+    void stop() {
+    }
+
+    int beginPacket(IPAddress ip, uint16_t port) {
+        // Peer has only one buffer, unread datagram is lost
+        _peer->_length = 0;
+        _peer->_ready = false;
+        return 1;
+    }
+
+    int beginPacket(const char *host, uint16_t port) {
+        return 0;
+    }
+
+    int endPacket() {
+        _peer->_remote = _address;
+        _peer->_remotePort = _port;
+        _peer->_ready = true;
+        return 1;
+    }
+
+    size_t write(uint8_t byte) {
+        if (_peer->_length < SIZE) {
+            _peer->_buffer[_peer->_length++] = byte;
+            return 1;
+        }
+        return 0;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) {
+        size_t count = 0;
+        while (size-- && write(*buffer++)) {
+            count++;
+        }
+        return count;
+    }
+
+    int parsePacket() {
+        if (_ready) {
+            _ready = false;
+            _position = 0;
+            return _length;
+        }
+        return 0;
+    }
+
+    int available() {
+        return _length - _position;
+    }
+
+    int read() {
+        return _position < _length ? _buffer[_position++] : -1;
+    }
+
+    int read(unsigned char *buffer, size_t length) {
+        size_t count = 0;
+        while ((count < length) && (_position < _length)) {
+            buffer[count++] = _buffer[_position++];
+        }
+        return count;
+    }
+
+    int read(char *buffer, size_t length) {
+        return read(reinterpret_cast<unsigned char*>(buffer), length);
+    }
+
+    int peek() {
+        return _position < _length ? _buffer[_position] : -1;
+    }
+
+    void flush() {
+    }
+
+    IPAddress remoteIP() {
+        return _remote;
+    }
+
+    uint16_t remotePort() {
+        return _remotePort;
+    }
+
+private:
+    IPAddress _address;
+    uint16_t _port = 0;
+    Loopback *_peer = nullptr;
+    uint8_t _buffer[SIZE];
+    uint16_t _length = 0;
+    uint16_t _position = 0;
+    bool _ready = false;
+    IPAddress _remote;
+    uint16_t _remotePort = 0;
+};
+
+#if ARDUINO_ARCH_AVR
+// Timer1 overflows
+volatile uint16_t overflows = 0;
+
+ISR(TIMER1_OVF_vect) {
+    overflows++;
+}
+#endif
+
+// This class counts CPU cycles
+class Cycles {
+public:
+    static void begin() {
+#if ARDUINO_ARCH_AVR
+        // Timer1 normal mode, no prescaler
+        TCCR1A = 0;
+        TCCR1B = _BV(CS10);
+        TIMSK1 = _BV(TOIE1);
+#elif ARDUINO_ARCH_STM32 && defined(DWT)
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+        // Counter does not run under emulators
+        volatile uint8_t wait = 100;
+        while (wait--) {
+        }
+        _dwt = DWT->CYCCNT != 0;
+#endif
+    }
+
+    static uint32_t now() {
+#if ARDUINO_ARCH_AVR
+        uint8_t sreg = SREG;
+        cli();
+        uint16_t count = TCNT1;
+        uint32_t high = overflows;
+        if ((TIFR1 & _BV(TOV1)) && (count < 0x8000)) {
+            // Overflow not serviced yet
+            high++;
+        }
+        SREG = sreg;
+        return (high << 16) | count;
+#elif ARDUINO_ARCH_ESP32
+        return ESP.getCycleCount();
+#elif ARDUINO_ARCH_STM32
+#if defined(DWT)
+        if (_dwt) {
+            return DWT->CYCCNT;
+        }
+#endif
+        // SysTick reloads every millisecond
+        uint32_t tick;
+        uint32_t value;
+        do {
+            tick = HAL_GetTick();
+            value = SysTick->VAL;
+        } while (tick != HAL_GetTick());
+        const uint32_t load = SysTick->LOAD + 1;
+        return tick * load + (load - 1 - value);
+#else
+        return micros() * clockCyclesPerMicrosecond();
+#endif
+    }
+
+private:
+#if ARDUINO_ARCH_STM32 && defined(DWT)
+    static bool _dwt;
+#endif
+};
+
+#if ARDUINO_ARCH_STM32 && defined(DWT)
+bool Cycles::_dwt = false;
+#endif
+
+// This class measures the heap
+class Heap {
+public:
+    // End of the heap, nullptr if unknown
+    static uint8_t* end() {
+#if ARDUINO_ARCH_AVR
+        return reinterpret_cast<uint8_t*>(__brkval ? __brkval : __malloc_heap_start);
+#else
+        return nullptr;
+#endif
+    }
+
+    // Bytes allocated
+    static size_t used() {
+#if ARDUINO_ARCH_AVR
+        size_t freed = 0;
+        for (__freelist *block = __flp; block; block = block->nx) {
+            freed += block->sz + sizeof(size_t);
+        }
+        return (__brkval ? __brkval : __malloc_heap_start) - __malloc_heap_start - freed;
+#elif ARDUINO_ARCH_ESP32
+        return ESP.getHeapSize() - ESP.getFreeHeap();
+#else
+        return mallinfo().uordblks;
+#endif
+    }
+};
+
+// This class measures the stack high-water
+// Free stack below the caller is painted, then scanned for the deepest
+// byte overwritten
+class Stack {
+public:
+    static const uint8_t PAINT = 0xA5;
+    // Bytes kept for the frame of paint()
+    static const uint8_t GUARD = 64;
+
+    // Painting stops at limit, the highest end of the heap while the
+    // operation runs
+    static void __attribute__((noinline)) paint(uint8_t *top, uint8_t *limit) {
+        _top = top;
+        _bottom = _top - DEPTH;
+        if (limit > _bottom) {
+            _bottom = limit;
+        }
+        for (volatile uint8_t *pointer = _bottom; pointer < _top - GUARD; ++pointer) {
+            *pointer = PAINT;
+        }
+    }
+
+    static size_t used() {
+        uint8_t *pointer = _bottom;
+        while ((pointer < _top) && (*pointer == PAINT)) {
+            pointer++;
+        }
+        return _top - pointer;
+    }
+
+private:
+    static uint8_t *_top;
+    static uint8_t *_bottom;
+};
+
+uint8_t *Stack::_top = nullptr;
+uint8_t *Stack::_bottom = nullptr;
+
+// Loopback UDP objects for agent and manager
+Loopback agentUDP(IPAddress(127, 0, 0, 2));
+Loopback managerUDP(IPAddress(127, 0, 0, 1));
+
+SNMP::Agent agent;
+SNMP::Manager manager;
+
+// OIDs
+const char *DESCRIPTION = "1.3.6.1.2.1.1.1.0";
+const char *OBJECTID = "1.3.6.1.2.1.1.2.0";
+const char *SERVICES = "1.3.6.1.2.1.1.7.0";
+const char *INOCTETS = "1.3.6.1.2.1.2.2.1.10.1";
+
+const char *ENTERPRISE = "1.3.6.1.4.1.121";
+
+// Encoded GETREQUEST
+uint8_t request[SIZE];
+uint32_t length = 0;
+
+// Agent answers requests, or only decodes them
+bool answer = false;
+
+// Heap is sampled in the first pass only
+bool sampling = false;
+
+// Heap in use at start of the operation, peak and highest end
+size_t base = 0;
+size_t peak = 0;
+uint8_t *ceiling = nullptr;
+
+// Heap is sampled where messages are alive
+void sample() {
+    if (!sampling) {
+        return;
+    }
+    size_t used = Heap::used();
+    if (used > peak) {
+        peak = used;
+    }
+    uint8_t *end = Heap::end();
+    if (end > ceiling) {
+        ceiling = end;
+    }
+}
+
+SNMP::Message* request4() {
+    SNMP::Message *message = new SNMP::Message(SNMP::Version::V2C, "public", SNMP::Type::GetRequest);
+    message->setRequestID(0x1234);
+    message->add(DESCRIPTION);
+    message->add(OBJECTID);
+    message->add(SERVICES);
+    message->add(INOCTETS);
+    return message;
+}
+
+SNMP::Message* response4(const SNMP::Message *message) {
+    SNMP::Message *response = new SNMP::Message(message->getVersion(),
+            message->getCommunity(), SNMP::Type::GetResponse);
+    response->setRequestID(message->getRequestID());
+    response->add(DESCRIPTION, new OctetStringBER("SNMP agent benchmark"));
+    response->add(OBJECTID, new ObjectIdentifierBER(ENTERPRISE));
+    response->add(SERVICES, new IntegerBER(72));
+    response->add(INOCTETS, new Counter32BER(123456789));
+    return response;
+}
+
+// Event handler to process SNMP messages on agent side
+void onAgentMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    sample();
+    if (answer) {
+        SNMP::Message *response = response4(message);
+        sample();
+        agent.send(response, remote, port);
+        delete response;
+    }
+}
+
+// Event handler to process SNMP messages on manager side
+void onManagerMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    sample();
+}
+
+// Operations
+void encode() {
+    SNMP::Message *message = request4();
+    SNMP::Message *response = response4(message);
+    sample();
+    agent.send(response, IPAddress(127, 0, 0, 1), SNMP::Port::SNMP);
+    delete response;
+    delete message;
+    // Discard datagram
+    managerUDP.parsePacket();
+}
+
+void decode() {
+    agent.loop();
+}
+
+void roundtrip() {
+    SNMP::Message *message = request4();
+    sample();
+    manager.send(message, IPAddress(127, 0, 0, 2), SNMP::Port::SNMP);
+    delete message;
+    agent.loop();
+    manager.loop();
+}
+
+// Datagram to decode is written outside of measure
+void inject() {
+    managerUDP.beginPacket(IPAddress(127, 0, 0, 2), SNMP::Port::SNMP);
+    managerUDP.write(request, length);
+    managerUDP.endPacket();
+}
+
+void measure(const char *name, void (*operation)(), const bool decoding) {
+    uint32_t cycles = 0;
+    size_t stack = 0;
+    size_t heap = 0;
+    // Warm up, first run is not measured
+    if (decoding) {
+        inject();
+    }
+    operation();
+    // Heap pass, not timed
+    sampling = true;
+    ceiling = Heap::end();
+    for (uint16_t iteration = 0; iteration < ITERATIONS; ++iteration) {
+        if (decoding) {
+            inject();
+        }
+        base = peak = Heap::used();
+        operation();
+        if (peak - base > heap) {
+            heap = peak - base;
+        }
+    }
+    sampling = false;
+    // Cycles and stack pass
+    for (uint16_t iteration = 0; iteration < ITERATIONS; ++iteration) {
+        if (decoding) {
+            inject();
+        }
+        uint8_t top;
+        Stack::paint(&top, ceiling);
+        const uint32_t start = Cycles::now();
+        operation();
+        cycles += Cycles::now() - start;
+        if (Stack::used() > stack) {
+            stack = Stack::used();
+        }
+    }
+    Serial.print(name);
+    Serial.print(": cycles ");
+    Serial.print(cycles / ITERATIONS);
+    Serial.print(", stack ");
+    Serial.print(stack);
+    Serial.print(", heap ");
+    Serial.println(heap);
+}
+
+void setup() {
+#if ARDUINO_ARCH_AVR
+    Serial.begin(115200);
+#else
+    Serial.begin(921600);
+#endif
+    // Configuration
+    Serial.print("Benchmark on ");
+    Serial.print(BOARD);
+    Serial.print(", SNMP_STREAM ");
+    Serial.print(SNMP_STREAM);
+    Serial.print(", SNMP_VECTOR ");
+    Serial.print(SNMP_VECTOR);
+    Serial.print(", SNMP_CAPACITY ");
+    Serial.println(SNMP_CAPACITY);
+    Cycles::begin();
+    // Loopback
+    agentUDP.connect(&managerUDP);
+    managerUDP.connect(&agentUDP);
+    // SNMP
+    agent.begin(agentUDP);
+    agent.onMessage(onAgentMessage);
+    manager.begin(managerUDP);
+    manager.onMessage(onManagerMessage);
+    // Request to decode
+    SNMP::Message *message = request4();
+    length = message->getSize(true);
+    message->build(request);
+    delete message;
+    // Operations
+    measure("encode", encode, false);
+    measure("decode", decode, true);
+    answer = true;
+    measure("request", roundtrip, false);
+}
+
+void loop() {
+}
@@ -0,0 +1,148 @@
+/*
+ LwIP
+
+ This sketch checks the lwIP transport through the loopback netif.
+
+ An agent and a manager run in the same sketch, each on its own LwIPUDP
+ object. The manager sends requests to 127.0.0.1, the agent answers with a
+ description longer than the write buffer of its transport, so the response
+ is only received if it is encoded straight to a pbuf. No network is needed.
+
+ lwIP must be built with LWIP_HAVE_LOOPIF and LWIP_NETIF_LOOPBACK. On Linux,
+ with lwIP and its unix port built with NO_SYS set to 1, the sketch
+ initializes lwIP and polls the loopback netif itself. On ESP32, the tcpip
+ thread of lwIP delivers the datagrams.
+
+ The sketch outputs on serial one line per failed check, then the count of
+ checks passed and failed.
+ */
+
+#include <SNMP.h>
+#include <SNMPLwIP.h>
+
+#include <lwip/init.h>
+#include <lwip/netif.h>
+#include <lwip/timeouts.h>
+
+#if defined(ESP32)
+#include <WiFi.h>
+#endif
+
+const char *DESCRIPTION = "SNMP agent over the lwIP raw API, answering through the loopback netif";
+
+// Queues 2 datagrams and writes up to 64 bytes with write()
+SNMP::LwIPUDP<2, 64> agentUDP;
+SNMP::LwIPUDP<2, 64> managerUDP;
+SNMP::Agent agent;
+SNMP::Manager manager;
+
+uint16_t passed = 0;
+uint16_t failed = 0;
+uint8_t responses = 0;
+bool described = false;
+
+void check(const char *name, const uint32_t value, const bool success) {
+    if (success) {
+        passed++;
+    } else {
+        failed++;
+        Serial.print("FAIL ");
+        Serial.print(name);
+        Serial.print(" ");
+        Serial.println(value);
+    }
+}
+
+// Answers each OID with the description
+void onAgentMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    SNMP::Message *response = new SNMP::Message(message->getVersion(),
+            message->getCommunity(), SNMP::Type::GetResponse);
+    response->setRequestID(message->getRequestID());
+    SNMP::VarBindList *varbindlist = message->getVarBindList();
+    for (uint8_t index = 0; index < varbindlist->count(); ++index) {
+        response->add((*varbindlist)[index]->getName(), new SNMP::OctetStringBER(DESCRIPTION));
+    }
+    agent.send(response, remote, port);
+    delete response;
+}
+
+// Counts responses and checks the description
+void onManagerMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    responses++;
+    SNMP::VarBind *varbind = (*message->getVarBindList())[0];
+    if (varbind && (varbind->getValue()->getType() == SNMP::Type::OctetString)) {
+        described = strcmp(static_cast<SNMP::OctetStringBER*>(varbind->getValue())->getValue(), DESCRIPTION) == 0;
+    }
+}
+
+// Sends a GETREQUEST of sysDescr to the agent
+bool request() {
+    SNMP::Message *message = new SNMP::Message(SNMP::Version::V2C, "public", SNMP::Type::GetRequest);
+    message->add("1.3.6.1.2.1.1.1.0");
+    const bool success = manager.send(message, IPAddress(127, 0, 0, 1), SNMP::Port::SNMP);
+    delete message;
+    return success;
+}
+
+// Delivers datagrams of the loopback netif
+void deliver() {
+#if NO_SYS
+    netif_poll_all();
+    sys_check_timeouts();
+#else
+    delay(10);
+#endif
+}
+
+// Lets agent and manager process the datagrams
+void pump() {
+    for (uint8_t index = 0; index < 4; ++index) {
+        deliver();
+        agent.loop();
+        manager.loop();
+    }
+}
+
+// Exchanges a request and its response longer than the write buffer
+void testExchange() {
+    check("lwip request", 0, request());
+    pump();
+    check("lwip response", responses, responses == 1);
+    check("lwip description", 0, described);
+}
+
+// Drops the datagrams beyond the queue of the agent
+void testOverflow() {
+    for (uint8_t index = 0; index < 3; ++index) {
+        request();
+    }
+    deliver();
+    check("lwip dropped", agentUDP.getDropped(), agentUDP.getDropped() == 1);
+    pump();
+    check("lwip queued", responses, responses == 3);
+}
+
+void setup() {
+    Serial.begin(115200);
+#if defined(ESP32)
+    // Starts lwIP and its tcpip thread
+    WiFi.mode(WIFI_STA);
+#elif NO_SYS
+    lwip_init();
+#endif
+    check("lwip agent begin", 0, agent.begin(agentUDP));
+    check("lwip manager begin", 0, manager.begin(managerUDP));
+    agent.onMessage(onAgentMessage);
+    manager.onMessage(onManagerMessage);
+    testExchange();
+    testOverflow();
+    agentUDP.stop();
+    managerUDP.stop();
+    Serial.print(passed);
+    Serial.print(" passed, ");
+    Serial.print(failed);
+    Serial.println(" failed");
+}
+
+void loop() {
+}
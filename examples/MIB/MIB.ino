@@ -0,0 +1,421 @@
+/*
+ MIB
+
+ This sketch measures how the cost of an agent grows with the size of its
+ MIB.
+
+ No network is needed. The manager and the agent exchange datagrams through
+ a Simulator. The agent serves a synthetic MIB of 10 to 1000000 objects, made
+ of the system scalars and of rows of tables with realistic indexes:
+ - ifTable, indexed by an integer,
+ - ipNetToMediaTable, indexed by an integer and an IP address,
+ - tcpConnTable, indexed by 2 IP addresses and 2 ports,
+ - vacmSecurityToGroupTable, indexed by an integer and a string.
+
+ Objects are stored as arrays of sub-identifiers, sorted. Two lookups are
+ compared:
+ - linear, a scan from the first object, as in the other examples,
+ - binary, a binary search.
+
+ For each MIB size and each lookup, the sketch outputs on serial:
+ - memory of the MIB per object, in bytes,
+ - average latency of a GETREQUEST, a GETNEXTREQUEST and a GETBULKREQUEST
+ of a random object, from the manager send to the response decoded, in
+ microseconds.
+
+ Sizes stop at the first MIB that does not fit in memory. Larger sizes need
+ a board with more RAM, like an ESP32 with PSRAM.
+ */
+
+#include <SNMPSimulator.h>
+
+// Use some SNMP classes
+using SNMP::Counter32BER;
+using SNMP::IntegerBER;
+using SNMP::OctetStringBER;
+using SNMP::VarBindList;
+
+// Count of requests of each type
+const uint16_t ITERATIONS = 100;
+
+// Maximum count of sub-identifiers of an OID
+const uint8_t DEPTH = 32;
+
+// Repetitions of GETBULKREQUEST
+const uint8_t REPETITIONS = SNMP_VECTOR ? 10 : SNMP_CAPACITY;
+
+const uint32_t SIZES[] = { 10, 100, 1000, 10000, 100000, 1000000 };
+
+SNMP::Simulator simulator;
+SNMP::SimulatedUDP managerUDP(simulator, IPAddress(10, 0, 0, 1));
+SNMP::SimulatedUDP agentUDP(simulator, IPAddress(10, 0, 0, 2));
+
+SNMP::Manager manager;
+SNMP::Agent agent;
+
+// Lookups
+struct Lookup {
+    enum : uint8_t {
+        Linear,
+        Binary,
+    };
+};
+
+const char *LOOKUPS[] = { "linear", "binary" };
+
+// This class implements a MIB of synthetic objects
+class MIB {
+public:
+    // Builds a MIB of count objects
+    bool begin(const uint32_t count) {
+        end();
+        // First pass counts sub-identifiers
+        _words = 0;
+        generate(count, false);
+        const uint32_t objects = count * sizeof(Object);
+        const uint32_t pool = _words * sizeof(uint32_t);
+        if ((objects / sizeof(Object) != count) || (objects > (size_t) -1) || (pool > (size_t) -1)) {
+            return false;
+        }
+        _objects = static_cast<Object*>(malloc(objects));
+        _pool = static_cast<uint32_t*>(malloc(pool));
+        if (!_objects || !_pool) {
+            end();
+            return false;
+        }
+        // Second pass stores objects, then sorts them
+        _words = 0;
+        generate(count, true);
+        _sorted = _pool;
+        qsort(_objects, _count, sizeof(Object), order);
+        return true;
+    }
+
+    void end() {
+        free(_objects);
+        free(_pool);
+        _objects = nullptr;
+        _pool = nullptr;
+        _count = 0;
+    }
+
+    uint32_t count() const {
+        return _count;
+    }
+
+    // Bytes of the MIB per object
+    uint32_t size() const {
+        return (_count * sizeof(Object) + _words * sizeof(uint32_t)) / _count;
+    }
+
+    // Formats OID of an object
+    void format(const uint32_t index, char *buffer) const {
+        const Object &object = _objects[index];
+        const uint32_t *subids = _pool + object._offset;
+        for (uint8_t subid = 0; subid < object._length; ++subid) {
+            buffer += sprintf(buffer, subid ? ".%lu" : "%lu", static_cast<unsigned long>(subids[subid]));
+        }
+    }
+
+    // Creates value of an object
+    SNMP::BER* value(const uint32_t index) const {
+        const Object &object = _objects[index];
+        const uint32_t last = _pool[object._offset + object._length - 1];
+        switch (object._type) {
+        case SNMP::Type::Counter32:
+            return new Counter32BER(index * 1000 + last);
+        case SNMP::Type::OctetString:
+            return new OctetStringBER("Synthetic object");
+        default:
+            return new IntegerBER(last);
+        }
+    }
+
+    // Index of the object, count if not found
+    uint32_t get(const uint8_t lookup, const uint32_t *subids, const uint8_t length) const {
+        const uint32_t index = search(lookup, subids, length);
+        if ((index < _count) && (compare(index, subids, length) == 0)) {
+            return index;
+        }
+        return _count;
+    }
+
+    // Index of the first object after OID, count if none
+    uint32_t next(const uint8_t lookup, const uint32_t *subids, const uint8_t length) const {
+        uint32_t index = search(lookup, subids, length);
+        if ((index < _count) && (compare(index, subids, length) == 0)) {
+            index++;
+        }
+        return index;
+    }
+
+private:
+    struct Object {
+        uint32_t _offset;
+        uint8_t _length;
+        uint8_t _type;
+    };
+
+    // Index of the first object not before OID
+    uint32_t search(const uint8_t lookup, const uint32_t *subids, const uint8_t length) const {
+        if (lookup == Lookup::Linear) {
+            uint32_t index = 0;
+            while ((index < _count) && (compare(index, subids, length) < 0)) {
+                index++;
+            }
+            return index;
+        }
+        uint32_t low = 0;
+        uint32_t high = _count;
+        while (low < high) {
+            const uint32_t middle = low + (high - low) / 2;
+            if (compare(middle, subids, length) < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+
+    int compare(const uint32_t index, const uint32_t *subids, const uint8_t length) const {
+        const Object &object = _objects[index];
+        return compare(_pool + object._offset, object._length, subids, length);
+    }
+
+    static int compare(const uint32_t *first, const uint8_t length1, const uint32_t *second, const uint8_t length2) {
+        for (uint8_t subid = 0; (subid < length1) && (subid < length2); ++subid) {
+            if (first[subid] != second[subid]) {
+                return first[subid] < second[subid] ? -1 : 1;
+            }
+        }
+        return length1 < length2 ? -1 : length1 > length2 ? 1 : 0;
+    }
+
+    // Objects are sorted with the pool of the MIB being built
+    static int order(const void *first, const void *second) {
+        const Object *object1 = static_cast<const Object*>(first);
+        const Object *object2 = static_cast<const Object*>(second);
+        return compare(_sorted + object1->_offset, object1->_length, _sorted + object2->_offset, object2->_length);
+    }
+
+    // Adds an object, or only counts its sub-identifiers
+    void emit(const uint32_t *subids, const uint8_t length, const uint8_t type, const bool store) {
+        if (store) {
+            Object &object = _objects[_count++];
+            object._offset = _words;
+            object._length = length;
+            object._type = type;
+            memcpy(_pool + _words, subids, length * sizeof(uint32_t));
+        }
+        _words += length;
+    }
+
+    // Scalars then rows of tables, one row of each table in turn
+    void generate(const uint32_t count, const bool store) {
+        uint32_t subids[DEPTH] = { 1, 3, 6, 1, 2, 1 };
+        uint32_t emitted = 0;
+        // system
+        for (uint32_t scalar = 1; (scalar <= 7) && (emitted < count); ++scalar, ++emitted) {
+            subids[6] = 1;
+            subids[7] = scalar;
+            subids[8] = 0;
+            emit(subids, 9, scalar == 3 ? SNMP::Type::Counter32 : scalar == 7 ? SNMP::Type::Integer : SNMP::Type::OctetString, store);
+        }
+        for (uint32_t row = 0; emitted < count; ++row) {
+            // ifTable, 1.3.6.1.2.1.2.2.1.column.ifIndex
+            for (uint32_t column = 1; (column <= 22) && (emitted < count); ++column, ++emitted) {
+                subids[6] = 2;
+                subids[7] = 2;
+                subids[8] = 1;
+                subids[9] = column;
+                subids[10] = row + 1;
+                emit(subids, 11, column == 2 ? SNMP::Type::OctetString : (column >= 10) && (column <= 21) ? SNMP::Type::Counter32 : SNMP::Type::Integer, store);
+            }
+            // ipNetToMediaTable, 1.3.6.1.2.1.4.22.1.column.ifIndex.ipAddress
+            for (uint32_t column = 1; (column <= 4) && (emitted < count); ++column, ++emitted) {
+                subids[6] = 4;
+                subids[7] = 22;
+                subids[8] = 1;
+                subids[9] = column;
+                subids[10] = row % 8 + 1;
+                address(subids + 11, 10, row);
+                emit(subids, 15, column == 2 ? SNMP::Type::OctetString : SNMP::Type::Integer, store);
+            }
+            // tcpConnTable, 1.3.6.1.2.1.6.13.1.column.localAddress.localPort.remoteAddress.remotePort
+            for (uint32_t column = 1; (column <= 5) && (emitted < count); ++column, ++emitted) {
+                subids[6] = 6;
+                subids[7] = 13;
+                subids[8] = 1;
+                subids[9] = column;
+                address(subids + 10, 192, 0);
+                subids[14] = 161;
+                address(subids + 15, 172, row);
+                subids[19] = 1024 + row % 60000;
+                emit(subids, 20, SNMP::Type::Integer, store);
+            }
+            // vacmSecurityToGroupTable, 1.3.6.1.6.3.16.1.2.1.column.securityModel.securityName
+            for (uint32_t column = 3; (column <= 5) && (emitted < count); ++column, ++emitted) {
+                uint32_t group[DEPTH] = { 1, 3, 6, 1, 6, 3, 16, 1, 2, 1, column, 3 };
+                char name[16];
+                const uint8_t length = sprintf(name, "user%lu", static_cast<unsigned long>(row));
+                group[12] = length;
+                for (uint8_t character = 0; character < length; ++character) {
+                    group[13 + character] = name[character];
+                }
+                emit(group, 13 + length, column == 3 ? SNMP::Type::OctetString : SNMP::Type::Integer, store);
+            }
+        }
+    }
+
+    // IP address of a row
+    static void address(uint32_t *subids, const uint8_t network, const uint32_t row) {
+        subids[0] = network;
+        subids[1] = (row >> 16) & 0xFF;
+        subids[2] = (row >> 8) & 0xFF;
+        subids[3] = row & 0xFF;
+    }
+
+    Object *_objects = nullptr;
+    uint32_t *_pool = nullptr;
+    uint32_t _count = 0;
+    uint32_t _words = 0;
+
+    static const uint32_t *_sorted;
+};
+
+const uint32_t *MIB::_sorted = nullptr;
+
+MIB mib;
+
+uint8_t lookup = Lookup::Binary;
+bool received = false;
+uint32_t seed = 1;
+
+// Parses an OID in sub-identifiers
+uint8_t parse(const char *name, uint32_t *subids) {
+    uint8_t length = 0;
+    while (*name && (length < DEPTH)) {
+        char *end;
+        subids[length++] = strtoul(name, &end, 10);
+        name = *end ? end + 1 : end;
+    }
+    return length;
+}
+
+void add(SNMP::Message *response, const uint32_t index, const char *name) {
+    if (index < mib.count()) {
+        char buffer[DEPTH * 11];
+        mib.format(index, buffer);
+        response->add(buffer, mib.value(index));
+    } else {
+        response->add(name, new SNMP::EndOfMIBViewBER());
+    }
+}
+
+// Event handler to process SNMP messages on agent side
+void onAgentMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    SNMP::Message *response = new SNMP::Message(message->getVersion(),
+            message->getCommunity(), SNMP::Type::GetResponse);
+    response->setRequestID(message->getRequestID());
+    VarBindList *varbindlist = message->getVarBindList();
+    for (uint8_t index = 0; index < varbindlist->count(); ++index) {
+        const char *name = (*varbindlist)[index]->getName();
+        uint32_t subids[DEPTH];
+        const uint8_t length = parse(name, subids);
+        switch (message->getType()) {
+        case SNMP::Type::GetRequest: {
+            const uint32_t found = mib.get(lookup, subids, length);
+            if (found < mib.count()) {
+                add(response, found, name);
+            } else {
+                response->add(name, new SNMP::NoSuchObjectBER());
+            }
+            break;
+        }
+        case SNMP::Type::GetNextRequest:
+            add(response, mib.next(lookup, subids, length), name);
+            break;
+        case SNMP::Type::GetBulkRequest: {
+            uint32_t next = mib.next(lookup, subids, length);
+            for (uint8_t repetition = 0; repetition < message->getMaxRepetition(); ++repetition) {
+                add(response, next, name);
+                if (++next > mib.count()) {
+                    break;
+                }
+            }
+            break;
+        }
+        }
+    }
+    agent.send(response, remote, port);
+    delete response;
+}
+
+// Event handler to process SNMP messages on manager side
+void onManagerMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    received = true;
+}
+
+// Average latency of a request type, in microseconds
+uint32_t measure(const uint8_t type) {
+    uint32_t total = 0;
+    for (uint16_t iteration = 0; iteration < ITERATIONS; ++iteration) {
+        // Random object
+        seed = seed * 1103515245 + 12345;
+        char name[DEPTH * 11];
+        mib.format((seed >> 8) % mib.count(), name);
+        SNMP::Message *request = new SNMP::Message(SNMP::Version::V2C, "public", type);
+        if (type == SNMP::Type::GetBulkRequest) {
+            request->setNonRepeaters(0);
+            request->setMaxRepetitions(REPETITIONS);
+        }
+        request->add(name);
+        received = false;
+        const unsigned long start = micros();
+        manager.send(request, IPAddress(10, 0, 0, 2), SNMP::Port::SNMP);
+        delete request;
+        while (!received) {
+            manager.loop();
+            agent.loop();
+            simulator.step();
+        }
+        total += micros() - start;
+    }
+    return total / ITERATIONS;
+}
+
+void setup() {
+    Serial.begin(115200);
+    simulator.begin();
+    manager.begin(managerUDP);
+    manager.onMessage(onManagerMessage);
+    agent.begin(agentUDP);
+    agent.onMessage(onAgentMessage);
+    for (uint8_t size = 0; size < sizeof(SIZES) / sizeof(SIZES[0]); ++size) {
+        if (!mib.begin(SIZES[size])) {
+            Serial.print(SIZES[size]);
+            Serial.println(" objects: out of memory");
+            break;
+        }
+        for (lookup = Lookup::Linear; lookup <= Lookup::Binary; ++lookup) {
+            Serial.print(mib.count());
+            Serial.print(" objects, ");
+            Serial.print(LOOKUPS[lookup]);
+            Serial.print(": ");
+            Serial.print(mib.size());
+            Serial.print(" bytes/object, get ");
+            Serial.print(measure(SNMP::Type::GetRequest));
+            Serial.print(" us, getnext ");
+            Serial.print(measure(SNMP::Type::GetNextRequest));
+            Serial.print(" us, getbulk ");
+            Serial.print(measure(SNMP::Type::GetBulkRequest));
+            Serial.println(" us");
+        }
+    }
+    mib.end();
+    simulator.end();
+}
+
+void loop() {
+}
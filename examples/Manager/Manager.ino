@@ -187,7 +187,15 @@ void onMessage(const SNMP::Message *message, const IPAddress remote, const uint1
     }
 }
 
-unsigned long start;
+// Event handler to send a request on timer expiration
+void onTimer(SNMP::Timer *timer) {
+    // Create message to query UPS and send it
+    SNMP::Message *message = ups.read();
+    snmp.send(message, IPAddress(192, 168, 2, 1), SNMP::Port::SNMP);
+    delete message;
+}
+
+SNMP::Timer timer(onTimer);
 
 void setup() {
 #if ARDUINO_ARCH_AVR
@@ -211,19 +219,12 @@ void setup() {
     // SNMP
     snmp.begin(udp);
     snmp.onMessage(onMessage);
-    // Start
-    start = millis();
+    // Send a request every second
+    snmp.schedule(timer, 1000, 1000);
 }
 
 void loop() {
-    // Manager loop function must be called to process incoming messages
+    // Manager loop function must be called to process incoming messages and
+    // timers
     snmp.loop();
-    // Send a request every second
-    if (millis() - start >= 1000) {
-        start = millis();
-        // Create message to query UPS and send it
-        SNMP::Message *message = ups.read();
-        snmp.send(message, IPAddress(192, 168, 2, 1), SNMP::Port::SNMP);
-        delete message;
-    }
 }
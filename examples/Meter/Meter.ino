@@ -0,0 +1,102 @@
+/*
+ Meter
+
+ This sketch estimates the time an agent spends in the Ethernet chip to decode
+ requests and encode responses.
+
+ No network is needed. The manager and the agent exchange datagrams through
+ a Simulator. The UDP of the agent is metered: calls and bytes are counted and
+ charged the costs of a chip profile.
+
+ For each profile, and for requests of 1 to 6 variable bindings, the sketch
+ outputs on serial:
+ - count of calls and bytes,
+ - estimated time to decode the request and to encode the response, in
+ microseconds.
+
+ Compare the results with SNMP_STREAM set to 1 and 0 in SNMPcfg.h.
+ */
+
+#include <SNMPMeter.h>
+#include <SNMPSimulator.h>
+
+SNMP::Simulator simulator;
+SNMP::SimulatedUDP managerUDP(simulator, IPAddress(10, 0, 0, 1));
+SNMP::SimulatedUDP agentUDP(simulator, IPAddress(10, 0, 0, 2));
+SNMP::MeteredUDP metered(agentUDP);
+
+SNMP::Manager manager;
+SNMP::Agent agent;
+
+const char *PROFILES[] = { "W5100", "W5500", "ENC28J60" };
+
+const char *OID = "1.3.6.1.2.1.1.1.0";
+
+bool received;
+
+// Event handler to process SNMP messages on agent side
+void onAgentMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    SNMP::Message *response = new SNMP::Message(message->getVersion(),
+            message->getCommunity(), SNMP::Type::GetResponse);
+    response->setRequestID(message->getRequestID());
+    SNMP::VarBindList *varbindlist = message->getVarBindList();
+    for (uint8_t index = 0; index < varbindlist->count(); ++index) {
+        response->add((*varbindlist)[index]->getName(),
+                new SNMP::OctetStringBER("Arduino SNMP agent"));
+    }
+    agent.send(response, remote, port);
+    delete response;
+}
+
+// Event handler to process SNMP messages on manager side
+void onManagerMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    received = true;
+}
+
+void measure(const uint8_t count) {
+    SNMP::Message *request = new SNMP::Message(SNMP::Version::V2C, "public",
+            SNMP::Type::GetRequest);
+    for (uint8_t index = 0; index < count; ++index) {
+        request->add(OID);
+    }
+    metered.reset();
+    received = false;
+    manager.send(request, IPAddress(10, 0, 0, 2), SNMP::Port::SNMP);
+    delete request;
+    while (!received) {
+        manager.loop();
+        agent.loop();
+        simulator.step();
+    }
+    Serial.print("  ");
+    Serial.print(count);
+    Serial.print(" varbind(s): calls ");
+    Serial.print(metered.getCalls());
+    Serial.print(", bytes ");
+    Serial.print(metered.getBytes());
+    Serial.print(", decode ");
+    Serial.print(metered.getReadTime());
+    Serial.print(" us, encode ");
+    Serial.print(metered.getWriteTime());
+    Serial.println(" us");
+}
+
+void setup() {
+    Serial.begin(115200);
+    simulator.begin();
+    manager.begin(managerUDP);
+    manager.onMessage(onManagerMessage);
+    agent.begin(metered);
+    agent.onMessage(onAgentMessage);
+    for (uint8_t chip = SNMP::Chip::W5100; chip <= SNMP::Chip::ENC28J60; ++chip) {
+        Serial.println(PROFILES[chip]);
+        metered.setProfile(chip);
+        for (uint8_t count = 1; count <= 6; ++count) {
+            measure(count);
+        }
+    }
+    simulator.end();
+}
+
+void loop() {
+}
@@ -0,0 +1,492 @@
+/*
+ SelfTest
+
+ This sketch checks the library on the board itself.
+
+ No network is needed. Each check encodes, decodes or stores values and
+ compares the results with the expected ones.
+
+ The sketch outputs on serial one line per failed check, then the count of
+ checks passed and failed.
+
+ Run the sketch with each library configuration (SNMP_STREAM, SNMP_VECTOR,
+ SNMP_CAPACITY).
+ */
+
+#include <SNMP.h>
+#include <SNMPAggregator.h>
+#include <SNMPDiscovery.h>
+#include <SNMPJournal.h>
+#include <SNMPPoller.h>
+#include <SNMPSimulator.h>
+
+uint16_t passed = 0;
+uint16_t failed = 0;
+
+void check(const char *name, const uint32_t value, const bool success) {
+    if (success) {
+        passed++;
+    } else {
+        failed++;
+        Serial.print("FAIL ");
+        Serial.print(name);
+        Serial.print(" ");
+        Serial.println(value);
+    }
+}
+
+// Encodes then decodes lengths in short and long forms
+void testLength() {
+    const unsigned int LENGTHS[] = { 0, 127, 128, 255, 256, 1000 };
+    const uint8_t SIZES[] = { 1, 1, 2, 2, 3, 3 };
+    for (uint8_t index = 0; index < sizeof(SIZES); ++index) {
+        const unsigned int value = LENGTHS[index];
+        uint8_t buffer[8] = { };
+        SNMP::Length length(value);
+        SNMP::Length decoded;
+#if SNMP_STREAM
+        SNMP::BufferStream output(buffer, sizeof(buffer));
+        length.encode(output);
+        const uint8_t size = output.getLength();
+        SNMP::BufferStream input(buffer, sizeof(buffer), size);
+        decoded.decode(input);
+        const bool consumed = input.available() == 0;
+#else
+        const uint8_t size = length.encode(buffer) - buffer;
+        const bool consumed = decoded.decode(buffer) == buffer + size;
+#endif
+        check("length size", value, size == SIZES[index]);
+        check("length form", value, buffer[0] == (value > 0x7F ? 0x80 | (SIZES[index] - 1) : value));
+        check("length value", value, static_cast<unsigned int>(decoded) == value);
+        check("length consumed", value, consumed);
+    }
+}
+
+// Encodes then decodes octet strings with long-form lengths
+void testOctetString() {
+    const unsigned int LENGTHS[] = { 100, 200, 300 };
+    for (uint8_t index = 0; index < 3; ++index) {
+        const unsigned int value = LENGTHS[index];
+        char *string = static_cast<char*>(malloc(value + 1));
+        uint8_t *buffer = static_cast<uint8_t*>(malloc(value + 4));
+        for (unsigned int character = 0; character < value; ++character) {
+            string[character] = 'A' + character % 26;
+        }
+        string[value] = 0;
+        SNMP::OctetStringBER ber(string);
+        const unsigned int size = ber.getSize();
+        SNMP::OctetStringBER decoded(nullptr, 0);
+#if SNMP_STREAM
+        SNMP::BufferStream output(buffer, value + 4);
+        ber.encode(output);
+        SNMP::BufferStream input(buffer, value + 4, size);
+        decoded.decode(input);
+#else
+        ber.encode(buffer);
+        decoded.decode(buffer);
+#endif
+        check("octet string size", value, size == value + (value > 0xFF ? 4 : value > 0x7F ? 3 : 2));
+        check("octet string value", value, strcmp(decoded.getValue(), string) == 0);
+        free(buffer);
+        free(string);
+    }
+}
+
+// Sizes and encodes opaques nested within and beyond SNMP_DEPTH
+void testDepth() {
+    const uint8_t LEVELS[] = { 3, SNMP_DEPTH + 2 };
+    for (uint8_t index = 0; index < 2; ++index) {
+        const uint8_t levels = LEVELS[index];
+        SNMP::BER *ber = new SNMP::IntegerBER(1);
+        for (uint8_t level = 0; level < levels; ++level) {
+            ber = new SNMP::OpaqueBER(ber);
+        }
+        const unsigned int size = ber->getSize(true);
+        uint8_t buffer[64];
+#if SNMP_STREAM
+        SNMP::BufferStream output(buffer, sizeof(buffer));
+        ber->encode(output);
+        const unsigned int encoded = output.getLength();
+#else
+        const unsigned int encoded = ber->encode(buffer) - buffer;
+#endif
+        check("depth size", levels, size == (levels < SNMP_DEPTH ? 2 * levels + 3 : 2 * SNMP_DEPTH));
+        check("depth encoded", levels, encoded == size);
+        delete ber;
+    }
+}
+
+// Block device in RAM
+class RAMDevice: public SNMP::Device {
+public:
+    static constexpr uint32_t SIZE = 1024;
+
+    RAMDevice() {
+        memset(_memory, 0xFF, SIZE);
+    }
+
+    virtual const uint32_t getSize() const {
+        return SIZE;
+    }
+
+    virtual const uint32_t getBlockSize() const {
+        return SIZE / 2;
+    }
+
+    virtual bool read(const uint32_t address, uint8_t *buffer, const uint32_t length) {
+        memcpy(buffer, _memory + address, length);
+        return true;
+    }
+
+    virtual bool write(const uint32_t address, const uint8_t *buffer, const uint32_t length) {
+        memcpy(_memory + address, buffer, length);
+        return true;
+    }
+
+    virtual bool erase(const uint32_t address) {
+        memset(_memory + address, 0xFF, SIZE / 2);
+        return true;
+    }
+
+private:
+    uint8_t _memory[SIZE];
+};
+
+// Stores, compares, scans and compacts records longer than 240 bytes
+void testJournal() {
+    const uint8_t LENGTH = 245;
+    RAMDevice *device = new RAMDevice();
+    uint8_t *value = static_cast<uint8_t*>(malloc(LENGTH));
+    uint8_t *buffer = static_cast<uint8_t*>(malloc(LENGTH));
+    for (uint8_t round = 0; round < 3; ++round) {
+        for (uint8_t index = 0; index < LENGTH; ++index) {
+            value[index] = index + round;
+        }
+        SNMP::Journal<2> journal(*device);
+        check("journal begin", round, journal.begin());
+        check("journal put", round, journal.put(0, value, LENGTH));
+        // Unchanged value is compared, not written
+        const uint32_t free = journal.getFree();
+        check("journal equal", round, journal.put(0, value, LENGTH) && (journal.getFree() == free));
+        SNMP::Journal<2> scanned(*device);
+        check("journal scan", round, scanned.begin());
+        check("journal get", round, (scanned.get(0, buffer, LENGTH) == LENGTH) && !memcmp(buffer, value, LENGTH));
+    }
+    free(buffer);
+    free(value);
+    delete device;
+}
+
+// Block device in RAM failing a write on demand, after its first byte
+class FailingDevice: public RAMDevice {
+public:
+    virtual bool write(const uint32_t address, const uint8_t *buffer, const uint32_t length) {
+        if (_fail) {
+            _fail = false;
+            RAMDevice::write(address, buffer, 1);
+            return false;
+        }
+        return RAMDevice::write(address, buffer, length);
+    }
+
+    bool _fail = false;
+};
+
+// Keeps the records put after a failed write
+void testJournalFailure() {
+    const uint8_t VALUES[] = { 10, 11, 12 };
+    FailingDevice *device = new FailingDevice();
+    SNMP::Journal<3> journal(*device);
+    check("journal failure begin", 0, journal.begin());
+    check("journal failure put", 0, journal.put(0, &VALUES[0], 1));
+    device->_fail = true;
+    check("journal failure write", 1, !journal.put(1, &VALUES[1], 1));
+    check("journal failure next", 2, journal.put(2, &VALUES[2], 1));
+    SNMP::Journal<3> scanned(*device);
+    uint8_t value = 0;
+    check("journal failure scan", 0, scanned.begin());
+    check("journal failure kept", 0, (scanned.get(0, &value, 1) == 1) && (value == VALUES[0]));
+    check("journal failure lost", 1, !scanned.has(1));
+    check("journal failure after", 2, (scanned.get(2, &value, 1) == 1) && (value == VALUES[2]));
+    delete device;
+}
+
+// Steps to the next timer deadline, then to the next delivery
+void testSimulator() {
+    SNMP::Simulator simulator;
+    SNMP::SimulatedUDP source(simulator, IPAddress(10, 0, 0, 1));
+    SNMP::SimulatedUDP destination(simulator, IPAddress(10, 0, 0, 2));
+    SNMP::Manager manager;
+    SNMP::Timer timer;
+    simulator.setLatency(300);
+    simulator.setResolution(10);
+    simulator.begin();
+    check("simulator add", 0, simulator.add(manager));
+    manager.begin(source);
+    destination.begin(161);
+    manager.schedule(timer, 5000);
+    simulator.step();
+    check("simulator timer", simulator.getTime(), simulator.getTime() == 5000);
+    manager.loop();
+    source.beginPacket(IPAddress(10, 0, 0, 2), 161);
+    source.write(0x30);
+    source.endPacket();
+    simulator.step();
+    check("simulator delivery", simulator.getTime(), (simulator.getTime() == 5300) && (destination.parsePacket() == 1));
+    simulator.step();
+    check("simulator idle", simulator.getTime(), simulator.getTime() == 5310);
+    simulator.end();
+}
+
+// Agent of the discovery test
+SNMP::Agent *discoveryAgent = nullptr;
+
+// Answers any request with the names requested
+void onDiscoveryMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    SNMP::Message *response = new SNMP::Message(message->getVersion(),
+            message->getCommunity(), SNMP::Type::GetResponse);
+    response->setRequestID(message->getRequestID());
+    SNMP::VarBindList *varbindlist = message->getVarBindList();
+    for (uint8_t index = 0; index < varbindlist->count(); ++index) {
+        response->add((*varbindlist)[index]->getName(), new SNMP::OctetStringBER("agent"));
+    }
+    discoveryAgent->send(response, remote, port);
+    delete response;
+}
+
+// Sweeps past a silent address without waiting for its timeout
+void testDiscovery() {
+    SNMP::Simulator simulator;
+    SNMP::SimulatedUDP managerUDP(simulator, IPAddress(10, 0, 0, 1));
+    SNMP::SimulatedUDP agentUDP(simulator, IPAddress(10, 1, 0, 0), IPAddress(255, 255, 255, 0));
+    SNMP::Manager manager;
+    SNMP::Agent agent;
+    SNMP::Discovery<4> discovery(manager);
+    // First address is silent, the others answer
+    const SNMP::Discovery<4>::Range RANGES[] = {
+            { IPAddress(10, 0, 255, 255), IPAddress(10, 1, 0, 16) },
+    };
+    const char *COMMUNITIES[] = { "public" };
+    discoveryAgent = &agent;
+    simulator.setLatency(10);
+    simulator.begin();
+    manager.begin(managerUDP);
+    agent.begin(agentUDP);
+    agent.onMessage(onDiscoveryMessage);
+    discovery.setTimeout(1000);
+    discovery.begin(RANGES, 1, COMMUNITIES, 1);
+    while (discovery.isRunning() && (discovery.getFound() < 16)) {
+        manager.loop();
+        agent.loop();
+        simulator.step();
+    }
+    check("discovery found", discovery.getFound(), discovery.getFound() == 16);
+    check("discovery time", simulator.getTime(), simulator.getTime() < 1000);
+    discovery.stop();
+    simulator.end();
+    discoveryAgent = nullptr;
+}
+
+// Compares content octets read by chunks with the encoding of a BER
+void checkContent(const char *name, SNMP::BER *ber) {
+    const unsigned int size = ber->getSize(true);
+    uint8_t *buffer = static_cast<uint8_t*>(malloc(size));
+#if SNMP_STREAM
+    SNMP::BufferStream stream(buffer, size);
+    ber->encode(stream);
+#else
+    ber->encode(buffer);
+#endif
+    const unsigned int length = ber->getLength();
+    const uint8_t *content = buffer + size - length;
+    bool same = true;
+    uint8_t chunk[5];
+    for (unsigned int offset = 0; offset < length; offset += sizeof(chunk)) {
+        const unsigned int count = length - offset < sizeof(chunk) ? length - offset : sizeof(chunk);
+        same &= (ber->getContent(chunk, sizeof(chunk), offset) == length) && !memcmp(chunk, content + offset, count);
+    }
+    check(name, length, same);
+    free(buffer);
+    delete ber;
+}
+
+// Reads content octets without encoding
+void testContent() {
+    char string[301];
+    memset(string, 'S', 300);
+    string[300] = 0;
+    checkContent("content integer", new SNMP::IntegerBER(-129));
+    checkContent("content zero", new SNMP::IntegerBER(0));
+    checkContent("content counter64", new SNMP::Counter64BER(0x0123456789ABCDEF));
+    checkContent("content octet string", new SNMP::OctetStringBER(string));
+    checkContent("content oid", new SNMP::ObjectIdentifierBER("1.3.6.1.4.1.99999.2147483647.127.128.0"));
+    checkContent("content ip address", new SNMP::IPAddressBER(IPAddress(192, 168, 2, 3)));
+    checkContent("content null", new SNMP::NullBER());
+}
+
+// Print to memory, destination of a checkpoint
+class Memory: public Print {
+public:
+    virtual size_t write(uint8_t byte) {
+        if (_length == sizeof(_buffer)) {
+            return 0;
+        }
+        _buffer[_length++] = byte;
+        return 1;
+    }
+
+    using Print::write;
+
+    uint8_t _buffer[96];
+    size_t _length = 0;
+};
+
+// Counter of the poller test
+uint32_t pollerCounter = 0;
+
+// Answers any request with a counter increasing steadily
+void onPollerMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    SNMP::Message *response = new SNMP::Message(message->getVersion(),
+            message->getCommunity(), SNMP::Type::GetResponse);
+    response->setRequestID(message->getRequestID());
+    SNMP::VarBindList *varbindlist = message->getVarBindList();
+    pollerCounter += 1000;
+    for (uint8_t index = 0; index < varbindlist->count(); ++index) {
+        response->add((*varbindlist)[index]->getName(), new SNMP::Counter32BER(pollerCounter));
+    }
+    discoveryAgent->send(response, remote, port);
+    delete response;
+}
+
+// Restores the state of a poller to another one
+void testPoller() {
+    const char *OID = "1.3.6.1.2.1.2.2.1.10.1";
+    SNMP::Simulator simulator;
+    SNMP::SimulatedUDP managerUDP(simulator, IPAddress(10, 0, 0, 1));
+    SNMP::SimulatedUDP agentUDP(simulator, IPAddress(10, 1, 0, 1));
+    SNMP::Manager manager;
+    SNMP::Agent agent;
+    SNMP::Poller<2> poller(manager);
+    discoveryAgent = &agent;
+    simulator.setLatency(10);
+    simulator.begin();
+    simulator.add(manager);
+    manager.begin(managerUDP);
+    agent.begin(agentUDP);
+    agent.onMessage(onPollerMessage);
+    poller.add(IPAddress(10, 1, 0, 1), OID);
+    poller.setBounds(1000, 60000);
+    poller.begin(SNMP::Version::V2C, "public");
+    // Counter wraps between the last 2 samples
+    pollerCounter = 0xFFFFFFFF - 3499;
+    while (poller.getSamples() < 4) {
+        manager.loop();
+        agent.loop();
+        simulator.step();
+    }
+    check("poller wrap", pollerCounter, (pollerCounter == 500) && (poller.getRate(0) > 0));
+    Memory memory;
+    const size_t size = manager.save(memory);
+    check("poller save", size, size && (size == memory._length));
+    SNMP::Manager restarted;
+    SNMP::Poller<2> restored(restarted);
+    restored.add(IPAddress(10, 1, 0, 1), OID);
+    restored.setBounds(1000, 60000);
+    restored.begin(SNMP::Version::V2C, "public");
+    check("poller restore", size, restarted.restore(memory._buffer, size));
+    check("poller interval", restored.getInterval(0), restored.getInterval(0) == poller.getInterval(0));
+    check("poller frequency", restored.getFrequency(0), restored.getFrequency(0) == poller.getFrequency(0));
+    check("poller rate", restored.getRate(0), restored.getRate(0) == poller.getRate(0));
+    check("poller samples", restored.getSamples(), restored.getSamples() == poller.getSamples());
+    poller.stop();
+    restored.stop();
+    simulator.end();
+    discoveryAgent = nullptr;
+}
+
+// Agent MIB reached by a request the aggregator leaves
+bool aggregatorReached = false;
+
+// Name of the first variable binding of the last response
+char aggregatorName[64];
+
+// Answers sysDescr.0 as the agent MIB would
+void onAggregatorMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    aggregatorReached = true;
+    SNMP::Message *response = new SNMP::Message(message->getVersion(),
+            message->getCommunity(), SNMP::Type::GetResponse);
+    response->setRequestID(message->getRequestID());
+    response->add("1.3.6.1.2.1.1.2.0", new SNMP::OctetStringBER("agent"));
+    discoveryAgent->send(response, remote, port);
+    delete response;
+}
+
+// Stores the name of the first variable binding
+void onAggregatorResponse(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    strncpy(aggregatorName, (*message->getVarBindList())[0]->getName(), sizeof(aggregatorName) - 1);
+}
+
+// Sends a GETNEXTREQUEST and returns the name of the response
+const char* getNext(SNMP::Simulator &simulator, SNMP::Manager &manager, SNMP::Agent &agent, const char *name) {
+    SNMP::Message *message = new SNMP::Message(SNMP::Version::V2C, "public", SNMP::Type::GetNextRequest);
+    message->setRequestID(1);
+    message->add(name);
+    manager.send(message, IPAddress(10, 0, 0, 2), SNMP::Port::SNMP);
+    delete message;
+    aggregatorName[0] = 0;
+    aggregatorReached = false;
+    for (uint8_t step = 0; (step < 8) && !aggregatorName[0]; ++step) {
+        simulator.step();
+        agent.loop();
+        manager.loop();
+    }
+    return aggregatorName;
+}
+
+// Walks the agent MIB through an aggregator
+void testAggregator() {
+    const IPAddress TARGETS[] = { IPAddress(10, 2, 0, 1) };
+    const char *OIDS[] = { "1.3.6.1.2.1.2.2.1.10.1" };
+    SNMP::Simulator simulator;
+    SNMP::SimulatedUDP managerUDP(simulator, IPAddress(10, 0, 0, 1));
+    SNMP::SimulatedUDP agentUDP(simulator, IPAddress(10, 0, 0, 2));
+    SNMP::Manager manager;
+    SNMP::Agent agent;
+    SNMP::Aggregator<1, 1> aggregator(manager, agent);
+    discoveryAgent = &agent;
+    simulator.setLatency(10);
+    simulator.begin();
+    manager.begin(managerUDP);
+    manager.onMessage(onAggregatorResponse);
+    agent.begin(agentUDP);
+    agent.onMessage(onAggregatorMessage);
+    aggregator.begin("1.3.6.1.4.1.65000.2", TARGETS, 1, OIDS, 1, 60000);
+    const char *name = getNext(simulator, manager, agent, "1.3.6.1.2.1.1.1.0");
+    check("aggregator agent", 0, aggregatorReached && !strcmp(name, "1.3.6.1.2.1.1.2.0"));
+    name = getNext(simulator, manager, agent, "1.3.6.1.4.1.65000");
+    check("aggregator prefix", 0, !aggregatorReached && !strcmp(name, "1.3.6.1.4.1.65000.2.1.1"));
+    aggregator.stop();
+    simulator.end();
+    discoveryAgent = nullptr;
+}
+
+void setup() {
+    Serial.begin(115200);
+    testLength();
+    testOctetString();
+    testContent();
+    testDepth();
+    testJournal();
+    testJournalFailure();
+    testSimulator();
+    testDiscovery();
+    testPoller();
+    testAggregator();
+    Serial.print(passed);
+    Serial.print(" passed, ");
+    Serial.print(failed);
+    Serial.println(" failed");
+}
+
+void loop() {
+}
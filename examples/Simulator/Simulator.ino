@@ -0,0 +1,115 @@
+/*
+ Simulator
+
+ This sketch replays a subnet discovery sweep on a simulated network.
+
+ No network is needed. The manager and the agents exchange datagrams through
+ a Simulator. A single agent answers for all addresses of 10.1.0.0/23. The
+ sweep probes 10.1.0.0/22 with two communities, the agents only answer to
+ "public".
+
+ Latency, jitter, loss and agent service time are simulated. Time is virtual
+ and advances instantly between deliveries: the sweep takes about a minute of
+ virtual time but runs in a fraction of a second.
+
+ At the end of the sweep, the sketch outputs on serial:
+ - virtual and real duration, in milliseconds,
+ - count of probes sent and agents found,
+ - count of datagrams sent, lost and sent to no agent.
+
+ Change SWEEP_RATE, LOSS or the timeout to compare their effect on sweep
+ duration and completeness.
+ */
+
+#include <SNMPDiscovery.h>
+#include <SNMPSimulator.h>
+
+// Simulated network
+const uint16_t LATENCY = 20;
+const uint16_t JITTER = 10;
+const uint16_t LOSS = 20;
+const uint16_t SERVICE = 5;
+
+// Sweep
+const uint16_t SWEEP_RATE = 100;
+const uint16_t TIMEOUT = 1000;
+
+SNMP::Simulator simulator;
+SNMP::SimulatedUDP managerUDP(simulator, IPAddress(10, 0, 0, 1));
+SNMP::SimulatedUDP agentUDP(simulator, IPAddress(10, 1, 0, 0), IPAddress(255, 255, 254, 0));
+
+SNMP::Manager manager;
+SNMP::Agent agent;
+SNMP::Discovery<32> discovery(manager);
+
+const SNMP::Discovery<32>::Range RANGES[] = {
+        { IPAddress(10, 1, 0, 1), IPAddress(10, 1, 3, 254) },
+};
+
+const char *COMMUNITIES[] = { "private", "public" };
+
+unsigned long start;
+bool done = false;
+
+// Event handler to process SNMP messages on agent side
+void onAgentMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    if (strcmp(message->getCommunity(), "public")) {
+        return;
+    }
+    SNMP::Message *response = new SNMP::Message(message->getVersion(),
+            message->getCommunity(), SNMP::Type::GetResponse);
+    response->setRequestID(message->getRequestID());
+    SNMP::VarBindList *varbindlist = message->getVarBindList();
+    for (uint8_t index = 0; index < varbindlist->count(); ++index) {
+        response->add((*varbindlist)[index]->getName(), new SNMP::OctetStringBER("agent"));
+    }
+    agent.send(response, remote, port);
+    delete response;
+}
+
+void report() {
+    Serial.print("Virtual ");
+    Serial.print(simulator.getTime());
+    Serial.print(" ms, real ");
+    Serial.print(millis() - start);
+    Serial.print(" ms, probes ");
+    Serial.print(discovery.getSent());
+    Serial.print(", found ");
+    Serial.print(discovery.getFound());
+    Serial.print(", datagrams ");
+    Serial.print(simulator.getSent());
+    Serial.print(", lost ");
+    Serial.print(simulator.getLost());
+    Serial.print(", unreachable ");
+    Serial.println(simulator.getUnreachable());
+}
+
+void setup() {
+    Serial.begin(115200);
+    // Simulator
+    simulator.setLatency(LATENCY, JITTER);
+    simulator.setLoss(LOSS);
+    agentUDP.setServiceTime(SERVICE);
+    simulator.begin();
+    // SNMP
+    manager.begin(managerUDP);
+    agent.begin(agentUDP);
+    agent.onMessage(onAgentMessage);
+    discovery.setRate(SWEEP_RATE);
+    discovery.setTimeout(TIMEOUT);
+    start = millis();
+    discovery.begin(RANGES, 1, COMMUNITIES, 2);
+}
+
+void loop() {
+    if (done) {
+        return;
+    }
+    manager.loop();
+    agent.loop();
+    simulator.step();
+    if (!discovery.isRunning()) {
+        report();
+        done = true;
+    }
+}
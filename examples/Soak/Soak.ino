@@ -0,0 +1,459 @@
+/*
+ Soak
+
+ This sketch runs an SNMP agent and an SNMP manager on the same board to
+ measure long-term heap usage of the library.
+
+ No network is needed. Agent and manager exchange datagrams through a pair of
+ loopback UDP objects. Each cycle is made of:
+ - a GETREQUEST from the manager, with a variable count of objects,
+ - a GETRESPONSE from the agent, with octet strings of variable length,
+ - a TRAP, an SNMPV2TRAP and an INFORMREQUEST from the agent.
+
+ Every REPORT cycles, the sketch outputs on serial:
+ - count of cycles,
+ - heap in use and peak heap in use, in bytes,
+ - free heap and largest free block, in bytes,
+ - fragmentation ratio, 1 - largest free block / free heap, in percent.
+
+ Heap is measured on the boards only. On other targets, heap in use is output
+ as 0, free heap and largest free block as n/a.
+
+ Run the sketch for days with each library configuration (SNMP_STREAM,
+ SNMP_VECTOR, SNMP_CAPACITY) to compare their stability. Configuration is
+ output at startup.
+ */
+
+#if ARDUINO_ARCH_AVR
+#define BOARD "Mega 2560"
+#endif
+
+#if ARDUINO_ARCH_STM32
+#define BOARD "Nucleo F767ZI"
+
+#include <malloc.h>
+#endif
+
+#if ARDUINO_ARCH_ESP32
+#define BOARD "ESP32-POE"
+
+#include <esp_heap_caps.h>
+#endif
+
+#ifndef BOARD
+#define BOARD "unknown"
+#endif
+
+#include <SNMP.h>
+
+#if ARDUINO_ARCH_AVR
+// Free list of avr-libc malloc
+struct __freelist {
+    size_t sz;
+    __freelist *nx;
+};
+
+extern "C" {
+extern char *__brkval;
+extern __freelist *__flp;
+}
+#endif
+
+// Use some SNMP classes
+using SNMP::Counter32BER;
+using SNMP::OctetStringBER;
+using SNMP::VarBind;
+using SNMP::VarBindList;
+
+// Count of cycles between reports
+const uint32_t REPORT = 1000;
+
+// Maximum datagram size, as required by RFC 3417
+const uint16_t SIZE = 484;
+
+// This class implements a loopback UDP
+// Datagrams written to one object are read from its peer
+class Loopback: public UDP {
+public:
+    Loopback(const IPAddress address) :
+            _address(address) {
+    }
+
+    void connect(Loopback *peer) {
+        _peer = peer;
+    }
+
+    uint8_t begin(uint16_t port) {
+        _port = port;
+        return 1;
+    }
+
+    void stop() {
+    }
+
+    int beginPacket(IPAddress ip, uint16_t port) {
+        // Peer has only one buffer, unread datagram is lost
+        _peer->_length = 0;
+        _peer->_ready = false;
+        return 1;
+    }
+
+    int beginPacket(const char *host, uint16_t port) {
+        return 0;
+    }
+
+    int endPacket() {
+        _peer->_remote = _address;
+        _peer->_remotePort = _port;
+        _peer->_ready = true;
+        return 1;
+    }
+
+    size_t write(uint8_t byte) {
+        if (_peer->_length < SIZE) {
+            _peer->_buffer[_peer->_length++] = byte;
+            return 1;
+        }
+        return 0;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) {
+        size_t count = 0;
+        while (size-- && write(*buffer++)) {
+            count++;
+        }
+        return count;
+    }
+
+    int parsePacket() {
+        if (_ready) {
+            _ready = false;
+            _position = 0;
+            return _length;
+        }
+        return 0;
+    }
+
+    int available() {
+        return _length - _position;
+    }
+
+    int read() {
+        return _position < _length ? _buffer[_position++] : -1;
+    }
+
+    int read(unsigned char *buffer, size_t length) {
+        size_t count = 0;
+        while ((count < length) && (_position < _length)) {
+            buffer[count++] = _buffer[_position++];
+        }
+        return count;
+    }
+
+    int read(char *buffer, size_t length) {
+        return read(reinterpret_cast<unsigned char*>(buffer), length);
+    }
+
+    int peek() {
+        return _position < _length ? _buffer[_position] : -1;
+    }
+
+    void flush() {
+    }
+
+    IPAddress remoteIP() {
+        return _remote;
+    }
+
+    uint16_t remotePort() {
+        return _remotePort;
+    }
+
+private:
+    IPAddress _address;
+    uint16_t _port = 0;
+    Loopback *_peer = nullptr;
+    uint8_t _buffer[SIZE];
+    uint16_t _length = 0;
+    uint16_t _position = 0;
+    bool _ready = false;
+    IPAddress _remote;
+    uint16_t _remotePort = 0;
+};
+
+// This class measures the heap
+class Heap {
+public:
+#if ARDUINO_ARCH_AVR || ARDUINO_ARCH_ESP32 || ARDUINO_ARCH_STM32
+    static constexpr bool MEASURED = true;
+#else
+    // Free blocks of a hosted heap are meaningless
+    static constexpr bool MEASURED = false;
+#endif
+
+    // Bytes allocated
+    static size_t used() {
+#if ARDUINO_ARCH_AVR
+        return (__brkval ? __brkval : __malloc_heap_start) - __malloc_heap_start - freed();
+#elif ARDUINO_ARCH_ESP32
+        return ESP.getHeapSize() - ESP.getFreeHeap();
+#elif ARDUINO_ARCH_STM32
+        return mallinfo().uordblks;
+#else
+        return 0;
+#endif
+    }
+
+    // Bytes available for allocation
+    static size_t available() {
+#if ARDUINO_ARCH_AVR
+        return freed() + top();
+#elif ARDUINO_ARCH_ESP32
+        return ESP.getFreeHeap();
+#elif ARDUINO_ARCH_STM32
+        return largest(false);
+#else
+        return 0;
+#endif
+    }
+
+    // Largest block available for allocation
+    static size_t largest(const bool contiguous = true) {
+#if ARDUINO_ARCH_AVR
+        size_t size = top();
+        for (__freelist *block = __flp; block; block = block->nx) {
+            if (block->sz > size) {
+                size = block->sz;
+            }
+        }
+        return size;
+#elif ARDUINO_ARCH_ESP32
+        return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+#elif ARDUINO_ARCH_STM32
+        // Probe with allocations, largest first
+        // If not contiguous, sum all blocks found
+        size_t total = 0;
+        void *blocks[8];
+        uint8_t count = 0;
+        do {
+            size_t low = 0;
+            size_t high = 1024 * 1024;
+            while (low < high) {
+                size_t middle = (low + high + 1) / 2;
+                void *pointer = malloc(middle);
+                if (pointer) {
+                    free(pointer);
+                    low = middle;
+                } else {
+                    high = middle - 1;
+                }
+            }
+            if (contiguous || !low) {
+                total += low;
+                break;
+            }
+            blocks[count++] = malloc(low);
+            total += low;
+        } while (count < 8);
+        while (count) {
+            free(blocks[--count]);
+        }
+        return total;
+#else
+        return 0;
+#endif
+    }
+
+private:
+#if ARDUINO_ARCH_AVR
+    // Bytes in free list
+    static size_t freed() {
+        size_t size = 0;
+        for (__freelist *block = __flp; block; block = block->nx) {
+            size += block->sz + sizeof(size_t);
+        }
+        return size;
+    }
+
+    // Bytes between heap top and stack
+    static size_t top() {
+        char stack;
+        char *heap = __brkval ? __brkval : __malloc_heap_start;
+        return &stack - heap - __malloc_margin;
+    }
+#endif
+};
+
+// Loopback UDP objects for agent and manager
+Loopback agentUDP(IPAddress(127, 0, 0, 2));
+Loopback managerUDP(IPAddress(127, 0, 0, 1));
+
+SNMP::Agent agent;
+SNMP::Manager manager;
+
+// OIDs
+const char *OIDS[] = {
+        "1.3.6.1.2.1.1.1.0",
+        "1.3.6.1.2.1.1.4.0",
+        "1.3.6.1.2.1.1.5.0",
+        "1.3.6.1.2.1.1.6.0",
+};
+
+const uint8_t COUNT = sizeof(OIDS) / sizeof(OIDS[0]);
+
+const char *OUTTRAPS = "1.3.6.1.2.1.11.29";
+const char *ENTERPRISE = "1.3.6.1.4.1.121";
+
+uint32_t cycles = 0;
+uint32_t responses = 0;
+uint32_t traps = 0;
+size_t peak = 0;
+
+// Heap is sampled where messages are alive
+void sample() {
+    size_t used = Heap::used();
+    if (used > peak) {
+        peak = used;
+    }
+}
+
+// Octet string of variable length
+char* text(const uint8_t length) {
+    char *string = static_cast<char*>(malloc(length + 1));
+    for (uint8_t index = 0; index < length; ++index) {
+        string[index] = 'A' + index % 26;
+    }
+    string[length] = 0;
+    return string;
+}
+
+// Event handler to process SNMP messages on agent side
+void onAgentMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    SNMP::Message *response = new SNMP::Message(message->getVersion(),
+            message->getCommunity(), SNMP::Type::GetResponse);
+    response->setRequestID(message->getRequestID());
+    VarBindList *varbindlist = message->getVarBindList();
+    for (uint8_t index = 0; index < varbindlist->count(); ++index) {
+        char *value = text((cycles + index * 17) % 64);
+        response->add((*varbindlist)[index]->getName(), new OctetStringBER(value));
+        free(value);
+    }
+    sample();
+    agent.send(response, remote, port);
+    delete response;
+}
+
+// Event handler to process SNMP messages on manager side
+void onManagerMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+    sample();
+    switch (message->getType()) {
+    case SNMP::Type::GetResponse:
+        responses++;
+        break;
+    case SNMP::Type::Trap:
+    case SNMP::Type::SNMPv2Trap:
+    case SNMP::Type::InformRequest:
+        traps++;
+        break;
+    }
+}
+
+// Build trap message
+SNMP::Message* trap(const uint8_t type) {
+    SNMP::Message *message = nullptr;
+    switch (type) {
+    case SNMP::Type::Trap:
+        message = new SNMP::Message(SNMP::Version::V1, "public", SNMP::Type::Trap);
+        message->setEnterprise(ENTERPRISE);
+        message->setAgentAddress(IPAddress(127, 0, 0, 2));
+        message->setTrap(SNMP::Trap::ColdStart);
+        break;
+    default:
+        message = new SNMP::Message(SNMP::Version::V2C, "public", type);
+        message->setSNMPTrapOID(SNMP::Message::OID::COLDSTART);
+        break;
+    }
+    message->add(OUTTRAPS, new Counter32BER(cycles));
+    return message;
+}
+
+void cycle() {
+    // GETREQUEST with 1 to COUNT objects
+    SNMP::Message *message = new SNMP::Message(SNMP::Version::V2C, "public", SNMP::Type::GetRequest);
+    for (uint8_t index = 0; index <= cycles % COUNT; ++index) {
+        message->add(OIDS[index]);
+    }
+    sample();
+    manager.send(message, IPAddress(127, 0, 0, 2), SNMP::Port::SNMP);
+    delete message;
+    agent.loop();
+    manager.loop();
+    // Traps
+    const uint8_t TYPES[] = { SNMP::Type::Trap, SNMP::Type::SNMPv2Trap, SNMP::Type::InformRequest };
+    for (uint8_t index = 0; index < sizeof(TYPES); ++index) {
+        message = trap(TYPES[index]);
+        sample();
+        agent.send(message, IPAddress(127, 0, 0, 1), SNMP::Port::Trap);
+        delete message;
+        manager.loop();
+    }
+    cycles++;
+}
+
+void report() {
+    size_t available = Heap::available();
+    size_t largest = Heap::largest();
+    Serial.print(cycles);
+    Serial.print(" cycles, used ");
+    Serial.print(Heap::used());
+    Serial.print(", peak ");
+    Serial.print(peak);
+    if (Heap::MEASURED) {
+        Serial.print(", free ");
+        Serial.print(available);
+        Serial.print(", largest ");
+        Serial.print(largest);
+        Serial.print(", fragmentation ");
+        Serial.print(available ? 100.0 * (1.0 - static_cast<float>(largest) / available) : 0.0);
+        Serial.print(" %");
+    } else {
+        Serial.print(", free n/a, largest n/a, fragmentation n/a");
+    }
+    Serial.print(", responses ");
+    Serial.print(responses);
+    Serial.print(", traps ");
+    Serial.println(traps);
+}
+
+void setup() {
+#if ARDUINO_ARCH_AVR
+    Serial.begin(115200);
+#else
+    Serial.begin(921600);
+#endif
+    // Configuration
+    Serial.print("Soak on ");
+    Serial.print(BOARD);
+    Serial.print(", SNMP_STREAM ");
+    Serial.print(SNMP_STREAM);
+    Serial.print(", SNMP_VECTOR ");
+    Serial.print(SNMP_VECTOR);
+    Serial.print(", SNMP_CAPACITY ");
+    Serial.println(SNMP_CAPACITY);
+    // Loopback
+    agentUDP.connect(&managerUDP);
+    managerUDP.connect(&agentUDP);
+    // SNMP
+    agent.begin(agentUDP);
+    agent.onMessage(onAgentMessage);
+    manager.begin(managerUDP);
+    manager.onMessage(onManagerMessage);
+    report();
+}
+
+void loop() {
+    cycle();
+    if (cycles % REPORT == 0) {
+        report();
+    }
+}
@@ -6,16 +6,26 @@
  */
 namespace SNMP {
 
+/** Time source function, nullptr for Arduino millis(). */
+Clock::Function Clock::_function = nullptr;
+
 /**
  * @brief Creates a BER of given type.
  *
+ * Only the optional types selected by SNMP_TYPES are created, so other BER
+ * classes are not linked. Other types are created as RawBER, as are sequences
+ * and opaques nested deeper than SNMP_DEPTH.
+ *
  * @param type BER type.
- * @return Pointer to created BER or nullptr if the type is unknown.
+ * @param depth Nesting depth of the BER.
+ * @return Pointer to created BER.
  */
-BER* BER::create(const Type &type) {
+BER* BER::create(const Type &type, const uint8_t depth) {
     switch (type) {
+#if SNMP_TYPES & SNMP_TYPE_BOOLEAN
     case Type::Boolean:
         return new BooleanBER(false);
+#endif
     case Type::Integer:
         return new IntegerBER(0);
     case Type::OctetString:
@@ -29,20 +39,37 @@ BER* BER::create(const Type &type) {
         return new ObjectIdentifierBER(nullptr);
     case Type::IPAddress:
         return new IPAddressBER(IPAddress());
+#if SNMP_TYPES & SNMP_TYPE_COUNTER32
     case Type::Counter32:
         return new Counter32BER(0);
+#endif
+#if SNMP_TYPES & SNMP_TYPE_GAUGE32
     case Type::Gauge32:
         return new Gauge32BER(0);
+#endif
     case Type::TimeTicks:
         return new TimeTicksBER(0);
+#if SNMP_TYPES & SNMP_TYPE_OPAQUE
     case Type::Opaque:
-        return new OpaqueBER(nullptr);
+        if (depth < SNMP_DEPTH) {
+            OpaqueBER *opaque = new OpaqueBER(nullptr);
+            opaque->_depth = depth;
+            return opaque;
+        }
+        break;
+#endif
+#if SNMP_TYPES & SNMP_TYPE_COUNTER64
     case Type::Counter64:
         return new Counter64BER(0);
+#endif
+#if SNMP_TYPES & SNMP_TYPE_FLOAT
     case Type::Float:
         return new FloatBER(0);
+#endif
+#if SNMP_TYPES & SNMP_TYPE_OPAQUEFLOAT
     case Type::OpaqueFloat:
         return new OpaqueFloatBER(0);
+#endif
     case Type::Sequence:
     case Type::GetRequest:
     case Type::GetNextRequest:
@@ -53,9 +80,53 @@ BER* BER::create(const Type &type) {
     case Type::InformRequest:
     case Type::SNMPv2Trap:
     case Type::Report:
-        return new SequenceBER(type);
+        if (depth < SNMP_DEPTH) {
+            SequenceBER *sequence = new SequenceBER(type);
+            sequence->_depth = depth;
+            return sequence;
+        }
+        break;
+    }
+    return new RawBER(type);
+}
+
+/**
+ * @brief Copies the content octets of the BER.
+ *
+ * The BER is encoded in a temporary buffer, on the stack if its size is up to
+ * CONTENT bytes, then its content octets are copied.
+ *
+ * @param buffer Destination.
+ * @param size Size of the destination. Longer content is truncated.
+ * @param offset Offset of the first content octet to copy.
+ * @return Length of the content octets.
+ */
+const unsigned int BER::getContent(uint8_t *buffer, const unsigned int size,
+        const unsigned int offset) {
+    const unsigned int encoded = getSize(true);
+    uint8_t stack[CONTENT];
+    uint8_t *encoding = encoded <= CONTENT ?
+            stack : static_cast<uint8_t*>(malloc(encoded));
+    if (!encoding) {
+        return 0;
+    }
+#if SNMP_STREAM
+    BufferStream stream(encoding, encoded);
+    encode(stream);
+#else
+    encode(encoding);
+#endif
+    // Content octets follow type and length
+    const unsigned int length = _length;
+    if (offset < length) {
+        const unsigned int count = length - offset;
+        memcpy(buffer, encoding + encoded - length + offset,
+                count < size ? count : size);
+    }
+    if (encoding != stack) {
+        free(encoding);
     }
-    return nullptr;
+    return length;
 }
 
 /**
@@ -28,6 +28,77 @@
 #endif
 #endif
 
+/**
+ * @def SNMP_TYPE_BOOLEAN
+ * @brief Boolean is decoded, see SNMP_TYPES.
+ */
+#define SNMP_TYPE_BOOLEAN (1 << 0)
+
+/**
+ * @def SNMP_TYPE_COUNTER32
+ * @brief Counter32 is decoded, see SNMP_TYPES.
+ */
+#define SNMP_TYPE_COUNTER32 (1 << 1)
+
+/**
+ * @def SNMP_TYPE_GAUGE32
+ * @brief Gauge32 is decoded, see SNMP_TYPES.
+ */
+#define SNMP_TYPE_GAUGE32 (1 << 2)
+
+/**
+ * @def SNMP_TYPE_OPAQUE
+ * @brief Opaque is decoded, see SNMP_TYPES.
+ */
+#define SNMP_TYPE_OPAQUE (1 << 3)
+
+/**
+ * @def SNMP_TYPE_COUNTER64
+ * @brief Counter64 is decoded, see SNMP_TYPES.
+ */
+#define SNMP_TYPE_COUNTER64 (1 << 4)
+
+/**
+ * @def SNMP_TYPE_FLOAT
+ * @brief Float is decoded, see SNMP_TYPES.
+ */
+#define SNMP_TYPE_FLOAT (1 << 5)
+
+/**
+ * @def SNMP_TYPE_OPAQUEFLOAT
+ * @brief OpaqueFloat is decoded, see SNMP_TYPES.
+ */
+#define SNMP_TYPE_OPAQUEFLOAT (1 << 6)
+
+#ifndef SNMP_TYPES
+/**
+ * @def SNMP_TYPES
+ * @brief Defines the optional types decoded to their BER class.
+ *
+ * Integer, OctetString, Null, ObjectIdentifier, IPAddress, TimeTicks and
+ * sequences are always decoded. Other types are decoded as RawBER.
+ */
+#define SNMP_TYPES (SNMP_TYPE_BOOLEAN | SNMP_TYPE_COUNTER32 | SNMP_TYPE_GAUGE32 \
+        | SNMP_TYPE_OPAQUE | SNMP_TYPE_COUNTER64 | SNMP_TYPE_FLOAT \
+        | SNMP_TYPE_OPAQUEFLOAT)
+#endif
+
+#ifndef SNMP_DEPTH
+/**
+ * @def SNMP_DEPTH
+ * @brief Defines the maximum nesting depth of constructed BERs.
+ *
+ * Deeper sequences and opaques are decoded as RawBER, without recursion, so
+ * stack usage of the decoder is bounded. A message needs 4 levels.
+ *
+ * Sizing and encoding are bounded the same way: a sequence or an opaque built
+ * deeper than SNMP_DEPTH is left out of its parent, neither counted nor
+ * encoded. Each level still costs a few stack frames, and deleting a BER
+ * built by the application walks its whole tree.
+ */
+#define SNMP_DEPTH 8
+#endif
+
 #if SNMP_STREAM
 #include <Stream.h>
 #endif
@@ -210,6 +281,136 @@ public:
     };
 };
 
+/**
+ * @class Clock
+ * @brief Time source of the library.
+ *
+ * The library reads time from Clock::millis(), which calls Arduino millis()
+ * by default. Another time source, such as the virtual clock of Simulator,
+ * can be set with Clock::set().
+ */
+class Clock {
+public:
+    /**
+     * @brief Time source function.
+     *
+     * @return Time in milliseconds.
+     */
+    using Function = unsigned long (*)();
+
+    /**
+     * @brief Gets current time.
+     *
+     * @return Time in milliseconds.
+     */
+    static unsigned long millis() {
+        return _function ? _function() : ::millis();
+    }
+
+    /**
+     * @brief Sets the time source.
+     *
+     * @param function Time source function or nullptr for Arduino millis().
+     */
+    static void set(Function function) {
+        _function = function;
+    }
+
+private:
+    /** Time source function. */
+    static Function _function;
+};
+
+#if SNMP_STREAM
+/**
+ * @class BufferStream
+ * @brief Stream over a memory buffer.
+ *
+ * Allows stream functions to encode to or decode from a memory buffer.
+ *
+ * - Bytes are written after the last written byte.
+ * - Bytes are read from the first unread byte.
+ */
+class BufferStream: public Stream {
+public:
+    /**
+     * @brief Creates a BufferStream object.
+     *
+     * @param buffer Pointer to the buffer.
+     * @param size Size of the buffer.
+     * @param length Count of valid bytes already in the buffer.
+     */
+    BufferStream(uint8_t *buffer, const unsigned int size,
+            const unsigned int length = 0) {
+        _buffer = buffer;
+        _size = size;
+        _length = length;
+    }
+
+    /**
+     * @brief Gets the count of bytes available for reading.
+     *
+     * @return Count of bytes.
+     */
+    virtual int available() {
+        return _length - _position;
+    }
+
+    /**
+     * @brief Reads a byte.
+     *
+     * @return Byte read or -1 if none is available.
+     */
+    virtual int read() {
+        return _position < _length ? _buffer[_position++] : -1;
+    }
+
+    /**
+     * @brief Reads a byte without consuming it.
+     *
+     * @return Byte or -1 if none is available.
+     */
+    virtual int peek() {
+        return _position < _length ? _buffer[_position] : -1;
+    }
+
+    /**
+     * @brief Writes a byte.
+     *
+     * @param byte Byte to write.
+     * @return 1 if success, 0 if the buffer is full.
+     */
+    virtual size_t write(uint8_t byte) {
+        if (_length < _size) {
+            _buffer[_length++] = byte;
+            return 1;
+        }
+        return 0;
+    }
+
+    using Print::write;
+
+    /**
+     * @brief Gets the count of bytes written.
+     *
+     * @return Count of bytes.
+     */
+    const unsigned int getLength() const {
+        return _length;
+    }
+
+private:
+    /** Pointer to the buffer. */
+    uint8_t *_buffer;
+    /** Size of the buffer. */
+    unsigned int _size;
+    /** Count of valid bytes. */
+    unsigned int _length;
+    /** Position of the next byte to read. */
+    unsigned int _position = 0;
+};
+#endif
+
 /**
  * @class Base
  * @brief Base class for BER, Length and Type.
@@ -571,9 +772,10 @@ public:
      */
     void encode(Stream &stream) {
         if (_length > 0x7F) {
-            stream.write(0x80 | _size);
+            // Size includes the leading byte
+            stream.write(0x80 | (_size - 1));
             unsigned int length = _length;
-            for (uint8_t index = 0; index < _size; ++index) {
+            for (uint8_t index = 1; index < _size; ++index) {
                 stream.write(length >> ((_size - index - 1) << 3));
             }
         } else {
@@ -615,10 +817,11 @@ public:
     uint8_t* encode(uint8_t *buffer) {
         uint8_t *pointer = buffer;
         if (_length > 0x7F) {
-            *pointer = 0x80 | _size;
-            pointer += _size;
+            // Size includes the leading byte
+            *pointer = 0x80 | (_size - 1);
+            pointer += _size - 1;
             unsigned int value = _length;
-            for (uint8_t index = 0; index < _size; ++index) {
+            for (uint8_t index = 1; index < _size; ++index) {
                 *pointer-- = value;
                 value >>= 8;
             }
@@ -644,6 +847,9 @@ public:
                 _length <<= 8;
                 _length += *pointer++;
             }
+            _size++;
+        } else {
+            _size = 1;
         }
         return pointer;
     }
@@ -1023,7 +1229,24 @@ public:
         return _size;
     }
 
+    /**
+     * @brief Copies the content octets of the BER.
+     *
+     * Content octets are the value, without type and length. Call it again
+     * with an offset to read a long content by chunks.
+     *
+     * @param buffer Destination.
+     * @param size Size of the destination. Longer content is truncated.
+     * @param offset Offset of the first content octet to copy.
+     * @return Length of the content octets.
+     */
+    virtual const unsigned int getContent(uint8_t *buffer,
+            const unsigned int size, const unsigned int offset = 0);
+
 protected:
+    /** Largest encoding copied on the stack by getContent(). */
+    static constexpr uint8_t CONTENT = 16;
+
     /** BER length. */
     Length _length;
     /** BER type. */
@@ -1033,9 +1256,25 @@ protected:
      * @brief Creates a BER of given type.
      *
      * @param type BER type.
-     * @return Pointer to created BER or nullptr if the type is unknown.
+     * @param depth Nesting depth of the BER, see SNMP_DEPTH.
+     * @return Pointer to created BER, a RawBER if the type is not decoded.
+     */
+    BER* create(const Type &type, const uint8_t depth);
+
+    /**
+     * @brief Sets the nesting depth of the BER before it is sized or encoded.
+     *
+     * Only constructed BERs keep their depth.
+     *
+     * @param depth Nesting depth of the BER, see SNMP_DEPTH.
+     * @return true if the BER is within SNMP_DEPTH.
      */
-    BER* create(const Type &type);
+    virtual bool nest(const uint8_t depth) {
+        return true;
+    }
+
+    template<const uint8_t U> friend class ArrayBER;
+    friend class OpaqueBER;
 };
 
 /**
@@ -1314,6 +1553,19 @@ public:
      */
     OctetStringBER(const char *value, const uint32_t length);
 
+    /**
+     * @brief Creates an OctetStringBER object by moving another one.
+     *
+     * The char array is moved, not copied. The moved object is left empty.
+     *
+     * @param ber OctetStringBER to move.
+     */
+    OctetStringBER(OctetStringBER &&ber) :
+            BER(ber), _value(ber._value) {
+        ber._value = nullptr;
+        ber._length = 0;
+    }
+
     /**
      * @brief OctetStringBER destructor.
      *
@@ -1418,6 +1670,25 @@ public:
         return _value[byte] & (0x80 >> bit);
     }
 
+    /**
+     * @brief Copies the content octets of the OctetStringBER.
+     *
+     * The value is copied as is, without encoding.
+     *
+     * @param buffer Destination.
+     * @param size Size of the destination. Longer content is truncated.
+     * @param offset Offset of the first content octet to copy.
+     * @return Length of the content octets.
+     */
+    virtual const unsigned int getContent(uint8_t *buffer,
+            const unsigned int size, const unsigned int offset = 0) {
+        if (offset < _length) {
+            const unsigned int count = _length - offset;
+            memcpy(buffer, _value + offset, count < size ? count : size);
+        }
+        return _length;
+    }
+
 protected:
     /** OctetStringBER char array pointer value. */
     char *_value;
@@ -1427,7 +1698,7 @@ protected:
      *
      * @param type OctetStringBER type.
      */
-    OctetStringBER(const uint8_t type = Type::OctetString) :
+    OctetStringBER(const unsigned int type = Type::OctetString) :
             BER(type) {
         _value = nullptr;
     }
@@ -1501,6 +1772,19 @@ public:
         setValue(value);
     }
 
+    /**
+     * @brief Creates an ObjectIdentifierBER object by moving another one.
+     *
+     * The string is moved, the OID is not parsed again. The moved object is
+     * left empty.
+     *
+     * @param ber ObjectIdentifierBER to move.
+     */
+    ObjectIdentifierBER(ObjectIdentifierBER &&ber) :
+            BER(ber), _value(static_cast<String&&>(ber._value)) {
+        ber._length = 0;
+    }
+
 #if SNMP_STREAM
     /**
      * @brief Encodes ObjectIdentifierBER to stream.
@@ -1697,6 +1981,53 @@ public:
         }
     }
 
+    /**
+     * @brief Copies the content octets of the ObjectIdentifierBER.
+     *
+     * Subidentifiers are encoded directly into the destination.
+     *
+     * @param buffer Destination.
+     * @param size Size of the destination. Longer content is truncated.
+     * @param offset Offset of the first content octet to copy.
+     * @return Length of the content octets.
+     */
+    virtual const unsigned int getContent(uint8_t *buffer,
+            const unsigned int size, const unsigned int offset = 0) {
+        unsigned int index = 0;
+        unsigned int position = 0;
+        uint32_t subidentifier = 0;
+        const char *token = _value.c_str();
+        while (token != NULL) {
+            uint8_t length = 1;
+            switch (index) {
+            case 0:
+                subidentifier = atoi(token);
+                length = 0;
+                break;
+            case 1:
+                subidentifier = subidentifier * 40 + atoi(++token);
+                break;
+            default:
+                subidentifier = atol(++token);
+                while ((length < 5) && (subidentifier >> (7 * length))) {
+                    length++;
+                }
+                break;
+            }
+            while (length--) {
+                if ((position >= offset) && (position - offset < size)) {
+                    buffer[position - offset] = (index == 1 ? subidentifier :
+                            (subidentifier >> (7 * length)) & 0x7F)
+                            | (length ? 0x80 : 0x00);
+                }
+                position++;
+            }
+            token = strchr(token, '.');
+            index++;
+        }
+        return position;
+    }
+
 private:
     /** OctetStringBER string value. */
     String _value;
@@ -1723,6 +2054,26 @@ public:
             BER(type) {
     }
 
+    /**
+     * @brief Creates an ArrayBER by moving another one.
+     *
+     * BERs are moved, not copied. The moved array is left empty.
+     *
+     * @param ber ArrayBER to move.
+     */
+    ArrayBER(ArrayBER &&ber) :
+            BER(ber), _count(ber._count) {
+#if SNMP_VECTOR
+        _bers.swap(ber._bers);
+#else
+        for (uint8_t index = 0; index < _count; ++index) {
+            _bers[index] = ber._bers[index];
+        }
+#endif
+        ber._count = 0;
+        ber._length = 0;
+    }
+
     /**
      * @brief ArrayBER destructor.
      *
@@ -1746,14 +2097,16 @@ public:
      * @brief Encodes ArrayBER to stream.
      *
      * Type and length are encoded by the inherited BER::encode() then each BER of
-     * the array is encoded.
+     * the array within SNMP_DEPTH is encoded.
      *
      * @param stream Stream to write to.
      */
     virtual void encode(Stream &stream) {
         BER::encode(stream);
         for (uint8_t index = 0; index < _count; ++index) {
-            _bers[index]->encode(stream);
+            if (_bers[index]->nest(_depth + 1)) {
+                _bers[index]->encode(stream);
+            }
         }
     }
 
@@ -1781,10 +2134,11 @@ public:
             _length = 0;
             do {
                 type.decode(stream);
-                BER *ber = create(type);
+                BER *ber = create(type, _depth + 1);
                 if (ber) {
                     ber->decode(stream, Flag::Typed);
-                    length -= ber->getSize();
+                    const unsigned int size = ber->getSize();
+                    length = size < length ? length - size : 0;
                     add(ber);
                 }
             } while (length);
@@ -1795,7 +2149,7 @@ public:
      * @brief Encodes ArrayBER to memory buffer.
      *
      * Type and length are encoded by the inherited BER::encode() then each BER of
-     * the array is encoded.
+     * the array within SNMP_DEPTH is encoded.
      *
      * @param buffer Pointer to the buffer.
      * @return Next position to be written in buffer.
@@ -1804,11 +2158,15 @@ public:
         uint8_t *pointer = BER::encode(buffer);
 #if SNMP_VECTOR
         for (auto ber : _bers) {
-            pointer = ber->encode(pointer);
+            if (ber->nest(_depth + 1)) {
+                pointer = ber->encode(pointer);
+            }
         }
 #else
         for (uint8_t index = 0; index < _count; ++index) {
-            pointer = _bers[index]->encode(pointer);
+            if (_bers[index]->nest(_depth + 1)) {
+                pointer = _bers[index]->encode(pointer);
+            }
         }
 #endif
         return pointer;
@@ -1831,7 +2189,7 @@ public:
             Type type;
             do {
                 type.decode(pointer);
-                BER *ber = create(type);
+                BER *ber = create(type, _depth + 1);
                 if (ber) {
                     pointer = ber->decode(pointer);
                     add(ber);
@@ -1851,7 +2209,7 @@ public:
      * - Length size.
      * - Length.
      *
-     * Length is the sum of the size of all the BERs in the array.
+     * Length is the sum of the size of the BERs in the array within SNMP_DEPTH.
      *
      * @param refresh If true, computes size, if false returns already computed size.
      * @return BER size.
@@ -1860,7 +2218,9 @@ public:
         if (refresh) {
             _length = 0;
             for (uint8_t index = 0; index < _count; ++index) {
-                _length += _bers[index]->getSize(true);
+                if (_bers[index]->nest(_depth + 1)) {
+                    _length += _bers[index]->getSize(true);
+                }
             }
         }
         return BER::getSize();
@@ -1910,6 +2270,17 @@ protected:
         return ber;
     }
 
+    /**
+     * @brief Sets the nesting depth of the ArrayBER.
+     *
+     * @param depth Nesting depth of the ArrayBER, see SNMP_DEPTH.
+     * @return true if the ArrayBER is within SNMP_DEPTH.
+     */
+    virtual bool nest(const uint8_t depth) {
+        _depth = depth;
+        return depth < SNMP_DEPTH;
+    }
+
     /**
      * @brief Removes the last BER in the array.
      *
@@ -1932,6 +2303,8 @@ protected:
 private:
     /** Count of BERs in the array. */
     uint8_t _count = 0;
+    /** Nesting depth in the message, see SNMP_DEPTH. */
+    uint8_t _depth = 0;
 #if SNMP_VECTOR
     /** Vector of BERs.*/
     std::vector<BER*> _bers;
@@ -1940,6 +2313,7 @@ private:
     BER *_bers[U];
 #endif
 
+    friend class BER;
     friend class Message;
     friend class VarBind;
     friend class VarBindList;
@@ -1989,6 +2363,18 @@ public:
         }
     }
 
+    /**
+     * @brief Creates a VarBind by moving another one.
+     *
+     * OID and value BERs are moved, not copied. The moved variable binding is
+     * left empty.
+     *
+     * @param varbind VarBind to move.
+     */
+    VarBind(VarBind &&varbind) :
+            ArrayBER(static_cast<ArrayBER&&>(varbind)) {
+    }
+
     /**
      * @brief Gets variable binding name.
      *
@@ -2082,6 +2468,28 @@ private:
     static constexpr uint8_t LENGTH = 4;
 };
 
+/**
+ * @class RawBER
+ * @brief BER object to handle a value of a type not decoded.
+ *
+ * A type is not decoded when unknown or not selected by SNMP_TYPES. The value
+ * bytes are kept as is, so the BER is encoded again unchanged.
+ *
+ * - Type is the decoded type.
+ * - Length is variable.
+ */
+class RawBER: public OctetStringBER {
+public:
+    /**
+     * @brief Creates an empty RawBER object.
+     *
+     * @param type RawBER type.
+     */
+    RawBER(const unsigned int type) :
+            OctetStringBER(type) {
+    }
+};
+
 /**
  * @class UIntegerBER
  * @brief Base class for unsigned integer BER.
@@ -2332,13 +2740,15 @@ public:
      * @brief Encodes OpaqueBER to stream.
      *
      * Type and length are encoded by the inherited BER::encode() then the embedded
-     * BER is encoded.
+     * BER is encoded if within SNMP_DEPTH.
      *
      * @param stream Stream to write to.
      */
     virtual void encode(Stream &stream) {
         BER::encode(stream);
-        _ber->encode(stream);
+        if (_ber->nest(_depth + 1)) {
+            _ber->encode(stream);
+        }
     }
 
     /**
@@ -2364,10 +2774,11 @@ public:
             Type type;
             do {
                 type.decode(stream);
-                _ber = create(type);
+                _ber = create(type, _depth + 1);
                 if (_ber) {
                     _ber->decode(stream, Flag::Typed);
-                    length -= _ber->getSize();
+                    const uint32_t size = _ber->getSize();
+                    length = size < length ? length - size : 0;
                 }
             } while (length);
         }
@@ -2377,14 +2788,14 @@ public:
      * @brief Encodes OpaqueBER to memory buffer.
      *
      * Type and length are encoded by the inherited BER::encode() then the embedded
-     * BER is encoded.
+     * BER is encoded if within SNMP_DEPTH.
      *
      * @param buffer Pointer to the buffer.
      * @return Next position to be written in buffer.
      */
     virtual uint8_t* encode(uint8_t *buffer) {
         uint8_t *pointer = BER::encode(buffer);
-        return _ber->encode(pointer);
+        return _ber->nest(_depth + 1) ? _ber->encode(pointer) : pointer;
     }
 
     /**
@@ -2403,7 +2814,7 @@ public:
             Type type;
             do {
                 type.decode(pointer);
-                _ber = create(type);
+                _ber = create(type, _depth + 1);
                 if (_ber) {
                     pointer = _ber->decode(pointer);
                 }
@@ -2422,14 +2833,14 @@ public:
      * - Length size.
      * - Length.
      *
-     * Length is the size of the embedded BER.
+     * Length is the size of the embedded BER, 0 if deeper than SNMP_DEPTH.
      *
      * @param refresh If true, computes size, if false returns already computed size.
      * @return BER size.
      */
     virtual const unsigned int getSize(const bool refresh = false) {
         if (refresh) {
-            _length = _ber->getSize(true);
+            _length = _ber->nest(_depth + 1) ? _ber->getSize(true) : 0;
         }
         return BER::getSize();
     }
@@ -2443,9 +2854,25 @@ public:
         return _ber;
     }
 
+protected:
+    /**
+     * @brief Sets the nesting depth of the OpaqueBER.
+     *
+     * @param depth Nesting depth of the OpaqueBER, see SNMP_DEPTH.
+     * @return true if the OpaqueBER is within SNMP_DEPTH.
+     */
+    virtual bool nest(const uint8_t depth) {
+        _depth = depth;
+        return depth < SNMP_DEPTH;
+    }
+
 private:
     /** Embedded BER. */
     BER *_ber;
+    /** Nesting depth in the message, see SNMP_DEPTH. */
+    uint8_t _depth = 0;
+
+    friend class BER;
 };
 
 /**
@@ -5,6 +5,38 @@
 
 #include <Udp.h>
 
+#ifndef SNMP_PROBES
+/**
+ * @def SNMP_PROBES
+ * @brief Defines USDT probes.
+ *
+ * If set to 1 and sys/sdt.h is available, static probes of provider snmp are
+ * compiled in hot paths. Otherwise probes are empty and cost nothing.
+ */
+#define SNMP_PROBES 0
+#endif
+
+#if SNMP_PROBES && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+/**
+ * @def SNMP_PROBE
+ * @brief Fires a USDT probe of provider snmp.
+ *
+ * Arguments are request identifier, PDU type, peer address, peer port and
+ * size, 0 if unknown, then an optional probe specific value.
+ */
+#define SNMP_PROBE(name, id, type, ip, port, ...) \
+        STAP_PROBEV(snmp, name, static_cast<uint32_t>(id), \
+                static_cast<uint8_t>(type), ::SNMP::Probe::address(ip), \
+                static_cast<uint16_t>(port), __VA_ARGS__)
+#endif
+#endif
+
+#ifndef SNMP_PROBE
+#define SNMP_PROBE(name, id, type, ip, port, ...)
+#endif
+
 /**
  * @namespace SNMP
  * @brief %SNMP library namespace.
@@ -25,6 +57,428 @@ struct Port {
     static constexpr uint16_t Trap = 162; /**< SNMP default UDP port for TRAP, INFORMREQUEST and SNMPV2TRAP messages. */
 };
 
+/**
+ * @struct Encoding
+ * @brief Helper struct to handle encoded messages and IP addresses as integers.
+ */
+struct Encoding {
+    /**
+     * @brief Skips a BER type and length in an encoded message.
+     *
+     * @param pointer Pointer to the BER.
+     * @param value If true, the value is also skipped.
+     * @return Pointer to the value, or to the next BER if value is skipped.
+     */
+    static uint8_t* skip(uint8_t *pointer, const bool value) {
+        pointer++;
+        uint32_t length = *pointer++;
+        if (length & 0x80) {
+            uint8_t size = length & 0x7F;
+            length = 0;
+            while (size--) {
+                length = (length << 8) | *pointer++;
+            }
+        }
+        return value ? pointer + length : pointer;
+    }
+
+    /**
+     * @brief Converts an IP address to integer.
+     *
+     * @param address IP address.
+     * @return Address as integer, most significant byte first.
+     */
+    static uint32_t toInteger(const IPAddress &address) {
+        return (static_cast<uint32_t>(address[0]) << 24)
+                | (static_cast<uint32_t>(address[1]) << 16)
+                | (static_cast<uint32_t>(address[2]) << 8) | address[3];
+    }
+
+    /**
+     * @brief Converts an integer to IP address.
+     *
+     * @param address Address as integer, most significant byte first.
+     * @return IP address.
+     */
+    static IPAddress toAddress(const uint32_t address) {
+        return IPAddress(address >> 24, address >> 16, address >> 8, address);
+    }
+};
+
+#if SNMP_PROBES
+/**
+ * @struct Probe
+ * @brief Helper struct to handle USDT probes arguments.
+ */
+struct Probe {
+    /**
+     * @brief Packs an IP address.
+     *
+     * @param ip IP address.
+     * @return IP address as an integer, first byte as MSB.
+     */
+    static uint32_t address(const IPAddress &ip) {
+        return Encoding::toInteger(ip);
+    }
+};
+#endif
+
+/**
+ * @class Checkpoint
+ * @brief Helper class to save and restore handlers state.
+ *
+ * A checkpoint is a compact binary image, little-endian and aligned on 4 bytes,
+ * so it can be restored in place from a memory mapped file.
+ *
+ * - Header, 16 bytes: magic "SNMP", version, count of records, 2 reserved
+ * bytes, length and FNV-1a hash of the records.
+ * - Record header, 12 bytes: handler kind, 3 reserved bytes, fingerprint of the
+ * handler configuration and length of the payload.
+ * - Payload, padded to 4 bytes.
+ */
+class Checkpoint {
+public:
+    /** Checkpoint format version. */
+    static constexpr uint8_t VERSION = 1;
+    /** Size of the checkpoint header. */
+    static constexpr uint8_t HEADER = 16;
+    /** Size of a record header. */
+    static constexpr uint8_t RECORD = 12;
+    /** FNV-1a offset basis. */
+    static constexpr uint32_t BASIS = 2166136261;
+
+    /**
+     * @brief Hashes data with FNV-1a.
+     *
+     * @param hash Current hash, BASIS to start.
+     * @param data Pointer to data.
+     * @param length Length of data.
+     * @return Hash.
+     */
+    static uint32_t hash(uint32_t hash, const void *data, const size_t length) {
+        const uint8_t *pointer = static_cast<const uint8_t*>(data);
+        for (size_t index = 0; index < length; ++index) {
+            hash = (hash ^ pointer[index]) * 16777619;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Hashes a null terminated string, terminator included.
+     *
+     * @param hash Current hash, BASIS to start.
+     * @param string Null terminated string.
+     * @return Hash.
+     */
+    static uint32_t hash(const uint32_t hash, const char *string) {
+        return Checkpoint::hash(hash, string, strlen(string) + 1);
+    }
+
+    /**
+     * @brief Writes an integer, little-endian.
+     *
+     * @param print Destination.
+     * @param value Integer.
+     * @param size Size in bytes.
+     */
+    static void write(Print &print, const uint32_t value, const uint8_t size) {
+        for (uint8_t index = 0; index < size; ++index) {
+            print.write(static_cast<uint8_t>(value >> (index << 3)));
+        }
+    }
+
+    /**
+     * @brief Writes null bytes up to the next 4 bytes boundary.
+     *
+     * @param print Destination.
+     * @param length Length written since the last boundary.
+     */
+    static void pad(Print &print, const uint32_t length) {
+        for (uint32_t index = length; index & 3; ++index) {
+            print.write(static_cast<uint8_t>(0));
+        }
+    }
+
+    /**
+     * @brief Reads an integer, little-endian.
+     *
+     * @param pointer Pointer to the integer, advanced past it.
+     * @param size Size in bytes.
+     * @return Integer.
+     */
+    static uint32_t read(const uint8_t *&pointer, const uint8_t size) {
+        uint32_t value = 0;
+        for (uint8_t index = 0; index < size; ++index) {
+            value |= static_cast<uint32_t>(*pointer++) << (index << 3);
+        }
+        return value;
+    }
+
+    /**
+     * @class Digest
+     * @brief Print that counts and hashes bytes without storing them.
+     */
+    class Digest: public Print {
+    public:
+        /**
+         * @brief Writes a byte.
+         *
+         * @param byte Byte to write.
+         * @return 1.
+         */
+        virtual size_t write(uint8_t byte) {
+            _hash = Checkpoint::hash(_hash, &byte, 1);
+            _length++;
+            return 1;
+        }
+
+        using Print::write;
+
+        /**
+         * @brief Gets the count of bytes written.
+         *
+         * @return Count of bytes.
+         */
+        const uint32_t getLength() const {
+            return _length;
+        }
+
+        /**
+         * @brief Gets the hash of bytes written.
+         *
+         * @return FNV-1a hash.
+         */
+        const uint32_t getHash() const {
+            return _hash;
+        }
+
+    private:
+        /** Count of bytes written. */
+        uint32_t _length = 0;
+        /** Hash of bytes written. */
+        uint32_t _hash = BASIS;
+    };
+};
+
+/**
+ * @class Handler
+ * @brief Base class for objects driven by SNMP::loop().
+ *
+ * A handler is attached to an Agent or a Manager with SNMP::attach().
+ *
+ * - Every incoming packet is offered to the handlers before it is decoded, any
+ * handler can drop it.
+ * - Every incoming message is offered to the handlers before the user message
+ * handler.
+ * - Every call to SNMP::loop() calls handlers loop() function, where timeouts
+ * and pending work are processed.
+ */
+class Handler {
+public:
+    /**
+     * @brief Handler destructor.
+     */
+    virtual ~Handler() {
+    }
+
+    /**
+     * @brief Processes an incoming message.
+     *
+     * @param message %SNMP message to process.
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     * @return true if the message is consumed, false to offer the message to the
+     * next handler.
+     */
+    virtual bool message(const Message *message, const IPAddress remote,
+            const uint16_t port) {
+        return false;
+    }
+
+    /**
+     * @brief Filters an incoming packet before it is decoded.
+     *
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     * @return true to decode the packet, false to drop it.
+     */
+    virtual bool accept(const IPAddress remote, const uint16_t port) {
+        return true;
+    }
+
+    /**
+     * @brief Processes pending work.
+     *
+     * Called on every SNMP::loop().
+     */
+    virtual void loop() {
+    }
+
+    /**
+     * @brief Gets the kind of checkpoint record of the handler.
+     *
+     * @return Kind, 0 if the handler has no state to checkpoint.
+     */
+    virtual const uint8_t getKind() const {
+        return 0;
+    }
+
+    /**
+     * @brief Gets the fingerprint of the handler configuration.
+     *
+     * A record is only restored to a handler with the same kind and
+     * fingerprint.
+     *
+     * @return Fingerprint.
+     */
+    virtual const uint32_t getFingerprint() const {
+        return 0;
+    }
+
+    /**
+     * @brief Saves the handler state.
+     *
+     * @param print Destination.
+     */
+    virtual void save(Print &print) const {
+    }
+
+    /**
+     * @brief Restores the handler state.
+     *
+     * @param data Pointer to the record payload.
+     * @param length Length of the payload.
+     * @return true if success, false otherwise.
+     */
+    virtual bool restore(const uint8_t *data, const uint32_t length) {
+        return false;
+    }
+
+private:
+    /** Next handler in the list. */
+    Handler *_next = nullptr;
+
+    friend class SNMP;
+};
+
+/**
+ * @class Timer
+ * @brief Timer serviced by SNMP::loop().
+ *
+ * A timer is armed with SNMP::schedule(). When it expires, SNMP::loop() calls
+ * its user handler.
+ *
+ * - A one-shot timer is disarmed when it expires.
+ * - A periodic timer is armed again relative to its deadline, not to the time
+ * it is serviced, so lateness of loop() does not accumulate. Periods missed
+ * entirely are skipped.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Timer timer(onTimer);
+ *
+ * void onTimer(SNMP::Timer *timer) {
+ *     // User code here...
+ * }
+ *
+ * void setup() {
+ *     // ...
+ *     snmp.schedule(timer, 1000, 1000);
+ * }
+ * ```
+ *
+ * @warning A timer must be cancelled before it is destroyed.
+ */
+class Timer {
+public:
+    /**
+     * @brief On expire event user handler type.
+     *
+     * @param timer Expired timer.
+     */
+    using Event = void (*)(Timer*);
+
+    /**
+     * @brief Creates a Timer object.
+     *
+     * @param event On expire event user handler.
+     */
+    Timer(Event event = nullptr) :
+            _onExpire(event) {
+    }
+
+    /**
+     * @brief Timer destructor.
+     */
+    virtual ~Timer() {
+    }
+
+    /**
+     * @brief Sets on expire event user handler.
+     *
+     * @param event Event handler.
+     */
+    void onExpire(Event event) {
+        _onExpire = event;
+    }
+
+    /**
+     * @brief Checks if the timer is armed.
+     *
+     * @return true if armed, false otherwise.
+     */
+    const bool isArmed() const {
+        return _armed;
+    }
+
+    /**
+     * @brief Gets the deadline.
+     *
+     * @return Time of expiration in milliseconds, as given by Clock::millis().
+     */
+    const unsigned long getDeadline() const {
+        return _deadline;
+    }
+
+    /**
+     * @brief Gets the period.
+     *
+     * @return Period in milliseconds, 0 for a one-shot timer.
+     */
+    const unsigned long getPeriod() const {
+        return _period;
+    }
+
+protected:
+    /**
+     * @brief Processes expiration.
+     *
+     * Calls the user handler. Derived classes may override it.
+     */
+    virtual void expire() {
+        if (_onExpire) {
+            _onExpire(this);
+        }
+    }
+
+private:
+    /** On expire event user handler. */
+    Event _onExpire;
+    /** Next timer in the list, by deadline. */
+    Timer *_next = nullptr;
+    /** Time of expiration in milliseconds. */
+    unsigned long _deadline = 0;
+    /** Period in milliseconds, 0 for a one-shot timer. */
+    unsigned long _period = 0;
+    /** True if armed. */
+    bool _armed = false;
+
+    friend class SNMP;
+};
+
+template<const uint8_t Q, const uint16_t S> class LwIPUDP;
+
 /**
  * @class SNMP
  * @brief Base class for Agent and Manager.
@@ -49,6 +503,13 @@ class SNMP {
      */
     using Event = void (*)(const Message*, const IPAddress, const uint16_t);
 
+    /**
+     * @brief Transport writer type.
+     *
+     * Encodes and sends a message straight to the transport, see send().
+     */
+    using Writer = bool (*)(UDP*, Message*, const IPAddress, const uint16_t);
+
 public:
     /**
      * @brief Initializes network.
@@ -58,9 +519,26 @@ public:
      */
     bool begin(UDP& udp) {
         _udp = &udp;
+        _writer = nullptr;
         return _udp->begin(_port);
     }
 
+    /**
+     * @brief Initializes network over lwIP.
+     *
+     * Messages sent by send() are encoded straight to a pbuf by
+     * LwIPUDP::send(). SNMPLwIP.h must be included.
+     *
+     * @param udp lwIP UDP client.
+     * @return 1 if success, 0 if failure.
+     */
+    template<const uint8_t Q, const uint16_t S>
+    bool begin(LwIPUDP<Q, S> &udp) {
+        const bool success = begin(static_cast<UDP&>(udp));
+        _writer = write<LwIPUDP<Q, S>>;
+        return success;
+    }
+
     /**
      * @brief Network read operation.
      *
@@ -72,31 +550,79 @@ public:
     void loop() {
 #if SNMP_STREAM
         if (_udp->parsePacket()) {
-            Message *message = new Message();
-            message->parse(*_udp);
-            _onMessage(message, _udp->remoteIP(), _udp->remotePort());
-            delete message;
+            SNMP_PROBE(received, 0, 0, _udp->remoteIP(), _udp->remotePort(),
+                    _udp->available());
+            if (accept()) {
+                SNMP_PROBE(decode__start, 0, 0, _udp->remoteIP(),
+                        _udp->remotePort(), _udp->available());
+                Message *message = new Message();
+                message->parse(*_udp);
+                SNMP_PROBE(decode__end, message->getRequestID(),
+                        message->getType(), _udp->remoteIP(),
+                        _udp->remotePort(), message->ArrayBER::getSize());
+                dispatch(message, _udp->remoteIP(), _udp->remotePort());
+                delete message;
+            } else {
+                SNMP_PROBE(dropped, 0, 0, _udp->remoteIP(), _udp->remotePort(),
+                        _udp->available());
+            }
         }
 #else
         if (_udp->parsePacket()) {
             uint32_t length = _udp->available();
-            uint8_t *buffer = static_cast<uint8_t*>(malloc(length));
+            SNMP_PROBE(received, 0, 0, _udp->remoteIP(), _udp->remotePort(),
+                    length);
+            uint8_t *buffer = accept() ?
+                    static_cast<uint8_t*>(malloc(length)) : nullptr;
             if (buffer) {
                 _udp->read(buffer, length);
+                SNMP_PROBE(decode__start, 0, 0, _udp->remoteIP(),
+                        _udp->remotePort(), length);
                 Message *message = new Message();
                 message->parse(buffer);
                 free(buffer);
-                _onMessage(message, _udp->remoteIP(), _udp->remotePort());
+                SNMP_PROBE(decode__end, message->getRequestID(),
+                        message->getType(), _udp->remoteIP(),
+                        _udp->remotePort(), length);
+                dispatch(message, _udp->remoteIP(), _udp->remotePort());
                 delete message;
+            } else {
+                SNMP_PROBE(dropped, 0, 0, _udp->remoteIP(), _udp->remotePort(),
+                        length);
             }
         }
 #endif
+        for (Handler *handler = _handlers; handler;) {
+            // Handler may detach itself
+            Handler *next = handler->_next;
+            handler->loop();
+            handler = next;
+        }
+        const unsigned long now = Clock::millis();
+        // Bounded, as a user handler may arm a timer already due
+        for (uint8_t count = 0; _timers && (count < TIMERS)
+                && (static_cast<long>(now - _timers->_deadline) >= 0); ++count) {
+            Timer *timer = _timers;
+            _timers = timer->_next;
+            timer->_armed = false;
+            if (timer->_period) {
+                unsigned long deadline = timer->_deadline + timer->_period;
+                if (static_cast<long>(now - deadline) >= 0) {
+                    // Skip missed periods
+                    deadline += ((now - deadline) / timer->_period + 1)
+                            * timer->_period;
+                }
+                insert(*timer, deadline);
+            }
+            timer->expire();
+        }
     }
 
     /**
      * @brief Network write operation
      *
-     * Builds message and write outgoing packet.
+     * Builds message and write outgoing packet. Over lwIP, the message is
+     * built straight to the pbuf sent.
      *
      * @param message %SNMP message to send.
      * @param ip IP address to send to.
@@ -104,21 +630,220 @@ public:
      * @return 1 if success, 0 if failure.
      */
     bool send(Message *message, const IPAddress ip, const uint16_t port) {
+        SNMP_PROBE(encode__start, message->getRequestID(), message->getType(),
+                ip, port, 0);
+        if (_writer) {
+            bool success = _writer(_udp, message, ip, port);
+            SNMP_PROBE(encode__end, message->getRequestID(), message->getType(),
+                    ip, port, message->ArrayBER::getSize());
+            SNMP_PROBE(sent, message->getRequestID(), message->getType(), ip,
+                    port, message->ArrayBER::getSize(), success);
+            return success;
+        }
 #if SNMP_STREAM
         _udp->beginPacket(ip, port);
         message->build(*_udp);
-        return _udp->endPacket();
+        SNMP_PROBE(encode__end, message->getRequestID(), message->getType(),
+                ip, port, message->ArrayBER::getSize());
+        bool success = _udp->endPacket();
+        SNMP_PROBE(sent, message->getRequestID(), message->getType(), ip, port,
+                message->ArrayBER::getSize(), success);
+        return success;
 #else
         uint32_t length = message->getSize(true);
         uint8_t *buffer = static_cast<uint8_t*>(malloc(length));
         message->build(buffer);
+        SNMP_PROBE(encode__end, message->getRequestID(), message->getType(),
+                ip, port, length);
         _udp->beginPacket(ip, port);
         _udp->write(buffer, length);
+        bool success = _udp->endPacket();
+        SNMP_PROBE(sent, message->getRequestID(), message->getType(), ip, port,
+                length, success);
         free(buffer);
-        return _udp->endPacket();
+        return success;
 #endif
     }
 
+    /**
+     * @brief Network write operation
+     *
+     * Writes an already encoded message as outgoing packet.
+     *
+     * @param buffer Pointer to the encoded message.
+     * @param length Length of the encoded message.
+     * @param ip IP address to send to.
+     * @param port UDP port to send to
+     * @return 1 if success, 0 if failure.
+     */
+    bool send(const uint8_t *buffer, const uint32_t length, const IPAddress ip,
+            const uint16_t port) {
+        _udp->beginPacket(ip, port);
+        _udp->write(buffer, length);
+        bool success = _udp->endPacket();
+        SNMP_PROBE(sent, 0, 0, ip, port, length, success);
+        return success;
+    }
+
+    /**
+     * @brief Attaches a handler.
+     *
+     * The handler is added at the head of the handlers list.
+     *
+     * @param handler Handler to attach.
+     */
+    void attach(Handler &handler) {
+        detach(handler);
+        handler._next = _handlers;
+        _handlers = &handler;
+    }
+
+    /**
+     * @brief Detaches a handler.
+     *
+     * @param handler Handler to detach.
+     */
+    void detach(Handler &handler) {
+        for (Handler **link = &_handlers; *link; link = &(*link)->_next) {
+            if (*link == &handler) {
+                *link = handler._next;
+                handler._next = nullptr;
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief Arms a timer.
+     *
+     * An armed timer is armed again with the new delay and period.
+     *
+     * @param timer Timer to arm.
+     * @param delay Delay before the first expiration, in milliseconds.
+     * @param period Period in milliseconds, 0 for a one-shot timer.
+     */
+    void schedule(Timer &timer, const unsigned long delay,
+            const unsigned long period = 0) {
+        cancel(timer);
+        timer._period = period;
+        insert(timer, Clock::millis() + delay);
+    }
+
+    /**
+     * @brief Disarms a timer.
+     *
+     * @param timer Timer to disarm.
+     */
+    void cancel(Timer &timer) {
+        if (timer._armed) {
+            for (Timer **link = &_timers; *link; link = &(*link)->_next) {
+                if (*link == &timer) {
+                    *link = timer._next;
+                    break;
+                }
+            }
+            timer._next = nullptr;
+            timer._armed = false;
+        }
+    }
+
+    /**
+     * @brief Gets the time until the next timer expires.
+     *
+     * A host or a low power board can sleep until then, if no packet is
+     * expected and no handler has pending work.
+     *
+     * @return Delay in milliseconds, 0 if a timer is due, 0xFFFFFFFF if no timer
+     * is armed.
+     */
+    const unsigned long nextDeadline() const {
+        if (!_timers) {
+            return 0xFFFFFFFF;
+        }
+        const long delay = static_cast<long>(_timers->_deadline - Clock::millis());
+        return delay > 0 ? delay : 0;
+    }
+
+    /**
+     * @brief Saves attached handlers state.
+     *
+     * Writes a checkpoint. Handlers without state are skipped. Call it
+     * periodically to restart quickly with restore().
+     *
+     * @param print Destination, a file for example.
+     * @return Count of bytes written.
+     */
+    size_t save(Print &print) const {
+        Checkpoint::Digest digest;
+        uint8_t count = 0;
+        for (Handler *handler = _handlers; handler; handler = handler->_next) {
+            if (handler->getKind()) {
+                record(digest, *handler);
+                count++;
+            }
+        }
+        size_t size = print.write(reinterpret_cast<const uint8_t*>("SNMP"), 4);
+        Checkpoint::write(print, Checkpoint::VERSION, 1);
+        Checkpoint::write(print, count, 1);
+        Checkpoint::write(print, 0, 2);
+        Checkpoint::write(print, digest.getLength(), 4);
+        Checkpoint::write(print, digest.getHash(), 4);
+        for (Handler *handler = _handlers; handler; handler = handler->_next) {
+            if (handler->getKind()) {
+                record(print, *handler);
+            }
+        }
+        return size == 4 ? Checkpoint::HEADER + digest.getLength() : 0;
+    }
+
+    /**
+     * @brief Restores attached handlers state.
+     *
+     * Handlers must be started with the same configuration before restore.
+     * Each record is restored to the first attached handler with the same kind
+     * and fingerprint, other records are ignored. The checkpoint is verified
+     * before any handler is restored.
+     *
+     * @param buffer Pointer to the checkpoint, a memory mapped file for example.
+     * @param length Length of the checkpoint.
+     * @return true if the checkpoint is valid, false otherwise.
+     */
+    bool restore(const uint8_t *buffer, const uint32_t length) {
+        if ((length < Checkpoint::HEADER) || memcmp(buffer, "SNMP", 4)
+                || (buffer[4] != Checkpoint::VERSION)) {
+            return false;
+        }
+        const uint8_t *pointer = buffer + 8;
+        const uint32_t size = Checkpoint::read(pointer, 4);
+        const uint32_t hash = Checkpoint::read(pointer, 4);
+        if ((size > length - Checkpoint::HEADER)
+                || (Checkpoint::hash(Checkpoint::BASIS, pointer, size) != hash)) {
+            return false;
+        }
+        const uint8_t *end = pointer + size;
+        for (uint8_t index = 0; index < buffer[5]; ++index) {
+            if (end - pointer < Checkpoint::RECORD) {
+                return false;
+            }
+            const uint8_t kind = *pointer;
+            pointer += 4;
+            const uint32_t fingerprint = Checkpoint::read(pointer, 4);
+            const uint32_t payload = Checkpoint::read(pointer, 4);
+            if (payload > static_cast<uint32_t>(end - pointer)) {
+                return false;
+            }
+            for (Handler *handler = _handlers; handler; handler = handler->_next) {
+                if ((handler->getKind() == kind)
+                        && (handler->getFingerprint() == fingerprint)) {
+                    handler->restore(pointer, payload);
+                    break;
+                }
+            }
+            pointer += (payload + 3) & ~3UL;
+        }
+        return true;
+    }
+
     /**
      * @brief Sets on message event user handler.
      *
@@ -138,12 +863,116 @@ private:
         _port = port;
     }
 
+    /**
+     * @brief Filters the incoming packet before it is decoded.
+     *
+     * @return true if every attached handler accepts the packet.
+     */
+    bool accept() {
+        const IPAddress remote = _udp->remoteIP();
+        const uint16_t port = _udp->remotePort();
+        for (Handler *handler = _handlers; handler; handler = handler->_next) {
+            if (!handler->accept(remote, port)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Dispatches an incoming message.
+     *
+     * The message is offered to each attached handler, then to the user message
+     * handler if no handler consumed it.
+     *
+     * @param message %SNMP message to dispatch.
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     */
+    void dispatch(const Message *message, const IPAddress remote,
+            const uint16_t port) {
+        SNMP_PROBE(handler__start, message->getRequestID(), message->getType(),
+                remote, port, 0);
+        for (Handler *handler = _handlers; handler; handler = handler->_next) {
+            if (handler->message(message, remote, port)) {
+                SNMP_PROBE(handler__end, message->getRequestID(),
+                        message->getType(), remote, port, 0);
+                return;
+            }
+        }
+        if (_onMessage) {
+            _onMessage(message, remote, port);
+        }
+        SNMP_PROBE(handler__end, message->getRequestID(), message->getType(),
+                remote, port, 0);
+    }
+
+    /** Maximum count of timers serviced by one call to loop(). */
+    static constexpr uint8_t TIMERS = 8;
+
+    /**
+     * @brief Inserts a timer in the list, sorted by deadline.
+     *
+     * Timers with the same deadline expire in the order they are armed.
+     *
+     * @param timer Timer to insert.
+     * @param deadline Time of expiration in milliseconds.
+     */
+    void insert(Timer &timer, const unsigned long deadline) {
+        timer._deadline = deadline;
+        timer._armed = true;
+        Timer **link = &_timers;
+        while (*link && (static_cast<long>((*link)->_deadline - deadline) <= 0)) {
+            link = &(*link)->_next;
+        }
+        timer._next = *link;
+        *link = &timer;
+    }
+
+    /**
+     * @brief Writes the checkpoint record of a handler.
+     *
+     * @param print Destination.
+     * @param handler Handler.
+     */
+    static void record(Print &print, const Handler &handler) {
+        Checkpoint::Digest digest;
+        handler.save(digest);
+        Checkpoint::write(print, handler.getKind(), 4);
+        Checkpoint::write(print, handler.getFingerprint(), 4);
+        Checkpoint::write(print, digest.getLength(), 4);
+        handler.save(print);
+        Checkpoint::pad(print, digest.getLength());
+    }
+
+    /**
+     * @brief Encodes and sends a message with the writer of a transport.
+     *
+     * @tparam T Transport class, with a send() method.
+     * @param udp UDP client.
+     * @param message %SNMP message to send.
+     * @param ip IP address to send to.
+     * @param port UDP port to send to.
+     * @return true if success, false if failure.
+     */
+    template<class T>
+    static bool write(UDP *udp, Message *message, const IPAddress ip,
+            const uint16_t port) {
+        return static_cast<T*>(udp)->send(message, ip, port);
+    }
+
     /** UDP port .*/
     uint16_t _port = Port::SNMP;
     /** UDP client. */
     UDP *_udp = nullptr;
+    /** Writer of the transport, nullptr to write through the UDP client. */
+    Writer _writer = nullptr;
     /** On message event user handler. */
     Event _onMessage = nullptr;
+    /** Attached handlers list. */
+    Handler *_handlers = nullptr;
+    /** Armed timers list, sorted by deadline. */
+    Timer *_timers = nullptr;
 
     friend class Agent;
     friend class Manager;
@@ -0,0 +1,708 @@
+#ifndef SNMPAGGREGATOR_H_
+#define SNMPAGGREGATOR_H_
+
+#include "SNMPGather.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @struct Field
+ * @brief Helper struct to handle fields of an aggregated OID.
+ *
+ * The field is also the column arc of the summary subtree.
+ */
+struct Field {
+    /**
+     * @brief Enumerates all fields.
+     */
+    enum : uint8_t {
+        Sum = 1,     /**< 1, sum of the values. */
+        Minimum,     /**< 2, lowest value. */
+        Maximum,     /**< 3, highest value. */
+        Count,       /**< 4, count of targets with a value. */
+        Rate,        /**< 5, increase of counters per second. */
+    };
+    /** Mask of all fields. */
+    static constexpr uint8_t ALL = (1 << Sum) | (1 << Minimum) | (1 << Maximum)
+            | (1 << Count) | (1 << Rate);
+};
+
+/**
+ * @class Aggregator
+ * @brief Edge node polling local agents and forwarding summaries upstream.
+ *
+ * At each period, a Gather polls the local targets. For each OID, values of
+ * all targets are summarized: sum, minimum, maximum, count and rate. The rate
+ * is the increase of Counter32 and Counter64 values per second, wraps
+ * handled. Only INTEGER, Counter32, Gauge32, TimeTicks and Counter64 values
+ * are summarized, other values are skipped and counted.
+ *
+ * Summaries are available upstream in 2 ways.
+ *
+ * - As SNMPV2TRAP messages sent after each sweep. With change only, a field
+ * is sent only if its value changed. Variable bindings are batched, several
+ * per trap.
+ * - As a subtree of the agent, base.field.oid, that the central manager reads
+ * with a single GETBULKREQUEST.
+ *
+ * Sum, minimum and maximum are Counter64, negative values read as 0. Count
+ * and rate are Gauge32. snmpTrapOID.0 of the traps is base.0.1.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Manager manager;
+ * SNMP::Agent agent;
+ * SNMP::Aggregator<32, 2> aggregator(manager, agent);
+ *
+ * const char *OIDS[] = { "1.3.6.1.2.1.2.2.1.10.1", "1.3.6.1.2.1.2.2.1.16.1" };
+ *
+ * void setup() {
+ *     // ...
+ *     aggregator.setUpstream(IPAddress(10, 0, 0, 1));
+ *     aggregator.setChangeOnly(true);
+ *     aggregator.begin("1.3.6.1.4.1.65000.2", TARGETS, COUNT, OIDS, 2, 60000);
+ * }
+ * ```
+ *
+ * @warning Base, targets, OIDs and community are not copied and must remain
+ * valid until stopped.
+ *
+ * @tparam T Maximum count of targets.
+ * @tparam O Maximum count of OIDs.
+ * @tparam W Maximum count of targets polled at once, up to 255.
+ */
+template<const uint16_t T, const uint8_t O, const uint8_t W = 16>
+class Aggregator: public Handler {
+public:
+    /**
+     * @struct Summary
+     * @brief Summary of an OID.
+     */
+    struct Summary {
+        /** Sum of the values. */
+        int64_t _sum;
+        /** Lowest value. */
+        int64_t _minimum;
+        /** Highest value. */
+        int64_t _maximum;
+        /** Increase of counters per second. */
+        uint32_t _rate;
+        /** Count of targets with a value. */
+        uint16_t _count;
+        /** Count of targets with a value that is not a number, skipped. */
+        uint16_t _skipped;
+    };
+
+    /**
+     * @brief Creates an Aggregator object.
+     *
+     * @param manager %SNMP manager used to poll local agents.
+     * @param agent %SNMP agent used to send traps and serve the subtree.
+     */
+    Aggregator(Manager &manager, Agent &agent) :
+            _agent(agent), _gather(manager) {
+    }
+
+    /**
+     * @brief Aggregator destructor.
+     */
+    virtual ~Aggregator() {
+        stop();
+    }
+
+    /**
+     * @brief Starts polling.
+     *
+     * The first sweep starts on next loop.
+     *
+     * @param base Base OID of the summary subtree.
+     * @param targets IP addresses of the local agents.
+     * @param count Count of targets, T at most.
+     * @param oids OIDs to poll.
+     * @param size Count of OIDs, O at most.
+     * @param period Period of the sweeps in milliseconds.
+     * @param version %SNMP version.
+     * @param community %SNMP community of local agents and of the subtree.
+     * @return true if started, false otherwise.
+     */
+    bool begin(const char *base, const IPAddress *targets,
+            const uint16_t count, const char *const *oids, const uint8_t size,
+            const uint32_t period, const uint8_t version = Version::V2C,
+            const char *community = "public") {
+        stop();
+        if (!count || (count > T) || !size || (size > O)
+                || (strlen(base) > LENGTH - 12)) {
+            return false;
+        }
+        _base = base;
+        _targets = targets;
+        _count = count;
+        _oids = oids;
+        _size = size;
+        _period = period;
+        _version = version;
+        _community = community;
+        _sweeps = 0;
+        for (uint8_t oid = 0; oid < size; ++oid) {
+            _summaries[oid] = { };
+        }
+        memset(_valid, 0, sizeof(_valid));
+        _polling = false;
+        _running = true;
+        _agent.attach(*this);
+        return true;
+    }
+
+    /**
+     * @brief Stops polling.
+     */
+    void stop() {
+        if (_running) {
+            _agent.detach(*this);
+            _gather.stop();
+            _running = false;
+        }
+    }
+
+    /**
+     * @brief Enables traps.
+     *
+     * @param destination IP address of the central manager.
+     * @param port UDP port of the central manager.
+     */
+    void setUpstream(const IPAddress destination,
+            const uint16_t port = Port::Trap) {
+        _destination = destination;
+        _port = port;
+        _upstream = true;
+    }
+
+    /**
+     * @brief Sets change only traps.
+     *
+     * @param only true to send only the fields that changed.
+     */
+    void setChangeOnly(const bool only) {
+        _only = only;
+    }
+
+    /**
+     * @brief Sets the fields sent in traps.
+     *
+     * @param fields Mask of fields, 1 << Field::Sum for instance.
+     * @see Field.
+     */
+    void setFields(const uint8_t fields) {
+        _fields = fields;
+    }
+
+    /**
+     * @brief Sets the maximum count of variable bindings of a trap.
+     *
+     * @param batch Count of variable bindings.
+     */
+    void setBatch(const uint8_t batch) {
+        _batch = batch && (batch < BATCH) ? batch : BATCH;
+    }
+
+    /**
+     * @brief Gets the summary of an OID.
+     *
+     * @param oid Index of the OID.
+     * @return Summary of the last sweep.
+     */
+    const Summary& getSummary(const uint8_t oid) const {
+        return _summaries[oid];
+    }
+
+    /**
+     * @brief Gets the count of sweeps done.
+     *
+     * @return Count of sweeps.
+     */
+    const uint32_t getSweeps() const {
+        return _sweeps;
+    }
+
+    /**
+     * @brief Gets the count of traps sent.
+     *
+     * @return Count of traps.
+     */
+    const uint32_t getTraps() const {
+        return _traps;
+    }
+
+    /**
+     * @brief Processes an incoming message.
+     *
+     * Answers GETREQUEST, GETNEXTREQUEST and GETBULKREQUEST messages whose
+     * variable bindings all fall in the summary subtree, or are a prefix of
+     * its base for GETNEXTREQUEST and GETBULKREQUEST. Other messages are left
+     * to the agent.
+     *
+     * @param message %SNMP message to process.
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     * @return true if the message was answered.
+     */
+    virtual bool message(const Message *message, const IPAddress remote,
+            const uint16_t port) {
+        const uint8_t type = message->getType();
+        if (((type != Type::GetRequest) && (type != Type::GetNextRequest)
+                && (type != Type::GetBulkRequest))
+                || strcmp(message->getCommunity(), _community)) {
+            return false;
+        }
+        VarBindList *varbindlist = message->getVarBindList();
+        const uint8_t count = varbindlist->count();
+        Position positions[LIMIT];
+        if (!count || (count > LIMIT)) {
+            return false;
+        }
+        for (uint8_t index = 0; index < count; ++index) {
+            const char *name = (*varbindlist)[index]->getName();
+            if (!(type == Type::GetRequest ?
+                    match(name, positions[index]) :
+                    next(name, positions[index]))) {
+                return false;
+            }
+        }
+        Message *response = new Message(message->getVersion(), _community,
+                Type::GetResponse);
+        response->setRequestID(message->getRequestID());
+        uint8_t added = 0;
+        for (uint8_t index = 0; index < count; ++index) {
+            add(response, positions[index]);
+            added++;
+        }
+        if (type == Type::GetBulkRequest) {
+            // Repeaters are walked in turn, as many as the response holds
+            const uint8_t repeaters = message->getNonRepeaters();
+            bool ended[LIMIT] = { };
+            bool walking = repeaters < count;
+            for (uint8_t repetition = 1; walking
+                    && (repetition < message->getMaxRepetition());
+                    ++repetition) {
+                walking = false;
+                for (uint8_t index = repeaters; (index < count)
+                        && (added < LIMIT); ++index) {
+                    if (!ended[index] && advance(positions[index])) {
+                        add(response, positions[index]);
+                        walking = true;
+                    } else {
+                        // Past the subtree, the last OID is repeated
+                        ended[index] = true;
+                        end(response, positions[index]);
+                    }
+                    added++;
+                }
+            }
+        }
+        _agent.send(response, remote, port);
+        delete response;
+        return true;
+    }
+
+    /**
+     * @brief Processes pending work.
+     *
+     * Starts a sweep at each period, summarizes and forwards it when done.
+     */
+    virtual void loop() {
+        const unsigned long now = Clock::millis();
+        if (_polling) {
+            if (_gather.isRunning()) {
+                return;
+            }
+            _polling = false;
+            summarize(_start - _previous);
+            _previous = _start;
+            _sweeps++;
+            if (_upstream) {
+                forward();
+            }
+        }
+        if (!_sweeps || (now - _start >= _period)) {
+            if (_gather.begin(_targets, _count, _oids, _size, _version,
+                    _community, _period)) {
+                _start = now;
+                _polling = true;
+            }
+        }
+    }
+
+private:
+    /** Maximum length of an OID. */
+    static constexpr uint8_t LENGTH = 64;
+    /** Maximum count of variable bindings of a message. */
+    static constexpr uint8_t LIMIT = SNMP_VECTOR ? 64 : SNMP_CAPACITY;
+    /** Default maximum count of variable bindings of a trap. */
+    static constexpr uint8_t BATCH = LIMIT - 2;
+
+    /**
+     * @struct Position
+     * @brief Position in the summary subtree.
+     */
+    struct Position {
+        /** Field, column arc. */
+        uint8_t _field;
+        /** Index of the OID, row arc minus 1. */
+        uint8_t _oid;
+    };
+
+    /**
+     * @brief Summarizes the last sweep.
+     *
+     * @param elapsed Time since the previous sweep in milliseconds.
+     */
+    void summarize(const unsigned long elapsed) {
+        for (uint8_t oid = 0; oid < _size; ++oid) {
+            Summary &summary = _summaries[oid];
+            summary = { };
+            uint64_t increase = 0;
+            for (uint16_t target = 0; target < _count; ++target) {
+                const uint32_t bit = target * O + oid;
+                const uint8_t mask = 1 << (bit & 7);
+                if (_gather.getState(target, oid) != State::Value) {
+                    _valid[bit >> 3] &= ~mask;
+                    continue;
+                }
+                const uint8_t type = _gather.getType(target, oid);
+                if (!isNumber(type)) {
+                    _valid[bit >> 3] &= ~mask;
+                    summary._skipped++;
+                    continue;
+                }
+                const int64_t value = _gather.getInteger(target, oid);
+                if (!summary._count || (value < summary._minimum)) {
+                    summary._minimum = value;
+                }
+                if (!summary._count || (value > summary._maximum)) {
+                    summary._maximum = value;
+                }
+                summary._sum += value;
+                summary._count++;
+                if ((type == Type::Counter32) || (type == Type::Counter64)) {
+                    uint64_t delta = static_cast<uint64_t>(value)
+                            - _samples[target][oid];
+                    if (type == Type::Counter32) {
+                        delta &= 0xFFFFFFFF;
+                    }
+                    if (_valid[bit >> 3] & mask) {
+                        increase += delta;
+                    }
+                    _samples[target][oid] = value;
+                    _valid[bit >> 3] |= mask;
+                } else {
+                    _valid[bit >> 3] &= ~mask;
+                }
+            }
+            if (elapsed) {
+                const uint64_t rate = increase * 1000 / elapsed;
+                summary._rate = rate > 0xFFFFFFFF ? 0xFFFFFFFF : rate;
+            }
+        }
+    }
+
+    /**
+     * @brief Checks if a type is summarized.
+     *
+     * @param type BER type.
+     * @return true for INTEGER, Counter32, Gauge32, TimeTicks and Counter64.
+     */
+    static bool isNumber(const uint8_t type) {
+        switch (type) {
+        case Type::Integer:
+        case Type::Counter32:
+        case Type::Gauge32:
+        case Type::TimeTicks:
+        case Type::Counter64:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * @brief Sends the summaries in batched traps.
+     */
+    void forward() {
+        Message *message = nullptr;
+        uint8_t batched = 0;
+        for (uint8_t oid = 0; oid < _size; ++oid) {
+            for (uint8_t field = Field::Sum; field <= Field::Rate; ++field) {
+                if (!(_fields & (1 << field))) {
+                    continue;
+                }
+                const uint64_t value = getValue({ field, oid });
+                uint64_t &forwarded = _forwarded[oid][field - Field::Sum];
+                if (_only && (_sweeps > 1) && (value == forwarded)) {
+                    continue;
+                }
+                forwarded = value;
+                if (!message) {
+                    char name[LENGTH];
+                    snprintf(name, LENGTH, "%s.0.1", _base);
+                    message = new Message(Version::V2C, _community,
+                            Type::SNMPv2Trap);
+                    message->setSNMPTrapOID(name);
+                }
+                add(message, { field, oid });
+                if (++batched == _batch) {
+                    send(message);
+                    message = nullptr;
+                    batched = 0;
+                }
+            }
+        }
+        if (message) {
+            send(message);
+        }
+    }
+
+    /**
+     * @brief Sends a trap upstream.
+     *
+     * @param message SNMPV2TRAP message, deleted.
+     */
+    void send(Message *message) {
+        if (_agent.send(message, _destination, _port)) {
+            _traps++;
+        }
+        delete message;
+    }
+
+    /**
+     * @brief Gets the value of a field.
+     *
+     * @param position Position in the subtree.
+     * @return Value of the field.
+     */
+    const uint64_t getValue(const Position &position) const {
+        const Summary &summary = _summaries[position._oid];
+        int64_t value = 0;
+        switch (position._field) {
+        case Field::Sum:
+            value = summary._sum;
+            break;
+        case Field::Minimum:
+            value = summary._minimum;
+            break;
+        case Field::Maximum:
+            value = summary._maximum;
+            break;
+        case Field::Count:
+            return summary._count;
+        case Field::Rate:
+            return summary._rate;
+        }
+        return value < 0 ? 0 : value;
+    }
+
+    /**
+     * @brief Adds a field to a message.
+     *
+     * @param message %SNMP message.
+     * @param position Position in the subtree.
+     */
+    void add(Message *message, const Position &position) {
+        char name[LENGTH];
+        snprintf(name, LENGTH, "%s.%u.%u", _base, position._field,
+                position._oid + 1);
+        const uint64_t value = getValue(position);
+        if (position._field >= Field::Count) {
+            message->add(name, new Gauge32BER(value));
+        } else {
+            message->add(name, new Counter64BER(value));
+        }
+    }
+
+    /**
+     * @brief Adds an endOfMibView exception to a message.
+     *
+     * @param message %SNMP message.
+     * @param position Last position in the subtree.
+     */
+    void end(Message *message, const Position &position) {
+        char name[LENGTH];
+        snprintf(name, LENGTH, "%s.%u.%u", _base, position._field,
+                position._oid + 1);
+        message->add(name, new EndOfMIBViewBER());
+    }
+
+    /**
+     * @brief Locates an OID relative to the subtree.
+     *
+     * @param name OID.
+     * @param field Column arc, 0 if missing.
+     * @param row Row arc, 0 if missing.
+     * @param extra true if the OID has arcs after the row.
+     * @return Negative if before the subtree, 0 if inside or a strict prefix
+     * of the base, positive if after.
+     */
+    int8_t locate(const char *name, uint32_t &field, uint32_t &row,
+            bool &extra) const {
+        char *pointer = const_cast<char*>(name);
+        const char *base = _base;
+        while (*base) {
+            if (!*pointer) {
+                // Prefix of the base, the subtree comes next
+                field = row = 0;
+                extra = false;
+                return 0;
+            }
+            const unsigned long arc = strtoul(pointer, &pointer, 10);
+            const unsigned long reference = strtoul(base,
+                    const_cast<char**>(&base), 10);
+            if (arc != reference) {
+                return arc < reference ? -1 : 1;
+            }
+            pointer += *pointer == '.';
+            base += *base == '.';
+        }
+        field = *pointer ? strtoul(pointer, &pointer, 10) : 0;
+        pointer += *pointer == '.';
+        row = *pointer ? strtoul(pointer, &pointer, 10) : 0;
+        extra = *pointer;
+        return 0;
+    }
+
+    /**
+     * @brief Matches an OID of the subtree exactly.
+     *
+     * @param name OID.
+     * @param position Position found.
+     * @return true if found.
+     */
+    bool match(const char *name, Position &position) const {
+        uint32_t field = 0, row = 0;
+        bool extra = false;
+        if (locate(name, field, row, extra) || extra || (field < Field::Sum)
+                || (field > Field::Rate) || !row || (row > _size)) {
+            return false;
+        }
+        position = { static_cast<uint8_t>(field), static_cast<uint8_t>(row - 1) };
+        return true;
+    }
+
+    /**
+     * @brief Finds the OID of the subtree following an OID.
+     *
+     * @param name OID.
+     * @param position Position found.
+     * @return true if found.
+     */
+    bool next(const char *name, Position &position) const {
+        uint32_t field = 0, row = 0;
+        bool extra = false;
+        // OIDs outside the subtree belong to the agent MIB
+        if (locate(name, field, row, extra)) {
+            return false;
+        }
+        if (field < Field::Sum) {
+            position = { Field::Sum, 0 };
+            return true;
+        }
+        if (field > Field::Rate) {
+            return false;
+        }
+        // Row arcs are 1 based, row 0 and missing row both precede row 1
+        position = { static_cast<uint8_t>(field), 0 };
+        if (row > _size) {
+            return advance(position, _size - 1);
+        }
+        return row ? advance(position, row - 1) : true;
+    }
+
+    /**
+     * @brief Moves to the next OID of the subtree.
+     *
+     * @param position Position, updated.
+     * @param oid Index of the current OID.
+     * @return true if found, false at the end of the subtree.
+     */
+    bool advance(Position &position, const uint8_t oid) const {
+        if (oid + 1 < _size) {
+            position._oid = oid + 1;
+            return true;
+        }
+        if (position._field < Field::Rate) {
+            position = { static_cast<uint8_t>(position._field + 1), 0 };
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Moves to the next OID of the subtree.
+     *
+     * @param position Position, updated.
+     * @return true if found, false at the end of the subtree.
+     */
+    bool advance(Position &position) const {
+        return advance(position, position._oid);
+    }
+
+    /** %SNMP agent. */
+    Agent &_agent;
+    /** Gather polling local agents. */
+    Gather<T, O, W, 9> _gather;
+    /** True if attached. */
+    bool _running = false;
+    /** True if a sweep is in progress. */
+    bool _polling = false;
+    /** True if traps are sent. */
+    bool _upstream = false;
+    /** True if only changed fields are sent. */
+    bool _only = false;
+    /** Mask of fields sent. */
+    uint8_t _fields = Field::ALL;
+    /** Maximum count of variable bindings of a trap. */
+    uint8_t _batch = BATCH;
+    /** Base OID of the subtree. */
+    const char *_base = nullptr;
+    /** IP addresses of the local agents. */
+    const IPAddress *_targets = nullptr;
+    /** Count of targets. */
+    uint16_t _count = 0;
+    /** OIDs polled. */
+    const char *const *_oids = nullptr;
+    /** Count of OIDs. */
+    uint8_t _size = 0;
+    /** Period of the sweeps. */
+    uint32_t _period = 0;
+    /** %SNMP version. */
+    uint8_t _version = Version::V2C;
+    /** %SNMP community. */
+    const char *_community = "public";
+    /** IP address of the central manager. */
+    IPAddress _destination;
+    /** UDP port of the central manager. */
+    uint16_t _port = Port::Trap;
+    /** Time of start of the current sweep. */
+    unsigned long _start = 0;
+    /** Time of start of the previous sweep. */
+    unsigned long _previous = 0;
+    /** Count of sweeps. */
+    uint32_t _sweeps = 0;
+    /** Count of traps sent. */
+    uint32_t _traps = 0;
+    /** Summaries of the last sweep. */
+    Summary _summaries[O];
+    /** Values last forwarded. */
+    uint64_t _forwarded[O][Field::Rate];
+    /** Counter values of the previous sweep. */
+    uint64_t _samples[T][O];
+    /** Bits of valid counter values of the previous sweep. */
+    uint8_t _valid[(T * O + 7) / 8];
+};
+
+} // namespace SNMP
+
+#endif /* SNMPAGGREGATOR_H_ */
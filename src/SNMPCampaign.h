@@ -0,0 +1,591 @@
+#ifndef SNMPCAMPAIGN_H_
+#define SNMPCAMPAIGN_H_
+
+#include "SNMP.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @struct Result
+ * @brief Helper struct to handle result of a request sent to a target.
+ */
+struct Result {
+    /**
+     * @brief Enumerates all possible results.
+     */
+    enum : uint8_t {
+        Success,    /**< 0, response received and verified. */
+        Timeout,    /**< 1, no response after all retries. */
+        Error,      /**< 2, response received with an error status. */
+        Mismatch,   /**< 3, response received but values differ. */
+        Count,      /**< Count of results. */
+    };
+};
+
+/**
+ * @class Campaign
+ * @brief SETREQUEST campaign over a list of targets.
+ *
+ * Pushes the same configuration to many agents and verifies it.
+ *
+ * - A SETREQUEST is built for each target by the user build handler.
+ * - Up to U targets are configured at once.
+ * - A request without response is sent again, up to the retries count.
+ * - The variable bindings of the GETRESPONSE are compared to those of the
+ * SETREQUEST. The agent must return the values it has set.
+ * - The user result handler is called once per target, and results are counted.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Manager snmp;
+ * SNMP::Campaign<16> campaign(snmp);
+ *
+ * void onBuild(SNMP::Message *message, const IPAddress target) {
+ *     message->add("1.3.6.1.4.1.19947.1.3.2.1.9.1", new SNMP::IntegerBER(0));
+ * }
+ *
+ * void onResult(const IPAddress target, const uint8_t result, const SNMP::Message *message) {
+ *     // User code here...
+ * }
+ *
+ * void setup() {
+ *     // ...
+ *     campaign.onBuild(onBuild);
+ *     campaign.onResult(onResult);
+ *     campaign.begin(TARGETS, COUNT, SNMP::Version::V2C, "guru");
+ * }
+ * ```
+ *
+ * @warning Targets and community are not copied and must remain valid until the
+ * campaign is complete.
+ *
+ * @tparam U Maximum count of targets configured at once, up to 255.
+ */
+template<const uint8_t U>
+class Campaign: public Handler {
+public:
+    /**
+     * @brief On build event user handler type.
+     *
+     * The handler adds the variable bindings to set to the message.
+     *
+     * @param message SETREQUEST message to fill.
+     * @param target IP address of the target.
+     */
+    using Build = void (*)(Message*, const IPAddress);
+
+    /**
+     * @brief On result event user handler type.
+     *
+     * @param target IP address of the target.
+     * @param result Result of the campaign for the target. @see Result.
+     * @param message GETRESPONSE message, nullptr on timeout.
+     */
+    using Event = void (*)(const IPAddress, const uint8_t, const Message*);
+
+    /**
+     * @brief Creates a Campaign object.
+     *
+     * @param manager %SNMP manager used to send requests and receive responses.
+     */
+    Campaign(Manager &manager) :
+            _manager(manager) {
+    }
+
+    /**
+     * @brief Campaign destructor.
+     *
+     * Stops the campaign.
+     */
+    virtual ~Campaign() {
+        stop();
+    }
+
+    /**
+     * @brief Starts a campaign.
+     *
+     * @param targets IP addresses of the targets.
+     * @param count Count of targets.
+     * @param version %SNMP version.
+     * @param community %SNMP read/write community.
+     * @param port UDP port of the targets.
+     * @return true if the campaign is started, false otherwise.
+     */
+    bool begin(const IPAddress *targets, const uint16_t count,
+            const uint8_t version, const char *community,
+            const uint16_t port = Port::SNMP) {
+        stop();
+        if (!count || !_onBuild) {
+            return false;
+        }
+        _targets = targets;
+        _count = count;
+        _version = version;
+        _community = community;
+        _port = port;
+        _next = 0;
+        _done = 0;
+        _retried = 0;
+        for (uint8_t index = 0; index < Result::Count; ++index) {
+            _results[index] = 0;
+        }
+        _running = true;
+        _manager.attach(*this);
+        return true;
+    }
+
+    /**
+     * @brief Stops the campaign.
+     *
+     * Requests in flight are abandoned.
+     */
+    void stop() {
+        if (_running) {
+            _manager.detach(*this);
+            _running = false;
+        }
+        for (uint8_t index = 0; index < U; ++index) {
+            release(index);
+        }
+    }
+
+    /**
+     * @brief Sets the request timeout.
+     *
+     * @param timeout Timeout in milliseconds.
+     */
+    void setTimeout(const uint16_t timeout) {
+        _timeout = timeout;
+    }
+
+    /**
+     * @brief Sets the count of retries.
+     *
+     * @param retries Count of requests sent again after a timeout.
+     */
+    void setRetries(const uint8_t retries) {
+        _retries = retries;
+    }
+
+    /**
+     * @brief Sets on build event user handler.
+     *
+     * @param event Event handler.
+     */
+    void onBuild(Build event) {
+        _onBuild = event;
+    }
+
+    /**
+     * @brief Sets on result event user handler.
+     *
+     * @param event Event handler.
+     */
+    void onResult(Event event) {
+        _onResult = event;
+    }
+
+    /**
+     * @brief Checks if the campaign is running.
+     *
+     * @return true if running, false otherwise.
+     */
+    const bool isRunning() const {
+        return _running;
+    }
+
+    /**
+     * @brief Gets the count of targets.
+     *
+     * @return Count of targets.
+     */
+    const uint16_t getCount() const {
+        return _count;
+    }
+
+    /**
+     * @brief Gets the count of targets done.
+     *
+     * @return Count of targets with a result.
+     */
+    const uint16_t getDone() const {
+        return _done;
+    }
+
+    /**
+     * @brief Gets the count of targets with a given result.
+     *
+     * @param result Result. @see Result.
+     * @return Count of targets.
+     */
+    const uint16_t getCount(const uint8_t result) const {
+        return result < Result::Count ? _results[result] : 0;
+    }
+
+    /**
+     * @brief Gets the count of requests sent again.
+     *
+     * @return Count of retries.
+     */
+    const uint32_t getRetried() const {
+        return _retried;
+    }
+
+    /**
+     * @brief Gets the kind of checkpoint record.
+     *
+     * @return Kind.
+     */
+    virtual const uint8_t getKind() const {
+        return KIND;
+    }
+
+    /**
+     * @brief Gets the fingerprint of the campaign configuration.
+     *
+     * @return Hash of version, community, port and targets.
+     */
+    virtual const uint32_t getFingerprint() const {
+        uint32_t hash = Checkpoint::hash(Checkpoint::BASIS, &_version, 1);
+        hash = Checkpoint::hash(hash, _community);
+        hash = Checkpoint::hash(hash, &_port, sizeof(_port));
+        for (uint16_t index = 0; index < _count; ++index) {
+            for (uint8_t part = 0; part < 4; ++part) {
+                const uint8_t byte = _targets[index][part];
+                hash = Checkpoint::hash(hash, &byte, 1);
+            }
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Saves the campaign progress and counters.
+     *
+     * Targets in flight are saved to be started again after restore.
+     *
+     * @param print Destination.
+     */
+    virtual void save(Print &print) const {
+        Checkpoint::write(print, _next, 2);
+        Checkpoint::write(print, _done, 2);
+        Checkpoint::write(print, _retried, 4);
+        for (uint8_t index = 0; index < Result::Count; ++index) {
+            Checkpoint::write(print, _results[index], 2);
+        }
+        uint16_t count = 0;
+        for (uint8_t slot = 0; slot < U; ++slot) {
+            if (_requests[slot]._buffer) {
+                count++;
+            }
+        }
+        Checkpoint::write(print, count, 2);
+        Checkpoint::write(print, 0, 2);
+        for (uint8_t slot = 0; slot < U; ++slot) {
+            if (_requests[slot]._buffer) {
+                Checkpoint::write(print, _requests[slot]._target, 2);
+            }
+        }
+    }
+
+    /**
+     * @brief Restores the campaign progress and counters.
+     *
+     * The campaign must be started with the same configuration. Requests in
+     * flight are abandoned and saved targets in flight are started again.
+     *
+     * @param data Pointer to the record payload.
+     * @param length Length of the payload.
+     * @return true if success, false otherwise.
+     */
+    virtual bool restore(const uint8_t *data, const uint32_t length) {
+        const uint8_t *pointer = data + 16;
+        const uint16_t count = length >= 20 ? Checkpoint::read(pointer, 2) : 0;
+        if (!_running || (length < 20) || (count > U)
+                || (length < 20 + 2 * count)) {
+            return false;
+        }
+        pointer = data;
+        _next = Checkpoint::read(pointer, 2);
+        _done = Checkpoint::read(pointer, 2);
+        _retried = Checkpoint::read(pointer, 4);
+        for (uint8_t index = 0; index < Result::Count; ++index) {
+            _results[index] = Checkpoint::read(pointer, 2);
+        }
+        pointer += 4;
+        for (uint8_t slot = 0; slot < U; ++slot) {
+            release(slot);
+        }
+        for (uint8_t slot = 0; slot < count; ++slot) {
+            const uint16_t target = Checkpoint::read(pointer, 2);
+            if ((target >= _count) || !start(slot, target)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Processes an incoming message.
+     *
+     * Matches a GETRESPONSE to its request by request identifier and sender, then
+     * verifies the variable bindings.
+     *
+     * @param message %SNMP message to process.
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     * @return true if the message answers a request in flight.
+     */
+    virtual bool message(const Message *message, const IPAddress remote,
+            const uint16_t port) {
+        if (message->getType() != Type::GetResponse) {
+            return false;
+        }
+        const uint32_t id = message->getRequestID();
+        if ((id & 0xFF000000) != ID) {
+            return false;
+        }
+        const uint8_t slot = id & 0xFF;
+        if (slot >= U) {
+            return false;
+        }
+        Request &request = _requests[slot];
+        if (!request._buffer || (request._id != id)
+                || !(_targets[request._target] == remote)) {
+            return false;
+        }
+        uint8_t result = Result::Success;
+        if (message->getErrorStatus() != Error::NoError) {
+            result = Result::Error;
+        } else if (!verify(request, message->getVarBindList())) {
+            result = Result::Mismatch;
+        }
+        complete(slot, result, message);
+        return true;
+    }
+
+    /**
+     * @brief Processes pending work.
+     *
+     * - Sends again or completes timed out requests.
+     * - Starts next targets within the window.
+     */
+    virtual void loop() {
+        const unsigned long now = Clock::millis();
+        for (uint8_t slot = 0; slot < U; ++slot) {
+            Request &request = _requests[slot];
+            if (request._buffer && (now - request._time >= _timeout)) {
+                if (request._attempts <= _retries) {
+                    SNMP_PROBE(retransmit, request._id, Type::SetRequest,
+                            _targets[request._target], _port, request._length,
+                            request._attempts);
+                    send(request);
+                    _retried++;
+                } else {
+                    SNMP_PROBE(timeout, request._id, Type::SetRequest,
+                            _targets[request._target], _port, request._length,
+                            request._attempts);
+                    complete(slot, Result::Timeout, nullptr);
+                }
+            }
+        }
+        for (uint8_t slot = 0; (slot < U) && (_next < _count); ++slot) {
+            if (!_requests[slot]._buffer) {
+                if (!start(slot, _next)) {
+                    break;
+                }
+                _next++;
+            }
+        }
+        if ((_done == _count) && _running) {
+            stop();
+        }
+    }
+
+private:
+    /**
+     * Request identifier prefix of the requests.
+     *
+     * The low byte is the slot, the next byte is a tag incremented on each use
+     * of the slot.
+     */
+    static constexpr uint32_t ID = 0x41000000;
+    /** Kind of checkpoint record. */
+    static constexpr uint8_t KIND = 'C';
+    /** Default request timeout in milliseconds. */
+    static constexpr uint16_t TIMEOUT = 1000;
+    /** Default count of retries. */
+    static constexpr uint8_t RETRIES = 2;
+
+    /**
+     * @struct Request
+     * @brief Request in flight.
+     */
+    struct Request {
+        /** Encoded SETREQUEST. */
+        uint8_t *_buffer = nullptr;
+        /** Length of the encoded SETREQUEST. */
+        uint16_t _length = 0;
+        /** Offset of the variable bindings list in the encoded SETREQUEST. */
+        uint16_t _offset = 0;
+        /** Index of the target. */
+        uint16_t _target = 0;
+        /** Request identifier. */
+        uint32_t _id = 0;
+        /** Time of last sending. */
+        unsigned long _time = 0;
+        /** Count of requests sent. */
+        uint8_t _attempts = 0;
+        /** Tag incremented on each use of the slot. */
+        uint8_t _tag = 0;
+    };
+
+    /**
+     * @brief Builds and sends the SETREQUEST for a target.
+     *
+     * @param slot Free slot.
+     * @param target Index of the target.
+     * @return true if success, false if memory is exhausted.
+     */
+    bool start(const uint8_t slot, const uint16_t target) {
+        Request &request = _requests[slot];
+        request._id = ID | (static_cast<uint32_t>(++request._tag) << 8) | slot;
+        Message *message = new Message(_version, _community, Type::SetRequest);
+        message->setRequestID(request._id);
+        _onBuild(message, _targets[target]);
+        request._length = message->getSize(true);
+        request._buffer = static_cast<uint8_t*>(malloc(request._length));
+        if (request._buffer) {
+            message->build(request._buffer);
+            // Message, version, community, PDU, request identifier, error
+            // status and error index then variable bindings list
+            uint8_t *pointer = Encoding::skip(request._buffer, false);
+            for (uint8_t index = 0; index < 2; ++index) {
+                pointer = Encoding::skip(pointer, true);
+            }
+            pointer = Encoding::skip(pointer, false);
+            for (uint8_t index = 0; index < 3; ++index) {
+                pointer = Encoding::skip(pointer, true);
+            }
+            request._offset = pointer - request._buffer;
+            request._target = target;
+            request._attempts = 0;
+            send(request);
+        }
+        delete message;
+        return request._buffer;
+    }
+
+    /**
+     * @brief Sends a request.
+     *
+     * @param request Request to send.
+     */
+    void send(Request &request) {
+        _manager.send(request._buffer, request._length,
+                _targets[request._target], _port);
+        request._time = Clock::millis();
+        request._attempts++;
+    }
+
+    /**
+     * @brief Completes a request.
+     *
+     * Counts the result and calls the user result handler.
+     *
+     * @param slot Slot of the request.
+     * @param result Result. @see Result.
+     * @param message GETRESPONSE message, nullptr on timeout.
+     */
+    void complete(const uint8_t slot, const uint8_t result,
+            const Message *message) {
+        const IPAddress target = _targets[_requests[slot]._target];
+        release(slot);
+        _results[result]++;
+        _done++;
+        if (_onResult) {
+            _onResult(target, result, message);
+        }
+    }
+
+    /**
+     * @brief Releases a request slot.
+     *
+     * @param slot Slot of the request.
+     */
+    void release(const uint8_t slot) {
+        free(_requests[slot]._buffer);
+        _requests[slot]._buffer = nullptr;
+    }
+
+    /**
+     * @brief Verifies the variable bindings of a response.
+     *
+     * The variable bindings list of the response is encoded and compared to the
+     * one of the request.
+     *
+     * @param request Request.
+     * @param varbindlist Variable bindings list of the response.
+     * @return true if the lists are equal, false otherwise.
+     */
+    bool verify(const Request &request, VarBindList *varbindlist) {
+        const unsigned int length = varbindlist->getSize(true);
+        if (length != request._length - request._offset) {
+            return false;
+        }
+        uint8_t *buffer = static_cast<uint8_t*>(malloc(length));
+        if (!buffer) {
+            return false;
+        }
+#if SNMP_STREAM
+        BufferStream stream(buffer, length);
+        varbindlist->encode(stream);
+#else
+        varbindlist->encode(buffer);
+#endif
+        bool equal = memcmp(buffer, request._buffer + request._offset, length) == 0;
+        free(buffer);
+        return equal;
+    }
+
+    /** %SNMP manager. */
+    Manager &_manager;
+    /** On build event user handler. */
+    Build _onBuild = nullptr;
+    /** On result event user handler. */
+    Event _onResult = nullptr;
+    /** True if the campaign is running. */
+    bool _running = false;
+    /** IP addresses of the targets. */
+    const IPAddress *_targets = nullptr;
+    /** Count of targets. */
+    uint16_t _count = 0;
+    /** %SNMP version. */
+    uint8_t _version = Version::V2C;
+    /** %SNMP community. */
+    const char *_community = nullptr;
+    /** UDP port of the targets. */
+    uint16_t _port = Port::SNMP;
+    /** Request timeout. */
+    uint16_t _timeout = TIMEOUT;
+    /** Count of retries. */
+    uint8_t _retries = RETRIES;
+    /** Index of the next target to start. */
+    uint16_t _next = 0;
+    /** Count of targets done. */
+    uint16_t _done = 0;
+    /** Count of targets per result. */
+    uint16_t _results[Result::Count];
+    /** Count of requests sent again. */
+    uint32_t _retried = 0;
+    /** Requests slots. */
+    Request _requests[U];
+};
+
+} // namespace SNMP
+
+#endif /* SNMPCAMPAIGN_H_ */
@@ -0,0 +1,834 @@
+#ifndef SNMPCAPABILITY_H_
+#define SNMPCAPABILITY_H_
+
+#include "SNMP.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @struct Capability
+ * @brief Helper struct to handle capabilities learned from an agent.
+ */
+struct Capability {
+    /**
+     * @brief Enumerates all capability flags.
+     */
+    enum : uint8_t {
+        V1 = 1 << 0,     /**< 0x01, answered an SNMPv1 request. */
+        V2C = 1 << 1,    /**< 0x02, answered an SNMPv2c request. */
+        Silent = 1 << 2, /**< 0x04, left consecutive SNMPv2c requests unanswered. */
+    };
+};
+
+/**
+ * @class Capabilities
+ * @brief Per-agent capability and OID existence cache of a manager.
+ *
+ * Responses are observed to learn, for each agent:
+ *
+ * - the versions it answers,
+ * - the size of its largest response and the count of variable bindings of
+ * a request it can answer without tooBig,
+ * - the OIDs it does not implement, noSuchObject, noSuchInstance or
+ * noSuchName to a GETREQUEST. The negative cache expires after a TTL.
+ *
+ * Requests sent through send() are adapted so that every packet is useful.
+ *
+ * - Absent OIDs are trimmed from GETREQUEST messages.
+ * - An agent leaving consecutive SNMPv2c requests unanswered, 3 by default,
+ * is silent. SNMPv2c requests to a silent agent that never answered SNMPv2c
+ * are sent as SNMPv1, and GETBULKREQUEST is sent as GETNEXTREQUEST. SNMPv2c
+ * is probed again after the retry time, 10 minutes by default. An SNMPv1
+ * request unanswered by an agent that never answered SNMPv1 clears the
+ * silent flag, so versions are probed in turn until one is answered.
+ * - GETREQUEST and GETNEXTREQUEST are split to the learned count of variable
+ * bindings. Max repetitions of GETBULKREQUEST are reduced instead.
+ *
+ * The first split request has the request identifier of the original
+ * message, the others have identifiers of a private range. Responses to them
+ * are given the identifier of the original message back, before other
+ * handlers and the user function see them.
+ *
+ * Agents and absent OIDs are saved and restored with SNMP::save() and
+ * SNMP::restore(), so a restarted manager does not learn them again.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Manager snmp;
+ * SNMP::Capabilities<64, 128> capabilities(snmp);
+ *
+ * void setup() {
+ *     // ...
+ *     capabilities.begin();
+ * }
+ *
+ * void poll(const IPAddress agent) {
+ *     SNMP::Message *message = new SNMP::Message(SNMP::Version::V2C, "public",
+ *             SNMP::Type::GetRequest);
+ *     // ...
+ *     capabilities.send(message, agent);
+ *     delete message;
+ * }
+ * ```
+ *
+ * @tparam A Maximum count of agents, least recently used is evicted.
+ * @tparam N Maximum count of absent OIDs, oldest is evicted.
+ * @tparam P Maximum count of requests tracked in flight.
+ */
+template<const uint8_t A, const uint8_t N = 32, const uint8_t P = 8>
+class Capabilities: public Handler {
+public:
+    /**
+     * @brief Creates a Capabilities object.
+     *
+     * @param manager %SNMP manager used to send requests and receive responses.
+     */
+    Capabilities(Manager &manager) :
+            _manager(manager) {
+    }
+
+    /**
+     * @brief Capabilities destructor.
+     */
+    virtual ~Capabilities() {
+        stop();
+    }
+
+    /**
+     * @brief Starts learning from responses.
+     */
+    void begin() {
+        if (!_running) {
+            _manager.attach(*this);
+            _running = true;
+        }
+    }
+
+    /**
+     * @brief Stops learning from responses.
+     *
+     * The cache is kept.
+     */
+    void stop() {
+        if (_running) {
+            _manager.detach(*this);
+            _running = false;
+        }
+    }
+
+    /**
+     * @brief Sets the time to live of absent OIDs.
+     *
+     * @param ttl Time in milliseconds before an absent OID is requested again.
+     */
+    void setTTL(const uint32_t ttl) {
+        _ttl = ttl;
+    }
+
+    /**
+     * @brief Sets the count of unanswered SNMPv2c requests of a silent agent.
+     *
+     * @param silence Count of consecutive SNMPv2c requests unanswered before
+     * SNMPv1 is probed.
+     */
+    void setSilence(const uint8_t silence) {
+        _silence = silence ? silence : 1;
+    }
+
+    /**
+     * @brief Sets the time before SNMPv2c is probed again.
+     *
+     * @param retry Time in milliseconds a silent agent is sent SNMPv1.
+     */
+    void setRetry(const uint32_t retry) {
+        _retry = retry;
+    }
+
+    /**
+     * @brief Sets the time a request waits for its response.
+     *
+     * @param timeout Timeout in milliseconds.
+     */
+    void setTimeout(const uint16_t timeout) {
+        _timeout = timeout;
+    }
+
+    /**
+     * @brief Gets the capabilities of an agent.
+     *
+     * @param ip IP address of the agent.
+     * @return Capability flags, 0 if unknown. @see Capability.
+     */
+    const uint8_t getCapabilities(const IPAddress ip) const {
+        const Entry *entry = find(ip);
+        return entry ? entry->_flags : 0;
+    }
+
+    /**
+     * @brief Gets the size of the largest response of an agent.
+     *
+     * @param ip IP address of the agent.
+     * @return Size in bytes, 0 if unknown.
+     */
+    const uint16_t getMaxSize(const IPAddress ip) const {
+        const Entry *entry = find(ip);
+        return entry ? entry->_size : 0;
+    }
+
+    /**
+     * @brief Gets the count of variable bindings of a request to an agent.
+     *
+     * @param ip IP address of the agent.
+     * @return Count of variable bindings, 0 if unlimited.
+     */
+    const uint8_t getLimit(const IPAddress ip) const {
+        const Entry *entry = find(ip);
+        return entry ? entry->_limit : 0;
+    }
+
+    /**
+     * @brief Checks if an OID is known to be absent from an agent.
+     *
+     * @param ip IP address of the agent.
+     * @param oid OID.
+     * @return true if absent and not expired.
+     */
+    bool isAbsent(const IPAddress ip, const char *oid) const {
+        return absent(ip, Checkpoint::hash(Checkpoint::BASIS, oid));
+    }
+
+    /**
+     * @brief Forgets all about an agent.
+     *
+     * @param ip IP address of the agent.
+     */
+    void forget(const IPAddress ip) {
+        Entry *entry = find(ip);
+        if (entry) {
+            entry->_used = false;
+        }
+        for (uint8_t index = 0; index < N; ++index) {
+            if (_absents[index]._used && equals(_absents[index]._address, ip)) {
+                _absents[index]._used = false;
+            }
+        }
+    }
+
+    /**
+     * @brief Gets the count of variable bindings trimmed.
+     *
+     * @return Count of variable bindings.
+     */
+    const uint32_t getTrimmed() const {
+        return _trimmed;
+    }
+
+    /**
+     * @brief Gets the count of requests sent.
+     *
+     * @return Count of requests, split requests included.
+     */
+    const uint32_t getSent() const {
+        return _sent;
+    }
+
+    /**
+     * @brief Gets the kind of checkpoint record.
+     *
+     * @return Kind.
+     */
+    virtual const uint8_t getKind() const {
+        return KIND;
+    }
+
+    /**
+     * @brief Gets the fingerprint of the cache configuration.
+     *
+     * @return Hash of the capacities.
+     */
+    virtual const uint32_t getFingerprint() const {
+        const uint8_t capacities[] = { A, N };
+        return Checkpoint::hash(Checkpoint::BASIS, capacities,
+                sizeof(capacities));
+    }
+
+    /**
+     * @brief Saves the agents and the absent OIDs.
+     *
+     * Times are saved as ages, so they survive a restart. Counts of
+     * unanswered requests are not saved, a silent agent stays silent.
+     *
+     * @param print Destination.
+     */
+    virtual void save(Print &print) const {
+        const unsigned long now = Clock::millis();
+        uint8_t agents = 0;
+        uint8_t absents = 0;
+        for (uint8_t index = 0; index < A; ++index) {
+            agents += _entries[index]._used;
+        }
+        for (uint8_t index = 0; index < N; ++index) {
+            absents += _absents[index]._used;
+        }
+        Checkpoint::write(print, agents, 2);
+        Checkpoint::write(print, absents, 2);
+        Checkpoint::write(print, _trimmed, 4);
+        Checkpoint::write(print, _sent, 4);
+        for (uint8_t index = 0; index < A; ++index) {
+            const Entry &entry = _entries[index];
+            if (entry._used) {
+                print.write(entry._address, 4);
+                Checkpoint::write(print, entry._flags, 1);
+                Checkpoint::write(print, entry._limit, 1);
+                Checkpoint::write(print, entry._size, 2);
+                Checkpoint::write(print, now - entry._time, 4);
+                Checkpoint::write(print, now - entry._silent, 4);
+            }
+        }
+        for (uint8_t index = 0; index < N; ++index) {
+            const Absent &absent = _absents[index];
+            if (absent._used) {
+                print.write(absent._address, 4);
+                Checkpoint::write(print, absent._hash, 4);
+                Checkpoint::write(print, now - absent._time, 4);
+            }
+        }
+    }
+
+    /**
+     * @brief Restores the agents and the absent OIDs.
+     *
+     * The cache is replaced. Requests in flight are abandoned.
+     *
+     * @param data Pointer to the record payload.
+     * @param length Length of the payload.
+     * @return true if success, false otherwise.
+     */
+    virtual bool restore(const uint8_t *data, const uint32_t length) {
+        const uint8_t *pointer = data;
+        if (length < 12) {
+            return false;
+        }
+        const uint32_t agents = Checkpoint::read(pointer, 2);
+        const uint32_t absents = Checkpoint::read(pointer, 2);
+        if ((agents > A) || (absents > N)
+                || (length < 12 + AGENT * agents + OID * absents)) {
+            return false;
+        }
+        _trimmed = Checkpoint::read(pointer, 4);
+        _sent = Checkpoint::read(pointer, 4);
+        const unsigned long now = Clock::millis();
+        for (uint8_t index = 0; index < A; ++index) {
+            Entry &entry = _entries[index];
+            entry = { };
+            if (index < agents) {
+                memcpy(entry._address, pointer, 4);
+                pointer += 4;
+                entry._flags = *pointer++;
+                entry._limit = *pointer++;
+                entry._size = Checkpoint::read(pointer, 2);
+                entry._time = now - Checkpoint::read(pointer, 4);
+                entry._silent = now - Checkpoint::read(pointer, 4);
+                entry._timeouts = entry._flags & Capability::Silent ?
+                        _silence : 0;
+                entry._used = true;
+            }
+        }
+        for (uint8_t index = 0; index < N; ++index) {
+            Absent &absent = _absents[index];
+            absent = { };
+            if (index < absents) {
+                memcpy(absent._address, pointer, 4);
+                pointer += 4;
+                absent._hash = Checkpoint::read(pointer, 4);
+                absent._time = now - Checkpoint::read(pointer, 4);
+                absent._used = true;
+            }
+        }
+        for (uint8_t index = 0; index < P; ++index) {
+            _requests[index]._used = false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Sends a request adapted to the agent.
+     *
+     * Variable bindings are moved from the message, which must be deleted by
+     * the caller afterwards. Other messages than GETREQUEST, GETNEXTREQUEST
+     * and GETBULKREQUEST are sent unchanged.
+     *
+     * @param message %SNMP message to send.
+     * @param ip IP address of the agent.
+     * @param port UDP port of the agent.
+     * @return Count of requests sent, 0 if every OID is absent.
+     */
+    uint8_t send(Message *message, const IPAddress ip,
+            const uint16_t port = Port::SNMP) {
+        uint8_t type = message->getType();
+        if ((type != Type::GetRequest) && (type != Type::GetNextRequest)
+                && (type != Type::GetBulkRequest)) {
+            return _manager.send(message, ip, port);
+        }
+        Entry *entry = find(ip);
+        const uint8_t flags = entry ? entry->_flags : 0;
+        const uint8_t limit = entry ? entry->_limit : 0;
+        uint8_t version = message->getVersion();
+        if ((version == Version::V2C) && (flags & Capability::Silent)
+                && !(flags & Capability::V2C)) {
+            const unsigned long now = Clock::millis();
+            if (now - entry->_silent < _retry) {
+                version = Version::V1;
+            } else {
+                // SNMPv2c probed again, once per retry time
+                entry->_silent = now;
+            }
+        }
+        uint8_t nonRepeaters = 0;
+        uint8_t maxRepetitions = 0;
+        if (type == Type::GetBulkRequest) {
+            nonRepeaters = message->getNonRepeaters();
+            maxRepetitions = message->getMaxRepetition();
+            if (version == Version::V1) {
+                type = Type::GetNextRequest;
+            }
+        }
+        VarBindList *varbindlist = message->getVarBindList();
+        const uint8_t count = varbindlist->count();
+        const int32_t original = message->getRequestID();
+        uint8_t sent = 0;
+        uint8_t index = 0;
+        while (index < count) {
+            Message *request = new Message(version, message->getCommunity(),
+                    type);
+            uint8_t added = 0;
+            if (type == Type::GetBulkRequest) {
+                // Whole list in one request, repetitions reduced to the limit
+                for (; index < count; ++index) {
+                    request->take((*varbindlist)[index]);
+                }
+                added = count;
+                const uint8_t repeaters = count > nonRepeaters ?
+                        count - nonRepeaters : 0;
+                if (limit && repeaters) {
+                    const uint8_t available = limit > nonRepeaters ?
+                            limit - nonRepeaters : repeaters;
+                    const uint8_t repetitions = available / repeaters;
+                    if (repetitions < maxRepetitions) {
+                        maxRepetitions = repetitions ? repetitions : 1;
+                    }
+                }
+                request->setNonRepeaters(nonRepeaters);
+                request->setMaxRepetitions(maxRepetitions);
+            } else {
+                for (; (index < count) && (!limit || (added < limit));
+                        ++index) {
+                    VarBind *varbind = (*varbindlist)[index];
+                    if ((type == Type::GetRequest)
+                            && absent(ip, Checkpoint::hash(Checkpoint::BASIS,
+                                    varbind->getName()))) {
+                        _trimmed++;
+                        continue;
+                    }
+                    request->take(varbind);
+                    added++;
+                }
+            }
+            if (added) {
+                // Split requests do not use identifiers of the caller
+                const int32_t id = sent ?
+                        ID | (++_sequence & 0xFFFFFF) : original;
+                request->setRequestID(id);
+                track(id, original, type, version, ip, added);
+                _manager.send(request, ip, port);
+                _sent++;
+                sent++;
+            }
+            delete request;
+        }
+        return sent;
+    }
+
+    /**
+     * @brief Processes an incoming message.
+     *
+     * Learns from a GETRESPONSE. The message is never consumed.
+     *
+     * @param message %SNMP message to process.
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     * @return false.
+     */
+    virtual bool message(const Message *message, const IPAddress remote,
+            const uint16_t port) {
+        if (message->getType() != Type::GetResponse) {
+            return false;
+        }
+        Entry *entry = find(remote, true);
+        entry->_flags |= message->getVersion() == Version::V1 ?
+                Capability::V1 : Capability::V2C;
+        if (message->getVersion() != Version::V1) {
+            entry->_flags &= ~Capability::Silent;
+            entry->_timeouts = 0;
+        }
+        Request *request = nullptr;
+        for (uint8_t index = 0; index < P; ++index) {
+            if (_requests[index]._used
+                    && (_requests[index]._id == message->getRequestID())
+                    && equals(_requests[index]._address, remote)) {
+                request = &_requests[index];
+                break;
+            }
+        }
+        if (!request) {
+            return false;
+        }
+        request->_used = false;
+        if (request->_id != request->_original) {
+            // Handlers and user function see the identifier of the caller
+            const_cast<Message*>(message)->setRequestID(request->_original);
+        }
+        VarBindList *varbindlist = message->getVarBindList();
+        switch (message->getErrorStatus()) {
+        case Error::TooBig:
+            entry->_limit = request->_count > 1 ? request->_count / 2 : 1;
+            break;
+        case Error::NoSuchName:
+            if ((request->_type == Type::GetRequest)
+                    && message->getErrorIndex()
+                    && (message->getErrorIndex() <= varbindlist->count())) {
+                remember(remote, (*varbindlist)[message->getErrorIndex() - 1]->getName());
+            }
+            break;
+        case Error::NoError: {
+            const uint16_t size = const_cast<Message*>(message)->ArrayBER::getSize();
+            if (size > entry->_size) {
+                entry->_size = size;
+            }
+            if (request->_type == Type::GetRequest) {
+                for (uint8_t index = 0; index < varbindlist->count(); ++index) {
+                    VarBind *varbind = (*varbindlist)[index];
+                    const uint8_t type = varbind->getValue()->getType();
+                    if ((type == Type::NoSuchObject)
+                            || (type == Type::NoSuchInstance)) {
+                        remember(remote, varbind->getName());
+                    }
+                }
+            }
+            break;
+        }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Processes pending work.
+     *
+     * Expires requests without response. Consecutive unanswered SNMPv2c
+     * requests mark the agent as silent to SNMPv2c, so that the next request
+     * probes it with SNMPv1. An unanswered SNMPv1 probe clears the mark if the
+     * agent never answered SNMPv1.
+     */
+    virtual void loop() {
+        const unsigned long now = Clock::millis();
+        for (uint8_t index = 0; index < P; ++index) {
+            Request &request = _requests[index];
+            if (request._used && (now - request._time >= _timeout)) {
+                request._used = false;
+                const IPAddress ip(request._address[0], request._address[1],
+                        request._address[2], request._address[3]);
+                SNMP_PROBE(timeout, request._id, request._type, ip, 0, 0, 1);
+                if (request._version == Version::V2C) {
+                    Entry *entry = find(ip, true);
+                    if (entry->_timeouts < 0xFF) {
+                        entry->_timeouts++;
+                    }
+                    if (entry->_timeouts >= _silence) {
+                        entry->_flags |= Capability::Silent;
+                        entry->_silent = now;
+                    }
+                } else {
+                    Entry *entry = find(ip);
+                    if (entry && !(entry->_flags & Capability::V1)) {
+                        entry->_flags &= ~Capability::Silent;
+                        entry->_timeouts = 0;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    /** Default time to live of absent OIDs. */
+    static constexpr uint32_t TTL = 600000;
+    /** Default request timeout. */
+    static constexpr uint16_t TIMEOUT = 5000;
+    /** Kind of checkpoint record. */
+    static constexpr uint8_t KIND = 'K';
+    /** Size of a saved agent. */
+    static constexpr uint8_t AGENT = 16;
+    /** Size of a saved absent OID. */
+    static constexpr uint8_t OID = 12;
+    /** Default count of unanswered SNMPv2c requests of a silent agent. */
+    static constexpr uint8_t SILENCE = 3;
+    /** Default time before SNMPv2c is probed again. */
+    static constexpr uint32_t RETRY = 600000;
+    /**
+     * Request identifier prefix of split requests.
+     */
+    static constexpr uint32_t ID = 0x45000000;
+
+    /**
+     * @struct Entry
+     * @brief Capabilities of an agent.
+     */
+    struct Entry {
+        /** IP address of the agent. */
+        uint8_t _address[4];
+        /** True if in use. */
+        bool _used;
+        /** Capability flags. */
+        uint8_t _flags;
+        /** Count of variable bindings of a request, 0 if unlimited. */
+        uint8_t _limit;
+        /** Count of consecutive SNMPv2c requests unanswered. */
+        uint8_t _timeouts;
+        /** Size of the largest response. */
+        uint16_t _size;
+        /** Time of last use. */
+        unsigned long _time;
+        /** Time silent, or of the last SNMPv2c probe. */
+        unsigned long _silent;
+    };
+
+    /**
+     * @struct Absent
+     * @brief OID absent from an agent.
+     */
+    struct Absent {
+        /** IP address of the agent. */
+        uint8_t _address[4];
+        /** True if in use. */
+        bool _used;
+        /** Hash of the OID. */
+        uint32_t _hash;
+        /** Time learned. */
+        unsigned long _time;
+    };
+
+    /**
+     * @struct Request
+     * @brief Request in flight.
+     */
+    struct Request {
+        /** IP address of the agent. */
+        uint8_t _address[4];
+        /** True if in use. */
+        bool _used;
+        /** PDU type. */
+        uint8_t _type;
+        /** %SNMP version. */
+        uint8_t _version;
+        /** Count of variable bindings. */
+        uint8_t _count;
+        /** Request identifier. */
+        int32_t _id;
+        /** Request identifier of the original message. */
+        int32_t _original;
+        /** Time of sending. */
+        unsigned long _time;
+    };
+
+    /**
+     * @brief Compares a stored address.
+     *
+     * @param address Stored address.
+     * @param ip IP address.
+     * @return true if equal.
+     */
+    static bool equals(const uint8_t *address, const IPAddress &ip) {
+        for (uint8_t index = 0; index < 4; ++index) {
+            if (address[index] != ip[index]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Stores an address.
+     *
+     * @param address Destination.
+     * @param ip IP address.
+     */
+    static void store(uint8_t *address, const IPAddress &ip) {
+        for (uint8_t index = 0; index < 4; ++index) {
+            address[index] = ip[index];
+        }
+    }
+
+    /**
+     * @brief Finds the entry of an agent.
+     *
+     * @param ip IP address of the agent.
+     * @return Pointer to the entry, nullptr if unknown.
+     */
+    const Entry* find(const IPAddress &ip) const {
+        for (uint8_t index = 0; index < A; ++index) {
+            if (_entries[index]._used && equals(_entries[index]._address, ip)) {
+                return &_entries[index];
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Finds the entry of an agent.
+     *
+     * @param ip IP address of the agent.
+     * @param create true to create the entry, evicting the least recently
+     * used one.
+     * @return Pointer to the entry, nullptr if unknown and not created.
+     */
+    Entry* find(const IPAddress &ip, const bool create = false) {
+        const unsigned long now = Clock::millis();
+        Entry *entry = const_cast<Entry*>(
+                static_cast<const Capabilities*>(this)->find(ip));
+        if (!entry && create) {
+            entry = &_entries[0];
+            for (uint8_t index = 0; index < A; ++index) {
+                if (!_entries[index]._used) {
+                    entry = &_entries[index];
+                    break;
+                }
+                if (now - _entries[index]._time > now - entry->_time) {
+                    entry = &_entries[index];
+                }
+            }
+            *entry = { };
+            store(entry->_address, ip);
+            entry->_used = true;
+        }
+        if (entry) {
+            entry->_time = now;
+        }
+        return entry;
+    }
+
+    /**
+     * @brief Checks the negative cache.
+     *
+     * @param ip IP address of the agent.
+     * @param hash Hash of the OID.
+     * @return true if absent and not expired.
+     */
+    bool absent(const IPAddress &ip, const uint32_t hash) const {
+        const unsigned long now = Clock::millis();
+        for (uint8_t index = 0; index < N; ++index) {
+            const Absent &absent = _absents[index];
+            if (absent._used && (absent._hash == hash)
+                    && equals(absent._address, ip)) {
+                return now - absent._time < _ttl;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Adds an OID to the negative cache.
+     *
+     * The oldest OID is evicted if the cache is full.
+     *
+     * @param ip IP address of the agent.
+     * @param oid OID absent.
+     */
+    void remember(const IPAddress &ip, const char *oid) {
+        const unsigned long now = Clock::millis();
+        const uint32_t hash = Checkpoint::hash(Checkpoint::BASIS, oid);
+        Absent *slot = &_absents[0];
+        for (uint8_t index = 0; index < N; ++index) {
+            Absent &absent = _absents[index];
+            if (!absent._used
+                    || ((absent._hash == hash) && equals(absent._address, ip))) {
+                slot = &absent;
+                break;
+            }
+            if (now - absent._time > now - slot->_time) {
+                slot = &absent;
+            }
+        }
+        store(slot->_address, ip);
+        slot->_hash = hash;
+        slot->_time = now;
+        slot->_used = true;
+    }
+
+    /**
+     * @brief Tracks a request in flight.
+     *
+     * The oldest request is evicted if the table is full.
+     *
+     * @param id Request identifier.
+     * @param original Request identifier of the original message.
+     * @param type PDU type.
+     * @param version %SNMP version.
+     * @param ip IP address of the agent.
+     * @param count Count of variable bindings.
+     */
+    void track(const int32_t id, const int32_t original, const uint8_t type,
+            const uint8_t version, const IPAddress &ip, const uint8_t count) {
+        const unsigned long now = Clock::millis();
+        Request *slot = &_requests[0];
+        for (uint8_t index = 0; index < P; ++index) {
+            if (!_requests[index]._used) {
+                slot = &_requests[index];
+                break;
+            }
+            if (now - _requests[index]._time > now - slot->_time) {
+                slot = &_requests[index];
+            }
+        }
+        store(slot->_address, ip);
+        slot->_type = type;
+        slot->_version = version;
+        slot->_count = count;
+        slot->_id = id;
+        slot->_original = original;
+        slot->_time = now;
+        slot->_used = true;
+    }
+
+    /** %SNMP manager. */
+    Manager &_manager;
+    /** True if attached. */
+    bool _running = false;
+    /** Time to live of absent OIDs. */
+    uint32_t _ttl = TTL;
+    /** Request timeout. */
+    uint16_t _timeout = TIMEOUT;
+    /** Count of unanswered SNMPv2c requests of a silent agent. */
+    uint8_t _silence = SILENCE;
+    /** Time before SNMPv2c is probed again. */
+    uint32_t _retry = RETRY;
+    /** Sequence of identifiers of split requests. */
+    uint32_t _sequence = 0;
+    /** Count of variable bindings trimmed. */
+    uint32_t _trimmed = 0;
+    /** Count of requests sent. */
+    uint32_t _sent = 0;
+    /** Agents. */
+    Entry _entries[A] = { };
+    /** Absent OIDs. */
+    Absent _absents[N] = { };
+    /** Requests in flight. */
+    Request _requests[P] = { };
+};
+
+} // namespace SNMP
+
+#endif /* SNMPCAPABILITY_H_ */
@@ -0,0 +1,612 @@
+#ifndef SNMPDISCOVERY_H_
+#define SNMPDISCOVERY_H_
+
+#include "SNMP.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @class Discovery
+ * @brief Subnet discovery sweep.
+ *
+ * Probes every address of a list of ranges for *sysObjectID.0* and *sysName.0*
+ * with every candidate community, and calls the user discover handler for each
+ * agent that answers.
+ *
+ * - Addresses are generated lazily from the ranges, one pass per community.
+ * - The GETREQUEST is encoded once per community. Only the request identifier is
+ * patched before each probe is sent.
+ * - Up to U probes are kept in flight. A probe is released when answered or
+ * after the timeout.
+ * - The probe rate is bounded.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Manager snmp;
+ * SNMP::Discovery<256> discovery(snmp);
+ *
+ * const SNMP::Discovery<256>::Range RANGES[] = {
+ *         { IPAddress(10, 1, 0, 1), IPAddress(10, 1, 255, 254) },
+ * };
+ * const char *COMMUNITIES[] = { "public", "private" };
+ *
+ * void onDiscover(const SNMP::Message *message, const IPAddress remote, const char *community) {
+ *     // User code here...
+ * }
+ *
+ * void setup() {
+ *     // ...
+ *     discovery.onDiscover(onDiscover);
+ *     discovery.setRate(1000);
+ *     discovery.begin(RANGES, 1, COMMUNITIES, 2);
+ * }
+ * ```
+ *
+ * @warning Ranges and communities are not copied and must remain valid until
+ * the sweep is complete.
+ *
+ * @tparam U Maximum count of probes in flight, up to 65535.
+ */
+template<const uint16_t U>
+class Discovery: public Handler {
+public:
+    /**
+     * @struct Range
+     * @brief Range of addresses to probe, bounds included.
+     */
+    struct Range {
+        /** First address. */
+        IPAddress _first;
+        /** Last address. */
+        IPAddress _last;
+    };
+
+    /**
+     * @brief On discover event user handler type.
+     *
+     * @param message GETRESPONSE message from the agent.
+     * @param remote IP address of the agent.
+     * @param community Community the agent answered to.
+     */
+    using Event = void (*)(const Message*, const IPAddress, const char*);
+
+    /**
+     * @brief Creates a Discovery object.
+     *
+     * @param manager %SNMP manager used to send probes and receive responses.
+     */
+    Discovery(Manager &manager) :
+            _manager(manager) {
+    }
+
+    /**
+     * @brief Discovery destructor.
+     *
+     * Stops the sweep.
+     */
+    virtual ~Discovery() {
+        stop();
+    }
+
+    /**
+     * @brief Starts a sweep.
+     *
+     * @param ranges Ranges of addresses to probe.
+     * @param count Count of ranges.
+     * @param communities Candidate communities.
+     * @param communityCount Count of candidate communities.
+     * @param version %SNMP version of the probes.
+     * @return true if the sweep is started, false otherwise.
+     */
+    bool begin(const Range *ranges, const uint8_t count,
+            const char *const *communities, const uint8_t communityCount,
+            const uint8_t version = Version::V2C) {
+        stop();
+        if (!count || !communityCount) {
+            return false;
+        }
+        _ranges = ranges;
+        _count = count;
+        _communities = communities;
+        _communityCount = communityCount;
+        _version = version;
+        _range = 0;
+        _offset = 0;
+        _community = 0;
+        _sent = 0;
+        _found = 0;
+        for (uint16_t index = 0; index < U; ++index) {
+            _probes[index]._busy = false;
+            _free[index] = U - index - 1;
+        }
+        _available = U;
+        _head = 0;
+        _pending = 0;
+        _credit = 0;
+        _last = Clock::millis();
+        if (!prepare()) {
+            return false;
+        }
+        _running = true;
+        _manager.attach(*this);
+        return true;
+    }
+
+    /**
+     * @brief Stops the sweep.
+     *
+     * Probes in flight are abandoned.
+     */
+    void stop() {
+        if (_running) {
+            _manager.detach(*this);
+            _running = false;
+        }
+        free(_template);
+        _template = nullptr;
+    }
+
+    /**
+     * @brief Sets the maximum probe rate.
+     *
+     * @param rate Probes per second, 0 for no limit.
+     */
+    void setRate(const uint16_t rate) {
+        _rate = rate;
+    }
+
+    /**
+     * @brief Sets the probe timeout.
+     *
+     * @param timeout Timeout in milliseconds.
+     */
+    void setTimeout(const uint16_t timeout) {
+        _timeout = timeout;
+    }
+
+    /**
+     * @brief Sets on discover event user handler.
+     *
+     * @param event Event handler.
+     */
+    void onDiscover(Event event) {
+        _onDiscover = event;
+    }
+
+    /**
+     * @brief Checks if a sweep is running.
+     *
+     * @return true if running, false otherwise.
+     */
+    const bool isRunning() const {
+        return _running;
+    }
+
+    /**
+     * @brief Gets the count of probes in flight.
+     *
+     * @return Count of probes.
+     */
+    const uint16_t getInFlight() const {
+        return U - _available;
+    }
+
+    /**
+     * @brief Gets the count of probes sent.
+     *
+     * @return Count of probes.
+     */
+    const uint32_t getSent() const {
+        return _sent;
+    }
+
+    /**
+     * @brief Gets the count of agents found.
+     *
+     * @return Count of agents.
+     */
+    const uint32_t getFound() const {
+        return _found;
+    }
+
+    /**
+     * @brief Gets the kind of checkpoint record.
+     *
+     * @return Kind.
+     */
+    virtual const uint8_t getKind() const {
+        return KIND;
+    }
+
+    /**
+     * @brief Gets the fingerprint of the sweep configuration.
+     *
+     * @return Hash of version, ranges and communities.
+     */
+    virtual const uint32_t getFingerprint() const {
+        uint32_t hash = Checkpoint::hash(Checkpoint::BASIS, &_version, 1);
+        for (uint8_t index = 0; index < _count; ++index) {
+            const uint32_t bounds[] = {
+                    Encoding::toInteger(_ranges[index]._first),
+                    Encoding::toInteger(_ranges[index]._last) };
+            hash = Checkpoint::hash(hash, bounds, sizeof(bounds));
+        }
+        for (uint8_t index = 0; index < _communityCount; ++index) {
+            hash = Checkpoint::hash(hash, _communities[index]);
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Saves the sweep position and counters.
+     *
+     * The position is rewound to the oldest probe in flight, so no address is
+     * missed after restore. Some addresses may be probed twice.
+     *
+     * @param print Destination.
+     */
+    virtual void save(Print &print) const {
+        uint8_t range = _range;
+        uint32_t offset = _offset;
+        uint8_t community = _community;
+        for (uint16_t index = 0; index < _pending; ++index) {
+            const Pending &pending = _queue[(_head + index) % U];
+            const Probe &probe = _probes[pending._slot];
+            if (probe._busy && (probe._tag == pending._tag)) {
+                // Latest range of the pass holding the address
+                uint8_t last = _count;
+                if ((probe._community == _community) && (_range < _count)) {
+                    last = _range + 1;
+                }
+                while (last--) {
+                    const uint32_t first =
+                            Encoding::toInteger(_ranges[last]._first);
+                    if ((probe._address >= first) && (probe._address
+                            <= Encoding::toInteger(_ranges[last]._last))) {
+                        range = last;
+                        offset = probe._address - first;
+                        community = probe._community;
+                        break;
+                    }
+                }
+                break;
+            }
+        }
+        Checkpoint::write(print, range, 1);
+        Checkpoint::write(print, community, 1);
+        Checkpoint::write(print, 0, 2);
+        Checkpoint::write(print, offset, 4);
+        Checkpoint::write(print, _sent, 4);
+        Checkpoint::write(print, _found, 4);
+    }
+
+    /**
+     * @brief Restores the sweep position and counters.
+     *
+     * The sweep must be started with the same configuration.
+     *
+     * @param data Pointer to the record payload.
+     * @param length Length of the payload.
+     * @return true if success, false otherwise.
+     */
+    virtual bool restore(const uint8_t *data, const uint32_t length) {
+        if (!_running || (length < 16) || (data[0] > _count)
+                || (data[1] >= _communityCount)) {
+            return false;
+        }
+        _range = data[0];
+        _community = data[1];
+        data += 4;
+        _offset = Checkpoint::read(data, 4);
+        _sent = Checkpoint::read(data, 4);
+        _found = Checkpoint::read(data, 4);
+        return prepare();
+    }
+
+    /**
+     * @brief Processes an incoming message.
+     *
+     * Matches a GETRESPONSE to its probe by request identifier and sender, then
+     * calls the user discover handler.
+     *
+     * @param message %SNMP message to process.
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     * @return true if the message answers a probe in flight.
+     */
+    virtual bool message(const Message *message, const IPAddress remote,
+            const uint16_t port) {
+        if (message->getType() != Type::GetResponse) {
+            return false;
+        }
+        const uint32_t id = message->getRequestID();
+        if ((id & 0xFF000000) != ID) {
+            return false;
+        }
+        const uint16_t slot = id & 0xFFFF;
+        if (slot >= U) {
+            return false;
+        }
+        Probe &probe = _probes[slot];
+        if (!probe._busy || (probe._tag != ((id >> 16) & 0xFF))
+                || (probe._address != Encoding::toInteger(remote))) {
+            return false;
+        }
+        release(slot);
+        _found++;
+        if (_onDiscover) {
+            _onDiscover(message, remote, _communities[probe._community]);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Processes pending work.
+     *
+     * - Releases timed out probes.
+     * - Sends new probes within the rate limit and the in-flight window.
+     */
+    virtual void loop() {
+        const unsigned long now = Clock::millis();
+        // Probes time out in send order
+        while (_pending) {
+            Pending &pending = _queue[_head];
+            Probe &probe = _probes[pending._slot];
+            if (probe._busy && (probe._tag == pending._tag)) {
+                if (now - probe._time < _timeout) {
+                    break;
+                }
+                SNMP_PROBE(timeout, ID | (static_cast<uint32_t>(probe._tag) << 16)
+                        | pending._slot, Type::GetRequest,
+                        Encoding::toAddress(probe._address), Port::SNMP, _length, 1);
+                release(pending._slot);
+            }
+            _head = (_head + 1) % U;
+            _pending--;
+        }
+        if (_rate) {
+            // Credit is in thousandths of a probe, burst is limited to 50 ms
+            uint32_t limit = static_cast<uint32_t>(_rate) * 50;
+            if (limit < 1000) {
+                limit = 1000;
+            }
+            const uint32_t elapsed = now - _last;
+            _credit = elapsed < limit ? _credit + elapsed * _rate : limit;
+            if (_credit > limit) {
+                _credit = limit;
+            }
+        }
+        _last = now;
+        uint32_t address;
+        while (_template && _available && (!_rate || (_credit >= 1000))
+                && next(address)) {
+            if (_pending == U) {
+                // Answered probes behind a silent one fill the queue
+                compact();
+            }
+            const uint16_t slot = _free[--_available];
+            Probe &probe = _probes[slot];
+            probe._busy = true;
+            probe._tag++;
+            probe._address = address;
+            probe._community = _community;
+            probe._time = now;
+            const uint32_t id = ID | (static_cast<uint32_t>(probe._tag) << 16) | slot;
+            for (uint8_t index = 0; index < 4; ++index) {
+                _template[_offsetID + index] = id >> ((3 - index) << 3);
+            }
+            _manager.send(_template, _length, Encoding::toAddress(address),
+                    Port::SNMP);
+            _queue[(_head + _pending++) % U] = { slot, probe._tag };
+            _sent++;
+            if (_rate) {
+                _credit -= 1000;
+            }
+        }
+        if (!_template && (_available == U)) {
+            stop();
+        }
+    }
+
+private:
+    /**
+     * Request identifier prefix of the probes.
+     *
+     * The prefix ensures request identifiers are always encoded on 4 bytes, so
+     * they can be patched in the encoded template.
+     */
+    static constexpr uint32_t ID = 0x40000000;
+    /** Kind of checkpoint record. */
+    static constexpr uint8_t KIND = 'D';
+    /** Default probe timeout in milliseconds. */
+    static constexpr uint16_t TIMEOUT = 2000;
+
+    /**
+     * @struct Probe
+     * @brief Probe in flight.
+     */
+    struct Probe {
+        /** Probed address. */
+        uint32_t _address;
+        /** Time of sending. */
+        unsigned long _time;
+        /** Index of the community. */
+        uint8_t _community;
+        /** Tag incremented on each use of the slot. */
+        uint8_t _tag = 0;
+        /** True if the probe is in flight. */
+        bool _busy = false;
+    };
+
+    /**
+     * @struct Pending
+     * @brief Entry of the timeout queue.
+     */
+    struct Pending {
+        /** Slot of the probe. */
+        uint16_t _slot;
+        /** Tag of the probe when sent. */
+        uint8_t _tag;
+    };
+
+    /**
+     * @brief Encodes the GETREQUEST template for the current community.
+     *
+     * @return true if success, false otherwise.
+     */
+    bool prepare() {
+        free(_template);
+        _template = nullptr;
+        Message *message = new Message(_version, _communities[_community],
+                Type::GetRequest);
+        message->setRequestID(ID);
+        message->add(SYSOBJECTID);
+        message->add(SYSNAME);
+        _length = message->getSize(true);
+        _template = static_cast<uint8_t*>(malloc(_length));
+        if (_template) {
+            message->build(_template);
+            // Message, version, community, PDU then request identifier value
+            uint8_t *pointer = Encoding::skip(_template, false);
+            pointer = Encoding::skip(pointer, true);
+            pointer = Encoding::skip(pointer, true);
+            pointer = Encoding::skip(pointer, false);
+            _offsetID = pointer + 2 - _template;
+        }
+        delete message;
+        return _template;
+    }
+
+    /**
+     * @brief Gets the next address to probe.
+     *
+     * When all ranges are done, the next community is selected and its template
+     * encoded.
+     *
+     * @param address Next address.
+     * @return true if an address is available, false if the sweep is done.
+     */
+    bool next(uint32_t &address) {
+        while (_range < _count) {
+            const uint32_t first = Encoding::toInteger(_ranges[_range]._first);
+            const uint32_t last = Encoding::toInteger(_ranges[_range]._last);
+            const uint32_t span = last - first;
+            if ((last >= first) && (_offset <= span)) {
+                address = first + _offset;
+                if (_offset == span) {
+                    _range++;
+                    _offset = 0;
+                } else {
+                    _offset++;
+                }
+                return true;
+            }
+            _range++;
+            _offset = 0;
+        }
+        if (++_community < _communityCount) {
+            _range = 0;
+            if (prepare()) {
+                return next(address);
+            }
+        }
+        free(_template);
+        _template = nullptr;
+        return false;
+    }
+
+    /**
+     * @brief Releases a probe slot.
+     *
+     * @param slot Slot of the probe.
+     */
+    void release(const uint16_t slot) {
+        _probes[slot]._busy = false;
+        _free[_available++] = slot;
+    }
+
+    /**
+     * @brief Removes answered probes from the timeout queue.
+     *
+     * Send order is kept. Each probe in flight has one entry, so the queue has
+     * room for a new probe while a slot is free.
+     */
+    void compact() {
+        uint16_t count = 0;
+        for (uint16_t index = 0; index < _pending; ++index) {
+            const Pending pending = _queue[(_head + index) % U];
+            const Probe &probe = _probes[pending._slot];
+            if (probe._busy && (probe._tag == pending._tag)) {
+                _queue[(_head + count++) % U] = pending;
+            }
+        }
+        _pending = count;
+    }
+
+    /** SNMPv2-MIB::sysObjectID.0 */
+    static constexpr char *SYSOBJECTID = "1.3.6.1.2.1.1.2.0";
+    /** SNMPv2-MIB::sysName.0 */
+    static constexpr char *SYSNAME = "1.3.6.1.2.1.1.5.0";
+
+    /** %SNMP manager. */
+    Manager &_manager;
+    /** On discover event user handler. */
+    Event _onDiscover = nullptr;
+    /** True if a sweep is running. */
+    bool _running = false;
+    /** Ranges of addresses. */
+    const Range *_ranges = nullptr;
+    /** Count of ranges. */
+    uint8_t _count = 0;
+    /** Candidate communities. */
+    const char *const *_communities = nullptr;
+    /** Count of candidate communities. */
+    uint8_t _communityCount = 0;
+    /** %SNMP version of the probes. */
+    uint8_t _version = Version::V2C;
+    /** Index of the current range. */
+    uint8_t _range = 0;
+    /** Offset of the next address in the current range. */
+    uint32_t _offset = 0;
+    /** Index of the current community. */
+    uint8_t _community = 0;
+    /** Encoded GETREQUEST template. */
+    uint8_t *_template = nullptr;
+    /** Length of the template. */
+    uint32_t _length = 0;
+    /** Offset of the request identifier value in the template. */
+    uint16_t _offsetID = 0;
+    /** Maximum probe rate, 0 for no limit. */
+    uint16_t _rate = 0;
+    /** Probe timeout. */
+    uint16_t _timeout = TIMEOUT;
+    /** Rate credit in thousandths of a probe. */
+    uint32_t _credit = 0;
+    /** Time of last credit update. */
+    unsigned long _last = 0;
+    /** Count of probes sent. */
+    uint32_t _sent = 0;
+    /** Count of agents found. */
+    uint32_t _found = 0;
+    /** Probes slots. */
+    Probe _probes[U];
+    /** Stack of free slots. */
+    uint16_t _free[U];
+    /** Count of free slots. */
+    uint16_t _available = U;
+    /** Timeout queue, in send order. */
+    Pending _queue[U];
+    /** Head of the timeout queue. */
+    uint16_t _head = 0;
+    /** Count of entries in the timeout queue. */
+    uint16_t _pending = 0;
+};
+
+} // namespace SNMP
+
+#endif /* SNMPDISCOVERY_H_ */
@@ -0,0 +1,518 @@
+#ifndef SNMPGATHER_H_
+#define SNMPGATHER_H_
+
+#include "SNMP.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @struct State
+ * @brief Helper struct to handle state of a cell of a Gather result matrix.
+ */
+struct State {
+    /**
+     * @brief Enumerates all possible states.
+     */
+    enum : uint8_t {
+        Pending,    /**< 0, no response yet. */
+        Value,      /**< 1, value received. */
+        Truncated,  /**< 2, value received, longer than a cell. */
+        Exception,  /**< 3, noSuchObject, noSuchInstance or endOfMibView received. */
+        Error,      /**< 4, response received with an error status. */
+        Timeout,    /**< 5, no response before the deadline. */
+    };
+};
+
+/**
+ * @class Gather
+ * @brief Scatter-gather GETREQUEST over a list of targets.
+ *
+ * Gets the same OIDs from many agents, with a single completion.
+ *
+ * - The GETREQUEST is encoded once and sent to all targets, up to W at once.
+ * - A request without response is sent again, up to the retries count.
+ * - Values are stored in a preallocated matrix of T targets by O OIDs. A cell
+ * holds the type and the content octets of a value, up to B bytes.
+ * - The user completion handler is called once, when all targets have
+ * answered or given up, or at the deadline. Cells without value are flagged
+ * by their state.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Manager snmp;
+ * SNMP::Gather<300, 5> gather(snmp);
+ *
+ * const char *OIDS[] = { "1.3.6.1.2.1.1.3.0", "1.3.6.1.2.1.1.5.0" };
+ *
+ * void onComplete(SNMP::Gather<300, 5> *gather, const bool partial) {
+ *     for (uint16_t target = 0; target < COUNT; ++target) {
+ *         if (gather->getState(target, 0) == SNMP::State::Value) {
+ *             Serial.println(static_cast<uint32_t>(gather->getInteger(target, 0)));
+ *         }
+ *     }
+ * }
+ *
+ * void setup() {
+ *     // ...
+ *     gather.onComplete(onComplete);
+ *     gather.begin(TARGETS, COUNT, OIDS, 2, SNMP::Version::V2C, "public", 2000);
+ * }
+ * ```
+ *
+ * @warning Targets, OIDs and community are not copied and must remain valid
+ * until completion.
+ *
+ * @tparam T Maximum count of targets.
+ * @tparam O Maximum count of OIDs.
+ * @tparam W Maximum count of targets queried at once, up to 255.
+ * @tparam B Size of a cell value in bytes, up to 255.
+ */
+template<const uint16_t T, const uint8_t O, const uint8_t W = 16,
+        const uint8_t B = 16>
+class Gather: public Handler {
+public:
+    /**
+     * @brief On complete event user handler type.
+     *
+     * @param gather Gather completed.
+     * @param partial true if a cell has no value.
+     */
+    using Event = void (*)(Gather*, const bool);
+
+    /**
+     * @brief Creates a Gather object.
+     *
+     * @param manager %SNMP manager used to send requests and receive responses.
+     */
+    Gather(Manager &manager) :
+            _manager(manager) {
+    }
+
+    /**
+     * @brief Gather destructor.
+     */
+    virtual ~Gather() {
+        stop();
+    }
+
+    /**
+     * @brief Starts a gather.
+     *
+     * Cells of a previous gather are cleared.
+     *
+     * @param targets IP addresses of the targets.
+     * @param count Count of targets, T at most.
+     * @param oids OIDs to get.
+     * @param size Count of OIDs, O at most.
+     * @param version %SNMP version.
+     * @param community %SNMP community.
+     * @param deadline Time to completion in milliseconds.
+     * @param port UDP port of the targets.
+     * @return true if started, false otherwise.
+     */
+    bool begin(const IPAddress *targets, const uint16_t count,
+            const char *const *oids, const uint8_t size, const uint8_t version,
+            const char *community, const uint32_t deadline,
+            const uint16_t port = Port::SNMP) {
+        stop();
+        if (!count || (count > T) || !size || (size > O)) {
+            return false;
+        }
+        _id = ID | (static_cast<uint32_t>(++_tag) << 8);
+        Message *message = new Message(version, community, Type::GetRequest);
+        message->setRequestID(_id);
+        for (uint8_t index = 0; index < size; ++index) {
+            message->add(oids[index]);
+        }
+        _length = message->getSize(true);
+        _buffer = static_cast<uint8_t*>(malloc(_length));
+        if (_buffer) {
+            message->build(_buffer);
+        }
+        delete message;
+        if (!_buffer) {
+            return false;
+        }
+        _targets = targets;
+        _count = count;
+        _size = size;
+        _port = port;
+        _deadline = deadline;
+        _start = Clock::millis();
+        _next = 0;
+        _done = 0;
+        for (uint16_t target = 0; target < count; ++target) {
+            for (uint8_t oid = 0; oid < size; ++oid) {
+                _cells[target][oid]._state = State::Pending;
+            }
+        }
+        for (uint8_t slot = 0; slot < W; ++slot) {
+            _requests[slot]._active = false;
+        }
+        _running = true;
+        _manager.attach(*this);
+        return true;
+    }
+
+    /**
+     * @brief Stops the gather without completion.
+     */
+    void stop() {
+        if (_running) {
+            _manager.detach(*this);
+            _running = false;
+        }
+        free(_buffer);
+        _buffer = nullptr;
+    }
+
+    /**
+     * @brief Sets the request timeout.
+     *
+     * @param timeout Timeout in milliseconds before a request is sent again.
+     */
+    void setTimeout(const uint16_t timeout) {
+        _timeout = timeout;
+    }
+
+    /**
+     * @brief Sets the count of retries.
+     *
+     * @param retries Count of requests sent again after a timeout.
+     */
+    void setRetries(const uint8_t retries) {
+        _retries = retries;
+    }
+
+    /**
+     * @brief Sets on complete event user handler.
+     *
+     * @param event Event handler.
+     */
+    void onComplete(Event event) {
+        _onComplete = event;
+    }
+
+    /**
+     * @brief Checks if the gather is running.
+     *
+     * @return true if running, false otherwise.
+     */
+    const bool isRunning() const {
+        return _running;
+    }
+
+    /**
+     * @brief Gets the count of targets done.
+     *
+     * @return Count of targets answered.
+     */
+    const uint16_t getDone() const {
+        return _done;
+    }
+
+    /**
+     * @brief Gets the state of a cell.
+     *
+     * @param target Index of the target.
+     * @param oid Index of the OID.
+     * @return State. @see State.
+     */
+    const uint8_t getState(const uint16_t target, const uint8_t oid) const {
+        return _cells[target][oid]._state;
+    }
+
+    /**
+     * @brief Gets the type of a value.
+     *
+     * @param target Index of the target.
+     * @param oid Index of the OID.
+     * @return BER type. @see Type.
+     */
+    const uint8_t getType(const uint16_t target, const uint8_t oid) const {
+        return _cells[target][oid]._type;
+    }
+
+    /**
+     * @brief Gets the content octets of a value.
+     *
+     * @param target Index of the target.
+     * @param oid Index of the OID.
+     * @return Pointer to the content octets.
+     */
+    const uint8_t* getData(const uint16_t target, const uint8_t oid) const {
+        return _cells[target][oid]._data;
+    }
+
+    /**
+     * @brief Gets the length of the content octets of a value.
+     *
+     * @param target Index of the target.
+     * @param oid Index of the OID.
+     * @return Length in bytes, B at most.
+     */
+    const uint8_t getLength(const uint16_t target, const uint8_t oid) const {
+        return _cells[target][oid]._length;
+    }
+
+    /**
+     * @brief Gets an integer value.
+     *
+     * Valid for INTEGER, Counter32, Gauge32, TimeTicks and Counter64 values.
+     *
+     * @param target Index of the target.
+     * @param oid Index of the OID.
+     * @return Value, INTEGER is sign extended.
+     */
+    const int64_t getInteger(const uint16_t target, const uint8_t oid) const {
+        const Cell &cell = _cells[target][oid];
+        int64_t value = (cell._type == Type::Integer) && cell._length
+                && (cell._data[0] & 0x80) ? -1 : 0;
+        for (uint8_t index = 0; index < cell._length; ++index) {
+            value = static_cast<int64_t>(static_cast<uint64_t>(value) << 8)
+                    | cell._data[index];
+        }
+        return value;
+    }
+
+    /**
+     * @brief Processes an incoming message.
+     *
+     * Matches a GETRESPONSE to a target in flight by request identifier and
+     * sender, then stores the values in the matrix.
+     *
+     * @param message %SNMP message to process.
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     * @return true if the message answers a request in flight.
+     */
+    virtual bool message(const Message *message, const IPAddress remote,
+            const uint16_t port) {
+        if ((message->getType() != Type::GetResponse)
+                || (static_cast<uint32_t>(message->getRequestID()) != _id)) {
+            return false;
+        }
+        for (uint8_t slot = 0; slot < W; ++slot) {
+            Request &request = _requests[slot];
+            if (request._active && (_targets[request._target] == remote)) {
+                store(request._target, message);
+                request._active = false;
+                _done++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Processes pending work.
+     *
+     * - Sends again timed out requests.
+     * - Starts next targets within the window.
+     * - Completes when no target is left in flight or at the deadline.
+     */
+    virtual void loop() {
+        const unsigned long now = Clock::millis();
+        if ((_done == _count) || (now - _start >= _deadline)) {
+            complete();
+            return;
+        }
+        bool active = false;
+        for (uint8_t slot = 0; slot < W; ++slot) {
+            Request &request = _requests[slot];
+            if (request._active && (now - request._time >= _timeout)) {
+                if (request._attempts <= _retries) {
+                    SNMP_PROBE(retransmit, _id, Type::GetRequest,
+                            _targets[request._target], _port, _length,
+                            request._attempts);
+                    send(request);
+                } else {
+                    // Target given up, its cells time out
+                    SNMP_PROBE(timeout, _id, Type::GetRequest,
+                            _targets[request._target], _port, _length,
+                            request._attempts);
+                    request._active = false;
+                }
+            }
+            if (!request._active && (_next < _count)) {
+                request._active = true;
+                request._target = _next++;
+                request._attempts = 0;
+                send(request);
+            }
+            active |= request._active;
+        }
+        if (!active) {
+            complete();
+        }
+    }
+
+private:
+    /**
+     * Request identifier prefix of the requests.
+     *
+     * The next byte is a tag incremented on each gather.
+     */
+    static constexpr uint32_t ID = 0x43000000;
+    /** Default request timeout in milliseconds. */
+    static constexpr uint16_t TIMEOUT = 1000;
+    /** Default count of retries. */
+    static constexpr uint8_t RETRIES = 2;
+
+    /**
+     * @struct Request
+     * @brief Target in flight.
+     */
+    struct Request {
+        /** True if in flight. */
+        bool _active = false;
+        /** Index of the target. */
+        uint16_t _target = 0;
+        /** Time of last sending. */
+        unsigned long _time = 0;
+        /** Count of requests sent. */
+        uint8_t _attempts = 0;
+    };
+
+    /**
+     * @struct Cell
+     * @brief Value of an OID for a target.
+     */
+    struct Cell {
+        /** State. */
+        uint8_t _state;
+        /** BER type. */
+        uint8_t _type;
+        /** Length of the content octets. */
+        uint8_t _length;
+        /** Content octets. */
+        uint8_t _data[B];
+    };
+
+    /**
+     * @brief Sends the request to a target.
+     *
+     * @param request Target in flight.
+     */
+    void send(Request &request) {
+        _manager.send(_buffer, _length, _targets[request._target], _port);
+        request._time = Clock::millis();
+        request._attempts++;
+    }
+
+    /**
+     * @brief Stores the values of a response.
+     *
+     * @param target Index of the target.
+     * @param message GETRESPONSE message.
+     */
+    void store(const uint16_t target, const Message *message) {
+        VarBindList *varbindlist = message->getVarBindList();
+        const bool error = message->getErrorStatus() != Error::NoError;
+        for (uint8_t oid = 0; oid < _size; ++oid) {
+            Cell &cell = _cells[target][oid];
+            if (error || (oid >= varbindlist->count())) {
+                cell._state = State::Error;
+                continue;
+            }
+            BER *value = (*varbindlist)[oid]->getValue();
+            cell._type = value->getType();
+            cell._length = 0;
+            switch (cell._type) {
+            case Type::NoSuchObject:
+            case Type::NoSuchInstance:
+            case Type::EndOfMIBView:
+                cell._state = State::Exception;
+                break;
+            default:
+                cell._state = copy(cell, value) ? State::Value : State::Truncated;
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief Copies the content octets of a value to a cell.
+     *
+     * @param cell Destination.
+     * @param value Value.
+     * @return true if the whole content fits in the cell.
+     */
+    static bool copy(Cell &cell, BER *value) {
+        const unsigned int length = value->getContent(cell._data, B);
+        cell._length = length < B ? length : B;
+        return length <= B;
+    }
+
+    /**
+     * @brief Completes the gather.
+     *
+     * Pending cells time out and the user completion handler is called.
+     */
+    void complete() {
+        bool partial = false;
+        for (uint16_t target = 0; target < _count; ++target) {
+            for (uint8_t oid = 0; oid < _size; ++oid) {
+                Cell &cell = _cells[target][oid];
+                if (cell._state == State::Pending) {
+                    cell._state = State::Timeout;
+                }
+                if (cell._state != State::Value) {
+                    partial = true;
+                }
+            }
+        }
+        stop();
+        if (_onComplete) {
+            _onComplete(this, partial);
+        }
+    }
+
+    /** %SNMP manager. */
+    Manager &_manager;
+    /** On complete event user handler. */
+    Event _onComplete = nullptr;
+    /** True if running. */
+    bool _running = false;
+    /** Encoded GETREQUEST. */
+    uint8_t *_buffer = nullptr;
+    /** Length of the encoded GETREQUEST. */
+    uint16_t _length = 0;
+    /** Request identifier. */
+    uint32_t _id = 0;
+    /** Tag incremented on each gather. */
+    uint8_t _tag = 0;
+    /** IP addresses of the targets. */
+    const IPAddress *_targets = nullptr;
+    /** Count of targets. */
+    uint16_t _count = 0;
+    /** Count of OIDs. */
+    uint8_t _size = 0;
+    /** UDP port of the targets. */
+    uint16_t _port = Port::SNMP;
+    /** Time to completion. */
+    uint32_t _deadline = 0;
+    /** Time of start. */
+    unsigned long _start = 0;
+    /** Request timeout. */
+    uint16_t _timeout = TIMEOUT;
+    /** Count of retries. */
+    uint8_t _retries = RETRIES;
+    /** Index of the next target to start. */
+    uint16_t _next = 0;
+    /** Count of targets answered. */
+    uint16_t _done = 0;
+    /** Targets in flight. */
+    Request _requests[W];
+    /** Result matrix. */
+    Cell _cells[T][O];
+};
+
+} // namespace SNMP
+
+#endif /* SNMPGATHER_H_ */
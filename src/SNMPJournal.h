@@ -0,0 +1,585 @@
+#ifndef SNMPJOURNAL_H_
+#define SNMPJOURNAL_H_
+
+#include "SNMP.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <stdio.h>
+#endif
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @class Device
+ * @brief Block device interface of a Journal.
+ *
+ * The device is split in blocks, the erase unit. Erased bytes read as 0xFF.
+ * A byte is written once between two erases, like flash memory.
+ *
+ * Implement this interface over EEPROM, flash or a file.
+ */
+class Device {
+public:
+    /**
+     * @brief Device destructor.
+     */
+    virtual ~Device() {
+    }
+
+    /**
+     * @brief Gets the size of the device.
+     *
+     * @return Size in bytes.
+     */
+    virtual const uint32_t getSize() const = 0;
+
+    /**
+     * @brief Gets the size of a block.
+     *
+     * @return Size in bytes.
+     */
+    virtual const uint32_t getBlockSize() const = 0;
+
+    /**
+     * @brief Reads bytes.
+     *
+     * @param address Address of the first byte.
+     * @param buffer Destination.
+     * @param length Count of bytes.
+     * @return true if success, false otherwise.
+     */
+    virtual bool read(const uint32_t address, uint8_t *buffer,
+            const uint32_t length) = 0;
+
+    /**
+     * @brief Writes bytes to erased memory.
+     *
+     * @param address Address of the first byte.
+     * @param buffer Source.
+     * @param length Count of bytes.
+     * @return true if success, false otherwise.
+     */
+    virtual bool write(const uint32_t address, const uint8_t *buffer,
+            const uint32_t length) = 0;
+
+    /**
+     * @brief Erases a block.
+     *
+     * @param address Address of the block, multiple of the block size.
+     * @return true if success, false otherwise.
+     */
+    virtual bool erase(const uint32_t address) = 0;
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+/**
+ * @class FileDevice
+ * @brief Block device backed by a file.
+ *
+ * Emulates flash memory on a host, for tests or for a Linux agent. The file
+ * is created and erased if it does not exist.
+ */
+class FileDevice: public Device {
+public:
+    /**
+     * @brief Creates a FileDevice object.
+     *
+     * @param path Path of the file, not copied.
+     * @param size Size of the device in bytes.
+     * @param block Size of a block in bytes.
+     */
+    FileDevice(const char *path, const uint32_t size,
+            const uint32_t block = 4096) :
+            _path(path), _size(size), _block(block) {
+    }
+
+    /**
+     * @brief FileDevice destructor.
+     */
+    virtual ~FileDevice() {
+        end();
+    }
+
+    /**
+     * @brief Opens the file.
+     *
+     * @return true if success, false otherwise.
+     */
+    bool begin() {
+        end();
+        _file = fopen(_path, "r+b");
+        if (!_file) {
+            _file = fopen(_path, "w+b");
+        }
+        if (!_file) {
+            return false;
+        }
+        // Extends the file with erased blocks
+        fseek(_file, 0, SEEK_END);
+        long length = ftell(_file);
+        while (length < static_cast<long>(_size)) {
+            fputc(0xFF, _file);
+            length++;
+        }
+        return fflush(_file) == 0;
+    }
+
+    /**
+     * @brief Closes the file.
+     */
+    void end() {
+        if (_file) {
+            fclose(_file);
+            _file = nullptr;
+        }
+    }
+
+    /**
+     * @brief Gets the count of blocks erased.
+     *
+     * @return Count of blocks.
+     */
+    const uint32_t getErases() const {
+        return _erases;
+    }
+
+    virtual const uint32_t getSize() const {
+        return _size;
+    }
+
+    virtual const uint32_t getBlockSize() const {
+        return _block;
+    }
+
+    virtual bool read(const uint32_t address, uint8_t *buffer,
+            const uint32_t length) {
+        return _file && (address + length <= _size)
+                && (fseek(_file, address, SEEK_SET) == 0)
+                && (fread(buffer, 1, length, _file) == length);
+    }
+
+    virtual bool write(const uint32_t address, const uint8_t *buffer,
+            const uint32_t length) {
+        return _file && (address + length <= _size)
+                && (fseek(_file, address, SEEK_SET) == 0)
+                && (fwrite(buffer, 1, length, _file) == length)
+                && (fflush(_file) == 0);
+    }
+
+    virtual bool erase(const uint32_t address) {
+        if (!_file || (address % _block) || (address >= _size)
+                || (fseek(_file, address, SEEK_SET) != 0)) {
+            return false;
+        }
+        for (uint32_t index = 0; index < _block; ++index) {
+            fputc(0xFF, _file);
+        }
+        _erases++;
+        return fflush(_file) == 0;
+    }
+
+private:
+    /** Path of the file. */
+    const char *_path;
+    /** Size of the device. */
+    uint32_t _size;
+    /** Size of a block. */
+    uint32_t _block;
+    /** File. */
+    FILE *_file = nullptr;
+    /** Count of blocks erased. */
+    uint32_t _erases = 0;
+};
+#endif
+
+/**
+ * @class Journal
+ * @brief Log-structured persistent storage of object values.
+ *
+ * Persists the values of writable objects, a SET changing the contact or the
+ * location of an agent for example, on a Device.
+ *
+ * - The device is split in 2 areas. The active area is a log: a new value is
+ * appended after the last record, in constant time. An unchanged value is not
+ * written.
+ * - When the active area is full, the last value of each object is copied to
+ * the other area, which becomes active. Areas alternate, so blocks are erased
+ * evenly.
+ * - begin() scans the active area once and keeps the address of the last
+ * value of each object. A record partially written by a power loss fails its
+ * check and is discarded. A failed write compacts the journal, so no record
+ * is appended after a partial one.
+ *
+ * An area starts with an 8 bytes header: magic "SNMJ" and generation,
+ * little-endian. The header is written after the records on compaction, so
+ * an interrupted compaction leaves the previous area active.
+ *
+ * A record is a 4 bytes header, identifier, length and check, followed by the
+ * value.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::FileDevice device("snmp.journal", 8192);
+ * SNMP::Journal<3> journal(device);
+ *
+ * void setup() {
+ *     device.begin();
+ *     journal.begin();
+ *     char location[256];
+ *     int16_t length = journal.get(LOCATION, location, 255);
+ *     if (length >= 0) {
+ *         location[length] = 0;
+ *     }
+ * }
+ *
+ * void setLocation(const char *location) {
+ *     journal.put(LOCATION, location, strlen(location));
+ * }
+ * ```
+ *
+ * @tparam K Count of objects, identified from 0 to K - 1.
+ */
+template<const uint8_t K>
+class Journal {
+    static_assert(K && (K < 0xFF), "K must be between 1 and 254");
+
+public:
+    /**
+     * @brief Creates a Journal object.
+     *
+     * @param device Block device.
+     */
+    Journal(Device &device) :
+            _device(device) {
+    }
+
+    /**
+     * @brief Opens the journal.
+     *
+     * Formats the device if no area is valid. Compacts the journal if a
+     * record is corrupted.
+     *
+     * @return true if success, false if the device is too small or fails.
+     */
+    bool begin() {
+        const uint32_t block = _device.getBlockSize();
+        _size = block ? (_device.getSize() / block / 2) * block : 0;
+        if (_size < HEADER + RECORD) {
+            return false;
+        }
+        uint32_t generations[2];
+        const bool valid[2] = { header(0, generations[0]), header(1,
+                generations[1]) };
+        if (!valid[0] && !valid[1]) {
+            _area = 1;
+            _generation = 0;
+            for (uint8_t id = 0; id < K; ++id) {
+                _offsets[id] = 0;
+            }
+            return compact();
+        }
+        _area = !valid[0]
+                || (valid[1]
+                        && (static_cast<int32_t>(generations[1]
+                                - generations[0]) > 0));
+        _generation = generations[_area];
+        return scan() || compact();
+    }
+
+    /**
+     * @brief Gets the value of an object.
+     *
+     * @param id Identifier of the object.
+     * @param buffer Destination.
+     * @param size Size of the destination. The value is truncated if longer.
+     * @return Length of the value, -1 if the object has no value.
+     */
+    int16_t get(const uint8_t id, void *buffer, const uint8_t size) {
+        uint8_t record[RECORD];
+        if ((id >= K) || !_offsets[id]
+                || !_device.read(_offsets[id], record, RECORD)) {
+            return -1;
+        }
+        const uint8_t length = record[1];
+        if (!_device.read(_offsets[id] + RECORD, static_cast<uint8_t*>(buffer),
+                length < size ? length : size)) {
+            return -1;
+        }
+        return length;
+    }
+
+    /**
+     * @brief Checks if an object has a value.
+     *
+     * @param id Identifier of the object.
+     * @return true if the object has a value.
+     */
+    bool has(const uint8_t id) const {
+        return (id < K) && _offsets[id];
+    }
+
+    /**
+     * @brief Sets the value of an object.
+     *
+     * @param id Identifier of the object.
+     * @param data Value.
+     * @param length Length of the value.
+     * @return true if success, false otherwise.
+     */
+    bool put(const uint8_t id, const void *data, const uint8_t length) {
+        if (id >= K) {
+            return false;
+        }
+        const uint8_t *value = static_cast<const uint8_t*>(data);
+        if (equals(id, value, length)) {
+            return true;
+        }
+        if ((_position + RECORD + length > _size)
+                && (!compact() || (_position + RECORD + length > _size))) {
+            return false;
+        }
+        const uint16_t check = Journal::check(id, value, length);
+        const uint8_t record[RECORD] = { id, length, static_cast<uint8_t>(check),
+                static_cast<uint8_t>(check >> 8) };
+        const uint32_t address = base(_area) + _position;
+        if (!_device.write(address, record, RECORD)
+                || !_device.write(address + RECORD, value, length)) {
+            // Bytes may be written, a record after them would be lost by the
+            // next scan. Valid records are moved to the other area, or on the
+            // next put if the compaction fails too.
+            _position = _size;
+            compact();
+            return false;
+        }
+        _offsets[id] = address;
+        _position += RECORD + length;
+        return true;
+    }
+
+    /**
+     * @brief Gets the generation of the active area.
+     *
+     * The generation is incremented by each compaction.
+     *
+     * @return Generation.
+     */
+    const uint32_t getGeneration() const {
+        return _generation;
+    }
+
+    /**
+     * @brief Gets the free space of the active area.
+     *
+     * @return Size in bytes.
+     */
+    const uint32_t getFree() const {
+        return _size - _position;
+    }
+
+private:
+    /** Size of an area header. */
+    static constexpr uint8_t HEADER = 8;
+    /** Size of a record header. */
+    static constexpr uint8_t RECORD = 4;
+    /** Identifier of erased memory. */
+    static constexpr uint8_t ERASED = 0xFF;
+    /** Size of the copy buffer. */
+    static constexpr uint8_t CHUNK = 16;
+    /** Magic of an area header. */
+    static constexpr uint8_t MAGIC[4] = { 'S', 'N', 'M', 'J' };
+
+    /**
+     * @brief Gets the address of an area.
+     *
+     * @param area Area, 0 or 1.
+     * @return Address.
+     */
+    uint32_t base(const uint8_t area) const {
+        return area * _size;
+    }
+
+    /**
+     * @brief Reads the header of an area.
+     *
+     * @param area Area, 0 or 1.
+     * @param generation Generation of the area.
+     * @return true if the header is valid.
+     */
+    bool header(const uint8_t area, uint32_t &generation) {
+        uint8_t buffer[HEADER];
+        if (!_device.read(base(area), buffer, HEADER)
+                || memcmp(buffer, MAGIC, 4)) {
+            return false;
+        }
+        const uint8_t *pointer = buffer + 4;
+        generation = Checkpoint::read(pointer, 4);
+        return true;
+    }
+
+    /**
+     * @brief Computes the check of a record.
+     *
+     * @param id Identifier of the object.
+     * @param value Value.
+     * @param length Length of the value.
+     * @return Folded FNV-1a hash of identifier, length and value.
+     */
+    static uint16_t check(const uint8_t id, const uint8_t *value,
+            const uint8_t length) {
+        const uint8_t record[2] = { id, length };
+        uint32_t hash = Checkpoint::hash(Checkpoint::BASIS, record, 2);
+        hash = Checkpoint::hash(hash, value, length);
+        return hash ^ (hash >> 16);
+    }
+
+    /**
+     * @brief Scans the active area.
+     *
+     * Keeps the address of the last value of each object.
+     *
+     * @return true if success, false if a record is corrupted.
+     */
+    bool scan() {
+        for (uint8_t id = 0; id < K; ++id) {
+            _offsets[id] = 0;
+        }
+        _position = HEADER;
+        uint8_t record[RECORD];
+        uint8_t buffer[CHUNK];
+        while (_position + RECORD <= _size) {
+            const uint32_t address = base(_area) + _position;
+            if (!_device.read(address, record, RECORD)) {
+                return false;
+            }
+            if ((record[0] == ERASED) && (record[1] == ERASED)
+                    && (record[2] == ERASED) && (record[3] == ERASED)) {
+                return true;
+            }
+            const uint8_t id = record[0];
+            const uint8_t length = record[1];
+            if ((id >= K) || (_position + RECORD + length > _size)) {
+                return false;
+            }
+            // Folded FNV-1a, computed by chunks
+            uint32_t hash = Checkpoint::hash(Checkpoint::BASIS, record, 2);
+            for (uint16_t offset = 0; offset < length; offset += CHUNK) {
+                const uint8_t count =
+                        length - offset < CHUNK ? length - offset : CHUNK;
+                if (!_device.read(address + RECORD + offset, buffer, count)) {
+                    return false;
+                }
+                hash = Checkpoint::hash(hash, buffer, count);
+            }
+            if (static_cast<uint16_t>(hash ^ (hash >> 16))
+                    != (record[2] | (record[3] << 8))) {
+                return false;
+            }
+            _offsets[id] = address;
+            _position += RECORD + length;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Checks if an object already has a value.
+     *
+     * @param id Identifier of the object.
+     * @param value Value.
+     * @param length Length of the value.
+     * @return true if the value is the current value of the object.
+     */
+    bool equals(const uint8_t id, const uint8_t *value, const uint8_t length) {
+        uint8_t record[RECORD];
+        if (!_offsets[id] || !_device.read(_offsets[id], record, RECORD)
+                || (record[1] != length)) {
+            return false;
+        }
+        uint8_t buffer[CHUNK];
+        for (uint16_t offset = 0; offset < length; offset += CHUNK) {
+            const uint8_t count =
+                    length - offset < CHUNK ? length - offset : CHUNK;
+            if (!_device.read(_offsets[id] + RECORD + offset, buffer, count)
+                    || memcmp(buffer, value + offset, count)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Copies the last values to the other area and activates it.
+     *
+     * @return true if success, false otherwise.
+     */
+    bool compact() {
+        const uint8_t area = !_area;
+        const uint32_t block = _device.getBlockSize();
+        for (uint32_t offset = 0; offset < _size; offset += block) {
+            if (!_device.erase(base(area) + offset)) {
+                return false;
+            }
+        }
+        uint32_t offsets[K];
+        uint32_t position = HEADER;
+        uint8_t buffer[CHUNK];
+        for (uint8_t id = 0; id < K; ++id) {
+            offsets[id] = 0;
+            if (!_offsets[id]) {
+                continue;
+            }
+            if (!_device.read(_offsets[id], buffer, RECORD)) {
+                return false;
+            }
+            const uint16_t size = RECORD + buffer[1];
+            offsets[id] = base(area) + position;
+            for (uint16_t offset = 0; offset < size; offset += CHUNK) {
+                const uint8_t count = size - offset < CHUNK ? size - offset : CHUNK;
+                if (!_device.read(_offsets[id] + offset, buffer, count)
+                        || !_device.write(offsets[id] + offset, buffer, count)) {
+                    return false;
+                }
+            }
+            position += size;
+        }
+        // Header is written last, the area is valid only once complete
+        uint8_t head[HEADER] = { MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3] };
+        for (uint8_t index = 0; index < 4; ++index) {
+            head[4 + index] = (_generation + 1) >> (index << 3);
+        }
+        if (!_device.write(base(area), head, HEADER)) {
+            return false;
+        }
+        _area = area;
+        _generation++;
+        _position = position;
+        for (uint8_t id = 0; id < K; ++id) {
+            _offsets[id] = offsets[id];
+        }
+        return true;
+    }
+
+    /** Block device. */
+    Device &_device;
+    /** Size of an area. */
+    uint32_t _size = 0;
+    /** Active area, 0 or 1. */
+    uint8_t _area = 0;
+    /** Generation of the active area. */
+    uint32_t _generation = 0;
+    /** Position of the next record in the active area. */
+    uint32_t _position = 0;
+    /** Addresses of the last values, 0 if none. */
+    uint32_t _offsets[K];
+};
+
+template<const uint8_t K>
+constexpr uint8_t Journal<K>::MAGIC[4];
+
+} // namespace SNMP
+
+#endif /* SNMPJOURNAL_H_ */
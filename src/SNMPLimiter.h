@@ -0,0 +1,307 @@
+#ifndef SNMPLIMITER_H_
+#define SNMPLIMITER_H_
+
+#include "SNMP.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @class Limiter
+ * @brief Per-source rate limiter.
+ *
+ * Shares an agent fairly between managers. Each sender address has a token
+ * bucket. A packet from a sender with an empty bucket is dropped before it is
+ * decoded, and counted.
+ *
+ * - Buckets are kept in a bounded hash table of N entries. A new sender
+ * replaces the least recently seen sender of its hash set.
+ * - The rate and burst of a bucket depend on the community of the last
+ * message received from the sender. A sender not yet known uses the default
+ * rate.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Agent snmp;
+ * SNMP::Limiter<32> limiter;
+ *
+ * void setup() {
+ *     // ...
+ *     limiter.setRate(10, 20);
+ *     limiter.setRate("private", 2, 4);
+ *     snmp.attach(limiter);
+ * }
+ * ```
+ *
+ * @warning Communities are not copied and must remain valid while the limiter
+ * is attached.
+ *
+ * @tparam N Count of buckets, a power of 2 up to 32768.
+ * @tparam C Maximum count of communities with their own rate.
+ */
+template<const uint16_t N, const uint8_t C = 4>
+class Limiter: public Handler {
+    static_assert(N && !(N & (N - 1)), "N must be a power of 2");
+
+public:
+    /**
+     * @brief Creates a Limiter object.
+     */
+    Limiter() {
+        for (uint16_t index = 0; index < N; ++index) {
+            _buckets[index]._address = 0;
+        }
+    }
+
+    /**
+     * @brief Sets the default rate.
+     *
+     * @param rate Packets per second.
+     * @param burst Packets accepted at once after a quiet period.
+     */
+    void setRate(const uint16_t rate, const uint16_t burst) {
+        _rate = { nullptr, rate, burst };
+    }
+
+    /**
+     * @brief Sets the rate of a community.
+     *
+     * @param community %SNMP community.
+     * @param rate Packets per second.
+     * @param burst Packets accepted at once after a quiet period.
+     * @return true if success, false if C communities already have a rate.
+     */
+    bool setRate(const char *community, const uint16_t rate,
+            const uint16_t burst) {
+        uint8_t index = find(community);
+        if (index == DEFAULT) {
+            if (_count == C) {
+                return false;
+            }
+            index = _count++;
+        }
+        _rates[index] = { community, rate, burst };
+        return true;
+    }
+
+    /**
+     * @brief Gets the count of packets dropped.
+     *
+     * @return Count of packets.
+     */
+    const uint32_t getDropped() const {
+        return _dropped;
+    }
+
+    /**
+     * @brief Gets the count of packets accepted.
+     *
+     * @return Count of packets.
+     */
+    const uint32_t getAccepted() const {
+        return _accepted;
+    }
+
+    /**
+     * @brief Gets the count of senders replaced in the table.
+     *
+     * @return Count of senders.
+     */
+    const uint32_t getEvicted() const {
+        return _evicted;
+    }
+
+    /**
+     * @brief Filters an incoming packet before it is decoded.
+     *
+     * Takes a token from the bucket of the sender.
+     *
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     * @return true if a token is available, false to drop the packet.
+     */
+    virtual bool accept(const IPAddress remote, const uint16_t port) {
+        const unsigned long now = Clock::millis();
+        Bucket &bucket = lookup(Encoding::toInteger(remote), now);
+        const Rate &rate = bucket._community == DEFAULT ?
+                _rate : _rates[bucket._community];
+        const uint32_t limit = static_cast<uint32_t>(rate._burst) * 1000;
+        const uint32_t elapsed = now - bucket._time;
+        // Elapsed time is capped to the time to fill the bucket, so the
+        // product does not overflow
+        const uint32_t fill = rate._rate ? limit / rate._rate + 1 : 0;
+        bucket._tokens += (elapsed < fill ? elapsed : fill) * rate._rate;
+        if (bucket._tokens > limit) {
+            bucket._tokens = limit;
+        }
+        bucket._time = now;
+        if (bucket._tokens < 1000) {
+            _dropped++;
+            return false;
+        }
+        bucket._tokens -= 1000;
+        _accepted++;
+        return true;
+    }
+
+    /**
+     * @brief Processes an incoming message.
+     *
+     * Records the community of the sender, to apply its rate to the next
+     * packets.
+     *
+     * @param message %SNMP message to process.
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     * @return false, the message is not consumed.
+     */
+    virtual bool message(const Message *message, const IPAddress remote,
+            const uint16_t port) {
+        Bucket *bucket = search(Encoding::toInteger(remote));
+        if (bucket && message->getCommunity()) {
+            bucket->_community = find(message->getCommunity());
+        }
+        return false;
+    }
+
+private:
+    /** Index of the default rate. */
+    static constexpr uint8_t DEFAULT = 0xFF;
+    /** Count of buckets searched for a sender. */
+    static constexpr uint8_t WAYS = N < 4 ? N : 4;
+    /** Default rate in packets per second. */
+    static constexpr uint16_t RATE = 10;
+    /** Default burst in packets. */
+    static constexpr uint16_t BURST = 20;
+
+    /**
+     * @struct Rate
+     * @brief Rate of a community.
+     */
+    struct Rate {
+        /** %SNMP community, nullptr for the default rate. */
+        const char *_community;
+        /** Packets per second. */
+        uint16_t _rate;
+        /** Packets accepted at once. */
+        uint16_t _burst;
+    };
+
+    /**
+     * @struct Bucket
+     * @brief Token bucket of a sender.
+     */
+    struct Bucket {
+        /** Sender address, 0 if the bucket is free. */
+        uint32_t _address;
+        /** Time of last refill. */
+        unsigned long _time;
+        /** Tokens in thousandths of a packet. */
+        uint32_t _tokens;
+        /** Index of the rate, DEFAULT for the default rate. */
+        uint8_t _community;
+    };
+
+    /**
+     * @brief Finds the rate of a community.
+     *
+     * @param community %SNMP community.
+     * @return Index of the rate, DEFAULT if the community has no rate.
+     */
+    uint8_t find(const char *community) const {
+        for (uint8_t index = 0; index < _count; ++index) {
+            if (strcmp(_rates[index]._community, community) == 0) {
+                return index;
+            }
+        }
+        return DEFAULT;
+    }
+
+    /**
+     * @brief Gets the first bucket of the hash set of an address.
+     *
+     * @param address Sender address.
+     * @return Index of the first bucket.
+     */
+    static uint16_t hash(const uint32_t address) {
+        // Fibonacci hashing, the set is aligned on WAYS buckets
+        return (static_cast<uint32_t>(address * 2654435769UL) >> 16) & (N - 1)
+                & ~(WAYS - 1);
+    }
+
+    /**
+     * @brief Searches the bucket of a sender.
+     *
+     * @param address Sender address.
+     * @return Pointer to the bucket, nullptr if not found.
+     */
+    Bucket* search(const uint32_t address) {
+        const uint16_t first = hash(address);
+        for (uint8_t way = 0; way < WAYS; ++way) {
+            if (_buckets[first + way]._address == address) {
+                return &_buckets[first + way];
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Gets the bucket of a sender.
+     *
+     * A new sender gets a full bucket, replacing the least recently seen sender
+     * of its hash set.
+     *
+     * @param address Sender address.
+     * @param now Current time.
+     * @return Reference to the bucket.
+     */
+    Bucket& lookup(const uint32_t address, const unsigned long now) {
+        Bucket *bucket = search(address);
+        if (bucket) {
+            return *bucket;
+        }
+        const uint16_t first = hash(address);
+        bucket = &_buckets[first];
+        for (uint8_t way = 0; way < WAYS; ++way) {
+            Bucket &candidate = _buckets[first + way];
+            if (!candidate._address) {
+                bucket = &candidate;
+                break;
+            }
+            if (now - candidate._time > now - bucket->_time) {
+                bucket = &candidate;
+            }
+        }
+        if (bucket->_address) {
+            _evicted++;
+        }
+        bucket->_address = address;
+        bucket->_community = DEFAULT;
+        bucket->_time = now;
+        bucket->_tokens = static_cast<uint32_t>(_rate._burst) * 1000;
+        return *bucket;
+    }
+
+    /** Default rate. */
+    Rate _rate = { nullptr, RATE, BURST };
+    /** Rates of communities. */
+    Rate _rates[C];
+    /** Count of communities with a rate. */
+    uint8_t _count = 0;
+    /** Token buckets. */
+    Bucket _buckets[N];
+    /** Count of packets dropped. */
+    uint32_t _dropped = 0;
+    /** Count of packets accepted. */
+    uint32_t _accepted = 0;
+    /** Count of senders replaced. */
+    uint32_t _evicted = 0;
+};
+
+} // namespace SNMP
+
+#endif /* SNMPLIMITER_H_ */
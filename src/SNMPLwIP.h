@@ -0,0 +1,565 @@
+#ifndef SNMPLWIP_H_
+#define SNMPLWIP_H_
+
+#include "SNMP.h"
+
+#include <lwip/opt.h>
+#include <lwip/pbuf.h>
+#include <lwip/sys.h>
+#include <lwip/udp.h>
+
+#if !NO_SYS
+#include <lwip/priv/tcpip_priv.h>
+#else
+struct tcpip_api_call_data;
+#endif
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @class LwIPUDP
+ * @brief UDP over the lwIP raw API, without intermediate buffers.
+ *
+ * Datagrams received are kept in the pbufs of lwIP and read in place. A
+ * datagram sent is written in a pbuf allocated for transmit, then given to
+ * lwIP. Compared to the UDP class of the Arduino core, that copies every
+ * datagram in its own buffer:
+ *
+ * - With SNMP_STREAM set to 1, the message is decoded straight from the pbuf
+ * chain and encoded straight to the pbuf. No copy.
+ * - With SNMP_STREAM set to 0, the library copies a datagram received once,
+ * from the pbuf chain to its buffer.
+ * - In both modes, SNMP::send() encodes a message straight to a pbuf of its
+ * size, through send(). Datagrams already encoded, sent by an Outbox for
+ * example, are copied once to the pbuf.
+ *
+ * Up to Q datagrams are queued between calls to SNMP::loop(), more are
+ * dropped and their pbufs released at once.
+ *
+ * With an RTOS, calls to the raw API run in the tcpip thread through
+ * tcpip_api_call(), that takes the core lock if LWIP_TCPIP_CORE_LOCKING is
+ * set, or else posts the call to the tcpip thread and waits for it, as on
+ * ESP32. SNMP::loop() can be called from any thread.
+ *
+ * On Linux, lwIP with its loopback netif (LWIP_HAVE_LOOPIF and
+ * LWIP_NETIF_LOOPBACK) runs agent and manager in the same process, see the
+ * LwIP example.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::LwIPUDP<> udp;
+ * SNMP::Agent snmp;
+ *
+ * void setup() {
+ *     // Ethernet.begin() or WiFi.begin() initializes lwIP and the netif
+ *     snmp.begin(udp);
+ * }
+ *
+ * void loop() {
+ *     snmp.loop();
+ * }
+ * ```
+ *
+ * @tparam Q Maximum count of datagrams queued, up to 255.
+ * @tparam S Maximum size of a datagram written with write(), in bytes.
+ */
+template<const uint8_t Q = 4, const uint16_t S = 484>
+class LwIPUDP: public UDP {
+public:
+    /**
+     * @brief LwIPUDP destructor.
+     */
+    virtual ~LwIPUDP() {
+        stop();
+    }
+
+    /**
+     * @brief Binds to a local port.
+     *
+     * @param port UDP port to listen to.
+     * @return 1 if success, 0 if failure.
+     */
+    virtual uint8_t begin(uint16_t port) {
+        stop();
+        Call call(this, nullptr, nullptr, port);
+        return run(bind, call) == ERR_OK;
+    }
+
+    /**
+     * @brief Unbinds and releases datagrams queued.
+     */
+    virtual void stop() {
+        if (_pcb) {
+            Call call(this, nullptr, nullptr, 0);
+            run(unbind, call);
+        }
+        // No more datagrams are queued by lwIP
+        release(_packet);
+        release(_output);
+        while (_count) {
+            pbuf_free(_queue[_head]._packet);
+            _head = (_head + 1) % Q;
+            _count--;
+        }
+    }
+
+    /**
+     * @brief Starts a datagram.
+     *
+     * A pbuf of S bytes is allocated for transmit.
+     *
+     * @param ip IP address to send to.
+     * @param port UDP port to send to.
+     * @return 1 if success, 0 if failure.
+     */
+    virtual int beginPacket(IPAddress ip, uint16_t port) {
+        release(_output);
+        _output = pbuf_alloc(PBUF_TRANSPORT, S, PBUF_RAM);
+        address(_destination, ip);
+        _destinationPort = port;
+        _length = 0;
+        return _output != nullptr;
+    }
+
+    /**
+     * @brief Host names are not resolved.
+     *
+     * @return 0.
+     */
+    virtual int beginPacket(const char *host, uint16_t port) {
+        return 0;
+    }
+
+    /**
+     * @brief Sends the datagram.
+     *
+     * The pbuf is shrunk to the bytes written.
+     *
+     * @return 1 if success, 0 if failure.
+     */
+    virtual int endPacket() {
+        if (!_output) {
+            return 0;
+        }
+        pbuf_realloc(_output, _length);
+        Call call(this, _output, &_destination, _destinationPort);
+        const err_t error = run(transmit, call);
+        release(_output);
+        return error == ERR_OK;
+    }
+
+    /**
+     * @brief Writes a byte to the datagram.
+     *
+     * @param byte Byte to write.
+     * @return 1 if written, 0 if the datagram is full.
+     */
+    virtual size_t write(uint8_t byte) {
+        if (!_output || (_length == S)) {
+            return 0;
+        }
+        static_cast<uint8_t*>(_output->payload)[_length++] = byte;
+        return 1;
+    }
+
+    /**
+     * @brief Writes bytes to the datagram.
+     *
+     * @param buffer Pointer to the bytes.
+     * @param size Count of bytes.
+     * @return Count of bytes written.
+     */
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        if (!_output) {
+            return 0;
+        }
+        if (size > static_cast<size_t>(S - _length)) {
+            size = S - _length;
+        }
+        memcpy(static_cast<uint8_t*>(_output->payload) + _length, buffer, size);
+        _length += size;
+        return size;
+    }
+
+    /**
+     * @brief Encodes and sends a message.
+     *
+     * The message is encoded straight to a pbuf of its size, S does not
+     * apply. SNMP::send() calls it when the agent or manager is begun with
+     * this object.
+     *
+     * @note Like with SNMP::send(), a message is built once.
+     *
+     * @param message %SNMP message to send.
+     * @param ip IP address to send to.
+     * @param port UDP port to send to.
+     * @return true if success, false if failure.
+     */
+    bool send(Message *message, const IPAddress ip, const uint16_t port) {
+        const uint32_t length = message->getSize(true);
+        struct pbuf *output = length <= 0xFFFF ?
+                pbuf_alloc(PBUF_TRANSPORT, length, PBUF_RAM) : nullptr;
+        if (!output) {
+            return false;
+        }
+        message->build(static_cast<uint8_t*>(output->payload));
+        ip_addr_t destination;
+        address(destination, ip);
+        Call call(this, output, &destination, port);
+        const err_t error = run(transmit, call);
+        pbuf_free(output);
+        return error == ERR_OK;
+    }
+
+    /**
+     * @brief Gets the next datagram queued.
+     *
+     * The previous datagram is released.
+     *
+     * @return Size of the datagram, 0 if none.
+     */
+    virtual int parsePacket() {
+        SYS_ARCH_DECL_PROTECT(level);
+        release(_packet);
+        SYS_ARCH_PROTECT(level);
+        if (_count) {
+            Datagram &datagram = _queue[_head];
+            _packet = datagram._packet;
+            _remote = IPAddress(datagram._address[0], datagram._address[1],
+                    datagram._address[2], datagram._address[3]);
+            _remotePort = datagram._port;
+            _head = (_head + 1) % Q;
+            _count--;
+        }
+        SYS_ARCH_UNPROTECT(level);
+        _segment = _packet;
+        _offset = 0;
+        _position = 0;
+        return _packet ? _packet->tot_len : 0;
+    }
+
+    /**
+     * @brief Gets the count of bytes not read of the datagram.
+     *
+     * @return Count of bytes.
+     */
+    virtual int available() {
+        return _packet ? _packet->tot_len - _position : 0;
+    }
+
+    /**
+     * @brief Reads a byte of the datagram, in place.
+     *
+     * @return Byte read, -1 if none.
+     */
+    virtual int read() {
+        const int byte = peek();
+        if (byte >= 0) {
+            _offset++;
+            _position++;
+        }
+        return byte;
+    }
+
+    /**
+     * @brief Reads bytes of the datagram.
+     *
+     * @param buffer Pointer to the destination.
+     * @param length Maximum count of bytes.
+     * @return Count of bytes read.
+     */
+    virtual int read(unsigned char *buffer, size_t length) {
+        if (!_packet) {
+            return 0;
+        }
+        const uint16_t count = pbuf_copy_partial(_packet, buffer,
+                length < 0xFFFF ? length : 0xFFFF, _position);
+        skip(count);
+        return count;
+    }
+
+    /**
+     * @brief Reads bytes of the datagram.
+     *
+     * @param buffer Pointer to the destination.
+     * @param length Maximum count of bytes.
+     * @return Count of bytes read.
+     */
+    virtual int read(char *buffer, size_t length) {
+        return read(reinterpret_cast<unsigned char*>(buffer), length);
+    }
+
+    /**
+     * @brief Gets the next byte of the datagram, in place.
+     *
+     * @return Byte, -1 if none.
+     */
+    virtual int peek() {
+        // Skips exhausted and empty pbufs of the chain
+        while (_segment && (_offset >= _segment->len)) {
+            _segment = _segment->next;
+            _offset = 0;
+        }
+        return _segment ? static_cast<uint8_t*>(_segment->payload)[_offset] : -1;
+    }
+
+    /**
+     * @brief Nothing to flush, datagrams are sent by endPacket().
+     */
+    virtual void flush() {
+    }
+
+    /**
+     * @brief Gets the IP address of the sender of the datagram.
+     *
+     * @return IP address.
+     */
+    virtual IPAddress remoteIP() {
+        return _remote;
+    }
+
+    /**
+     * @brief Gets the UDP port of the sender of the datagram.
+     *
+     * @return UDP port.
+     */
+    virtual uint16_t remotePort() {
+        return _remotePort;
+    }
+
+    /**
+     * @brief Gets the count of datagrams dropped, queue full or not IPv4.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getDropped() const {
+        return _dropped;
+    }
+
+private:
+    /**
+     * @struct Datagram
+     * @brief Datagram queued.
+     */
+    struct Datagram {
+        /** Chain of pbufs. */
+        struct pbuf *_packet;
+        /** IP address of the sender. */
+        uint8_t _address[4];
+        /** UDP port of the sender. */
+        uint16_t _port;
+    };
+
+    /**
+     * @struct Call
+     * @brief Call to the raw API, run in the tcpip thread.
+     */
+    struct Call {
+        /**
+         * @brief Creates a Call object.
+         *
+         * @param udp This LwIPUDP object.
+         * @param packet Datagram to send.
+         * @param address IP address to send to.
+         * @param port UDP port to bind or to send to.
+         */
+        Call(LwIPUDP *udp, struct pbuf *packet, const ip_addr_t *address,
+                const u16_t port) :
+                _udp(udp), _packet(packet), _address(address), _port(port) {
+        }
+
+#if !NO_SYS
+        /** Call data of lwIP, first member. */
+        struct tcpip_api_call_data _data;
+#endif
+        /** This LwIPUDP object. */
+        LwIPUDP *_udp;
+        /** Datagram to send. */
+        struct pbuf *_packet;
+        /** IP address to send to. */
+        const ip_addr_t *_address;
+        /** UDP port to bind or to send to. */
+        u16_t _port;
+    };
+
+    /**
+     * @brief Runs a call to the raw API in the tcpip thread.
+     *
+     * Without RTOS, the call is run at once.
+     *
+     * @param function Function of the call.
+     * @param call Call.
+     * @return lwIP error code of the call.
+     */
+    static err_t run(err_t (*function)(struct tcpip_api_call_data*),
+            Call &call) {
+        struct tcpip_api_call_data *data =
+                reinterpret_cast<struct tcpip_api_call_data*>(&call);
+#if !NO_SYS
+        return tcpip_api_call(function, data);
+#else
+        return function(data);
+#endif
+    }
+
+    /**
+     * @brief Creates and binds the protocol control block.
+     *
+     * @param data Call.
+     * @return lwIP error code.
+     */
+    static err_t bind(struct tcpip_api_call_data *data) {
+        Call &call = *reinterpret_cast<Call*>(data);
+        LwIPUDP *udp = call._udp;
+        udp->_pcb = udp_new();
+        if (!udp->_pcb) {
+            return ERR_MEM;
+        }
+        const err_t error = udp_bind(udp->_pcb, IP_ADDR_ANY, call._port);
+        if (error == ERR_OK) {
+            udp_recv(udp->_pcb, receive, udp);
+        } else {
+            udp_remove(udp->_pcb);
+            udp->_pcb = nullptr;
+        }
+        return error;
+    }
+
+    /**
+     * @brief Removes the protocol control block.
+     *
+     * @param data Call.
+     * @return ERR_OK.
+     */
+    static err_t unbind(struct tcpip_api_call_data *data) {
+        LwIPUDP *udp = reinterpret_cast<Call*>(data)->_udp;
+        udp_remove(udp->_pcb);
+        udp->_pcb = nullptr;
+        return ERR_OK;
+    }
+
+    /**
+     * @brief Sends a datagram.
+     *
+     * @param data Call.
+     * @return lwIP error code.
+     */
+    static err_t transmit(struct tcpip_api_call_data *data) {
+        Call &call = *reinterpret_cast<Call*>(data);
+        struct udp_pcb *pcb = call._udp->_pcb;
+        return pcb ?
+                udp_sendto(pcb, call._packet, call._address, call._port) : ERR_CONN;
+    }
+
+    /**
+     * @brief Queues a datagram received, called by lwIP.
+     *
+     * @param argument This LwIPUDP object.
+     * @param pcb Protocol control block.
+     * @param packet Chain of pbufs, owned from now.
+     * @param address IP address of the sender.
+     * @param port UDP port of the sender.
+     */
+    static void receive(void *argument, struct udp_pcb *pcb,
+            struct pbuf *packet, const ip_addr_t *address, u16_t port) {
+        LwIPUDP *udp = static_cast<LwIPUDP*>(argument);
+        SYS_ARCH_DECL_PROTECT(level);
+        SYS_ARCH_PROTECT(level);
+        if ((udp->_count == Q) || !IP_IS_V4(address)) {
+            SYS_ARCH_UNPROTECT(level);
+            udp->_dropped++;
+            pbuf_free(packet);
+            return;
+        }
+        Datagram &datagram = udp->_queue[(udp->_head + udp->_count) % Q];
+        datagram._packet = packet;
+        datagram._address[0] = ip4_addr1(ip_2_ip4(address));
+        datagram._address[1] = ip4_addr2(ip_2_ip4(address));
+        datagram._address[2] = ip4_addr3(ip_2_ip4(address));
+        datagram._address[3] = ip4_addr4(ip_2_ip4(address));
+        datagram._port = port;
+        udp->_count++;
+        SYS_ARCH_UNPROTECT(level);
+    }
+
+    /**
+     * @brief Converts an IP address.
+     *
+     * @param destination lwIP IP address.
+     * @param ip Arduino IP address.
+     */
+    static void address(ip_addr_t &destination, const IPAddress &ip) {
+        IP_ADDR4(&destination, ip[0], ip[1], ip[2], ip[3]);
+    }
+
+    /**
+     * @brief Releases a chain of pbufs.
+     *
+     * @param packet Reference to the pointer to the chain, set to nullptr.
+     */
+    static void release(struct pbuf *&packet) {
+        if (packet) {
+            pbuf_free(packet);
+            packet = nullptr;
+        }
+    }
+
+    /**
+     * @brief Advances the read position.
+     *
+     * @param count Count of bytes.
+     */
+    void skip(uint32_t count) {
+        _position += count;
+        while (_segment && count) {
+            const uint32_t left = _segment->len - _offset;
+            if (count < left) {
+                _offset += count;
+                return;
+            }
+            count -= left;
+            _segment = _segment->next;
+            _offset = 0;
+        }
+    }
+
+    /** Protocol control block. */
+    struct udp_pcb *_pcb = nullptr;
+    /** Datagrams queued. */
+    Datagram _queue[Q];
+    /** Index of the oldest datagram queued. */
+    uint8_t _head = 0;
+    /** Count of datagrams queued. */
+    volatile uint8_t _count = 0;
+    /** Count of datagrams dropped. */
+    volatile uint32_t _dropped = 0;
+    /** Datagram being read. */
+    struct pbuf *_packet = nullptr;
+    /** Pbuf of the chain being read. */
+    struct pbuf *_segment = nullptr;
+    /** Read offset in the pbuf being read. */
+    uint16_t _offset = 0;
+    /** Read position in the datagram. */
+    uint16_t _position = 0;
+    /** IP address of the sender. */
+    IPAddress _remote;
+    /** UDP port of the sender. */
+    uint16_t _remotePort = 0;
+    /** Datagram being written. */
+    struct pbuf *_output = nullptr;
+    /** Count of bytes written. */
+    uint16_t _length = 0;
+    /** IP address to send to. */
+    ip_addr_t _destination;
+    /** UDP port to send to. */
+    uint16_t _destinationPort = 0;
+};
+
+} // namespace SNMP
+
+#endif /* SNMPLWIP_H_ */
@@ -181,6 +181,33 @@ public:
         return static_cast<VarBind*>(_varBindList->add(new VarBind(oid, value)));
     }
 
+    /**
+     * @brief Moves a VarBind from another message.
+     *
+     * Moves a decoded variable binding, usually from a request, to the message
+     * variable bindings list. OID and value are neither copied nor parsed
+     * again. The VarBind given as parameter is left empty and must not be used
+     * afterwards, except to be deleted with its message.
+     *
+     * @param varbind VarBind to move.
+     * @param value BER of any type replacing the moved value. If not set the
+     * value is moved too.
+     * @return VarBind added, nullptr if the VarBind is not a pair of BERs.
+     */
+    VarBind* take(VarBind *varbind, BER *value = nullptr) {
+        if (varbind->count() != 2) {
+            delete value;
+            return nullptr;
+        }
+        VarBind *result = new VarBind(static_cast<VarBind&&>(*varbind));
+        if (value) {
+            delete result->_bers[1];
+            result->_bers[1] = value;
+            result->getSize(true);
+        }
+        return static_cast<VarBind*>(_varBindList->add(result));
+    }
+
     /**
      * @brief Gets the version.
      *
@@ -357,7 +384,22 @@ public:
      */
     void setSNMPTrapOID(const char *name) {
 //        add(OID::SYSUPTIME, new TimeTicksBER(0));
-        add(OID::SYSUPTIME, new TimeTicksBER(millis() / 10));
+        setSNMPTrapOID(name, Clock::millis() / 10);
+    }
+
+    /**
+     * @brief Sets the SNMPTRAPOID variable binding, with a given uptime.
+     *
+     * @warning Valid only for InformRequest or SNMPv2Trap PDU.
+     *
+     * - Adds mandatory variable binding *sysUpTime.0* with value uptime.
+     * - Adds variable binding *snmpTrapOID.0* with value name.
+     *
+     * @param name snmpTrapOID.0 value.
+     * @param uptime sysUpTime.0 value, in hundredths of a second.
+     */
+    void setSNMPTrapOID(const char *name, const uint32_t uptime) {
+        add(OID::SYSUPTIME, new TimeTicksBER(uptime));
         add(OID::SNMPTRAPOID, new ObjectIdentifierBER(name));
     }
 
@@ -370,6 +412,31 @@ public:
         return _varBindList;
     }
 
+    /**
+     * @brief Builds the message to buffer.
+     *
+     * - Encodes the message to buffer.
+     *
+     * @note The message must already be built with a call to getSize(), which
+     * also gives the size needed to allocate the build buffer.
+     *
+     * ```cpp
+     * uint32_t length = message->getSize(true);
+     * uint8_t *buffer = static_cast<uint8_t*>(malloc(length));
+     * message->build(buffer);
+     * ```
+     *
+     * @param buffer Pointer to the buffer.
+     */
+    void build(uint8_t *buffer) {
+#if SNMP_STREAM
+        BufferStream stream(buffer, ArrayBER::getSize());
+        encode(stream);
+#else
+        encode(buffer);
+#endif
+    }
+
 private:
     /**
      * @brief Builds the message.
@@ -384,7 +451,7 @@ private:
             pdu->add(new IPAddressBER(_trap._agentAddr));
             pdu->add(new IntegerBER(_trap._genericTrap));
             pdu->add(new IntegerBER(_trap._specificTrap));
-            pdu->add(new TimeTicksBER(millis() / 10));
+            pdu->add(new TimeTicksBER(Clock::millis() / 10));
             break;
         case Type::GetBulkRequest:
             pdu->add(new IntegerBER(_generic._requestID));
@@ -470,20 +537,6 @@ private:
         parse();
     }
 #else
-    /**
-     * @brief Builds the message to buffer.
-     *
-     * - Encodes the message to buffer.
-     *
-     * @note The message is already built to compute size needed to allocate the
-     * build buffer.
-     *
-     * @param buffer Pointer to the buffer.
-     */
-    void build(uint8_t *buffer) {
-        encode(buffer);
-    }
-
     /**
      * @brief Parses the message from buffer.
      *
@@ -0,0 +1,294 @@
+#ifndef SNMPMETER_H_
+#define SNMPMETER_H_
+
+#include "SNMP.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @struct Chip
+ * @brief Helper struct to handle cost profiles of Ethernet chips.
+ */
+struct Chip {
+    /**
+     * @brief Enumerates all cost profiles.
+     */
+    enum : uint8_t {
+        W5100,      /**< 0, WIZnet W5100, SPI at 8 MHz, no burst. */
+        W5500,      /**< 1, WIZnet W5500, SPI at 8 MHz, burst. */
+        ENC28J60,   /**< 2, Microchip ENC28J60, SPI at 8 MHz, software stack. */
+    };
+};
+
+/**
+ * @class MeteredUDP
+ * @brief UDP that estimates the time spent in an Ethernet chip.
+ *
+ * Forwards every operation to another UDP object, and counts calls and bytes
+ * read or written. Each call is charged a cost, plus a cost per byte, plus a
+ * cost per datagram received or sent. The costs estimate the time an Ethernet
+ * chip driver takes over SPI on a board, so stream optimizations can be
+ * measured on a host, without hardware.
+ *
+ * With SNMP_STREAM set to 1, each byte is read with a call: the call cost
+ * dominates. With SNMP_STREAM set to 0, the datagram is read with one call.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::MeteredUDP metered(udp, SNMP::Chip::W5100);
+ *
+ * void setup() {
+ *     snmp.begin(metered);
+ * }
+ *
+ * void report() {
+ *     Serial.print(metered.getReadTime());
+ *     Serial.print(" us decoding, ");
+ *     Serial.print(metered.getWriteTime());
+ *     Serial.println(" us encoding");
+ *     metered.reset();
+ * }
+ * ```
+ *
+ * @note Costs of the profiles are estimates of the usual Arduino drivers, not
+ * measurements. Set costs measured on a board with setCost().
+ */
+class MeteredUDP: public UDP {
+public:
+    /**
+     * @brief Creates a MeteredUDP object.
+     *
+     * @param udp UDP object to forward to.
+     * @param chip Cost profile. @see Chip.
+     */
+    MeteredUDP(UDP &udp, const uint8_t chip = Chip::W5500) :
+            _udp(udp) {
+        setProfile(chip);
+    }
+
+    /**
+     * @brief Sets costs from a profile.
+     *
+     * @param chip Cost profile. @see Chip.
+     */
+    void setProfile(const uint8_t chip) {
+        switch (chip) {
+        case Chip::W5100:
+            // 4 SPI bytes per data byte, receive size and pointer registers
+            // read and updated on every call
+            setCost(60000, 4000, 250000);
+            break;
+        case Chip::W5500:
+            // 1 SPI byte per data byte in burst, 3 bytes of frame header
+            setCost(25000, 1000, 120000);
+            break;
+        case Chip::ENC28J60:
+            // Buffer memory access, IP and UDP processed in software
+            setCost(15000, 1200, 400000);
+            break;
+        }
+    }
+
+    /**
+     * @brief Sets costs.
+     *
+     * @param call Cost of a call reading or writing bytes, in nanoseconds.
+     * @param byte Cost of a byte read or written, in nanoseconds.
+     * @param packet Cost of a datagram received or sent, in nanoseconds.
+     */
+    void setCost(const uint32_t call, const uint32_t byte, const uint32_t packet) {
+        _costCall = call;
+        _costByte = byte;
+        _costPacket = packet;
+    }
+
+    /**
+     * @brief Resets counters.
+     */
+    void reset() {
+        _calls = 0;
+        _bytes = 0;
+        _packets = 0;
+        _read = 0;
+        _write = 0;
+    }
+
+    /**
+     * @brief Gets the count of calls reading or writing bytes.
+     *
+     * @return Count of calls.
+     */
+    const uint32_t getCalls() const {
+        return _calls;
+    }
+
+    /**
+     * @brief Gets the count of bytes read or written.
+     *
+     * @return Count of bytes.
+     */
+    const uint32_t getBytes() const {
+        return _bytes;
+    }
+
+    /**
+     * @brief Gets the count of datagrams received or sent.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getPackets() const {
+        return _packets;
+    }
+
+    /**
+     * @brief Gets the estimated time spent receiving and reading.
+     *
+     * It is the cost of decoding with the chip.
+     *
+     * @return Time in microseconds.
+     */
+    const uint32_t getReadTime() const {
+        return _read / 1000;
+    }
+
+    /**
+     * @brief Gets the estimated time spent writing and sending.
+     *
+     * It is the cost of encoding with the chip.
+     *
+     * @return Time in microseconds.
+     */
+    const uint32_t getWriteTime() const {
+        return _write / 1000;
+    }
+
+    /**
+     * @brief Gets the estimated time.
+     *
+     * @return Time in microseconds.
+     */
+    const uint32_t getTime() const {
+        return (_read + _write) / 1000;
+    }
+
+    virtual uint8_t begin(uint16_t port) {
+        return _udp.begin(port);
+    }
+
+    virtual void stop() {
+        _udp.stop();
+    }
+
+    virtual int beginPacket(IPAddress ip, uint16_t port) {
+        charge(_write, 0);
+        return _udp.beginPacket(ip, port);
+    }
+
+    virtual int beginPacket(const char *host, uint16_t port) {
+        charge(_write, 0);
+        return _udp.beginPacket(host, port);
+    }
+
+    virtual int endPacket() {
+        _packets++;
+        _write += _costPacket;
+        return _udp.endPacket();
+    }
+
+    virtual size_t write(uint8_t byte) {
+        charge(_write, 1);
+        return _udp.write(byte);
+    }
+
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        charge(_write, size);
+        return _udp.write(buffer, size);
+    }
+
+    virtual int parsePacket() {
+        const int size = _udp.parsePacket();
+        if (size) {
+            _packets++;
+            _read += _costPacket;
+        }
+        return size;
+    }
+
+    virtual int available() {
+        charge(_read, 0);
+        return _udp.available();
+    }
+
+    virtual int read() {
+        charge(_read, 1);
+        return _udp.read();
+    }
+
+    virtual int read(unsigned char *buffer, size_t length) {
+        const int count = _udp.read(buffer, length);
+        charge(_read, count > 0 ? count : 0);
+        return count;
+    }
+
+    virtual int read(char *buffer, size_t length) {
+        return read(reinterpret_cast<unsigned char*>(buffer), length);
+    }
+
+    virtual int peek() {
+        charge(_read, 0);
+        return _udp.peek();
+    }
+
+    virtual void flush() {
+        _udp.flush();
+    }
+
+    virtual IPAddress remoteIP() {
+        return _udp.remoteIP();
+    }
+
+    virtual uint16_t remotePort() {
+        return _udp.remotePort();
+    }
+
+private:
+    /**
+     * @brief Charges a call.
+     *
+     * @param time Time to charge, read or write.
+     * @param bytes Count of bytes read or written.
+     */
+    void charge(uint64_t &time, const uint32_t bytes) {
+        _calls++;
+        _bytes += bytes;
+        time += _costCall + static_cast<uint64_t>(_costByte) * bytes;
+    }
+
+    /** UDP object to forward to. */
+    UDP &_udp;
+    /** Cost of a call in nanoseconds. */
+    uint32_t _costCall = 0;
+    /** Cost of a byte in nanoseconds. */
+    uint32_t _costByte = 0;
+    /** Cost of a datagram in nanoseconds. */
+    uint32_t _costPacket = 0;
+    /** Count of calls. */
+    uint32_t _calls = 0;
+    /** Count of bytes. */
+    uint32_t _bytes = 0;
+    /** Count of datagrams. */
+    uint32_t _packets = 0;
+    /** Estimated time reading in nanoseconds. */
+    uint64_t _read = 0;
+    /** Estimated time writing in nanoseconds. */
+    uint64_t _write = 0;
+};
+
+} // namespace SNMP
+
+#endif /* SNMPMETER_H_ */
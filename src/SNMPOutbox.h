@@ -0,0 +1,398 @@
+#ifndef SNMPOUTBOX_H_
+#define SNMPOUTBOX_H_
+
+#include "SNMP.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @struct Policy
+ * @brief Helper struct to handle overflow policies of an Outbox.
+ */
+struct Policy {
+    /**
+     * @brief Enumerates all overflow policies.
+     */
+    enum : uint8_t {
+        DropTraps,  /**< 0, drops the oldest trap queued, or the new datagram if none. */
+        DropNewest, /**< 1, drops the new datagram. */
+        DropOldest, /**< 2, drops the oldest datagram queued. */
+    };
+};
+
+/**
+ * @class Outbox
+ * @brief Bounded transmit queue of an agent.
+ *
+ * Responses and traps are encoded in the outbox instead of being written to
+ * the UDP object. Each SNMP::loop() sends at most one queued datagram, so a
+ * slow transport delays the processing of incoming requests by one write at
+ * most. Blocking is bounded, not removed: that write still blocks as long as
+ * the transport does.
+ *
+ * - The outbox has N preallocated slots of S bytes.
+ * - When the transport refuses a datagram, endPacket() fails, it stays queued
+ * and the outbox backs off before sending it again, up to the attempts count.
+ * - When the outbox is full, the overflow policy chooses the datagram to
+ * drop. By default, traps are dropped first, so responses are kept.
+ * - Depth, peak depth and counts of datagrams sent, dropped and failed are
+ * available.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Agent snmp;
+ * SNMP::Outbox<8> outbox(snmp);
+ *
+ * void onMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+ *     SNMP::Message *response = new SNMP::Message(message->getVersion(),
+ *             message->getCommunity(), SNMP::Type::GetResponse);
+ *     // ...
+ *     outbox.send(response, remote, port);
+ *     delete response;
+ * }
+ *
+ * void setup() {
+ *     // ...
+ *     outbox.begin();
+ * }
+ * ```
+ *
+ * @tparam N Count of slots, up to 255.
+ * @tparam S Size of a slot in bytes.
+ */
+template<const uint8_t N, const uint16_t S = 484>
+class Outbox: public Handler {
+public:
+    /**
+     * @brief Creates an Outbox object.
+     *
+     * @param agent %SNMP agent used to send datagrams.
+     */
+    Outbox(Agent &agent) :
+            _agent(agent) {
+        for (uint8_t index = 0; index < N; ++index) {
+            _order[index] = index;
+        }
+    }
+
+    /**
+     * @brief Outbox destructor.
+     */
+    virtual ~Outbox() {
+        stop();
+    }
+
+    /**
+     * @brief Starts sending queued datagrams.
+     */
+    void begin() {
+        if (!_running) {
+            _agent.attach(*this);
+            _running = true;
+        }
+    }
+
+    /**
+     * @brief Stops sending queued datagrams.
+     *
+     * Queued datagrams are kept and sent after the next begin().
+     */
+    void stop() {
+        if (_running) {
+            _agent.detach(*this);
+            _running = false;
+        }
+    }
+
+    /**
+     * @brief Sets the overflow policy.
+     *
+     * @param policy Policy. @see Policy.
+     */
+    void setPolicy(const uint8_t policy) {
+        _policy = policy;
+    }
+
+    /**
+     * @brief Sets the delay after a datagram refused by the transport.
+     *
+     * @param backoff Delay in milliseconds before the next attempt.
+     */
+    void setBackoff(const uint16_t backoff) {
+        _backoff = backoff;
+    }
+
+    /**
+     * @brief Sets the count of attempts to send a datagram.
+     *
+     * @param attempts Count of attempts before the datagram is dropped as
+     * failed.
+     */
+    void setAttempts(const uint8_t attempts) {
+        _attempts = attempts;
+    }
+
+    /**
+     * @brief Queues a message.
+     *
+     * The message is encoded in the outbox, it can be deleted on return.
+     * TRAP, SNMPV2TRAP and INFORMREQUEST messages are traps for the overflow
+     * policy.
+     *
+     * @param message %SNMP message to send.
+     * @param ip IP address to send to.
+     * @param port UDP port to send to.
+     * @return true if queued, false if dropped.
+     */
+    bool send(Message *message, const IPAddress ip, const uint16_t port) {
+        const uint8_t type = message->getType();
+        const bool trap = (type == Type::Trap) || (type == Type::SNMPv2Trap)
+                || (type == Type::InformRequest);
+        const uint32_t length = message->getSize(true);
+        Slot *slot = claim(length, trap);
+        if (!slot) {
+            return false;
+        }
+        message->build(slot->_buffer);
+        push(slot, length, ip, port, trap);
+        return true;
+    }
+
+    /**
+     * @brief Queues an encoded datagram.
+     *
+     * @param buffer Pointer to the encoded message.
+     * @param length Length of the encoded message.
+     * @param ip IP address to send to.
+     * @param port UDP port to send to.
+     * @param trap true if the datagram is a trap for the overflow policy.
+     * @return true if queued, false if dropped.
+     */
+    bool send(const uint8_t *buffer, const uint32_t length, const IPAddress ip,
+            const uint16_t port, const bool trap = false) {
+        Slot *slot = claim(length, trap);
+        if (!slot) {
+            return false;
+        }
+        memcpy(slot->_buffer, buffer, length);
+        push(slot, length, ip, port, trap);
+        return true;
+    }
+
+    /**
+     * @brief Gets the count of datagrams queued.
+     *
+     * @return Count of datagrams.
+     */
+    const uint8_t getDepth() const {
+        return _count;
+    }
+
+    /**
+     * @brief Gets the highest count of datagrams queued.
+     *
+     * @return Count of datagrams.
+     */
+    const uint8_t getPeak() const {
+        return _peak;
+    }
+
+    /**
+     * @brief Gets the count of datagrams sent.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getSent() const {
+        return _sent;
+    }
+
+    /**
+     * @brief Gets the count of datagrams dropped on overflow or too long.
+     *
+     * @param trap true for traps, false for other datagrams.
+     * @return Count of datagrams.
+     */
+    const uint32_t getDropped(const bool trap) const {
+        return _dropped[trap];
+    }
+
+    /**
+     * @brief Gets the count of datagrams dropped after all attempts failed.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getFailed() const {
+        return _failed;
+    }
+
+    /**
+     * @brief Processes pending work.
+     *
+     * Sends the oldest queued datagram. After a datagram refused by the
+     * transport, nothing is sent until the backoff delay has elapsed.
+     */
+    virtual void loop() {
+        if (!_count) {
+            return;
+        }
+        const unsigned long now = Clock::millis();
+        if (_busy && (now - _refused < _backoff)) {
+            return;
+        }
+        Slot &slot = _slots[_order[0]];
+        _busy = !_agent.send(slot._buffer, slot._length,
+                IPAddress(slot._address[0], slot._address[1],
+                        slot._address[2], slot._address[3]), slot._port);
+        if (!_busy) {
+            _sent++;
+        } else {
+            _refused = now;
+            if (++slot._attempts < _attempts) {
+                // Transport is busy, try again after the backoff
+                return;
+            }
+            _failed++;
+        }
+        remove(0);
+    }
+
+private:
+    /** Default delay in milliseconds after a refused datagram. */
+    static constexpr uint16_t BACKOFF = 100;
+    /** Default count of attempts to send a datagram. */
+    static constexpr uint8_t ATTEMPTS = 3;
+
+    /**
+     * @struct Slot
+     * @brief Queued datagram.
+     */
+    struct Slot {
+        /** Length of the datagram. */
+        uint16_t _length;
+        /** UDP port to send to. */
+        uint16_t _port;
+        /** IP address to send to. */
+        uint8_t _address[4];
+        /** True if the datagram is a trap. */
+        bool _trap;
+        /** Count of failed attempts. */
+        uint8_t _attempts;
+        /** Encoded datagram. */
+        uint8_t _buffer[S];
+    };
+
+    /**
+     * @brief Gets a free slot, applying the overflow policy.
+     *
+     * @param length Length of the new datagram.
+     * @param trap true if the new datagram is a trap.
+     * @return Pointer to the slot, nullptr if the new datagram is dropped.
+     */
+    Slot* claim(const uint32_t length, const bool trap) {
+        if (length > S) {
+            _dropped[trap]++;
+            return nullptr;
+        }
+        if (_count == N) {
+            uint8_t victim = N;
+            switch (_policy) {
+            case Policy::DropTraps:
+                for (uint8_t index = 0; index < _count; ++index) {
+                    if (_slots[_order[index]]._trap) {
+                        victim = index;
+                        break;
+                    }
+                }
+                break;
+            case Policy::DropOldest:
+                victim = 0;
+                break;
+            }
+            if (victim == N) {
+                _dropped[trap]++;
+                return nullptr;
+            }
+            _dropped[_slots[_order[victim]]._trap]++;
+            remove(victim);
+        }
+        // Free slots are kept after the queued ones in the order
+        return &_slots[_order[_count]];
+    }
+
+    /**
+     * @brief Queues a claimed slot.
+     *
+     * @param slot Slot claimed.
+     * @param length Length of the datagram.
+     * @param ip IP address to send to.
+     * @param port UDP port to send to.
+     * @param trap true if the datagram is a trap.
+     */
+    void push(Slot *slot, const uint32_t length, const IPAddress &ip,
+            const uint16_t port, const bool trap) {
+        slot->_length = length;
+        slot->_port = port;
+        for (uint8_t index = 0; index < 4; ++index) {
+            slot->_address[index] = ip[index];
+        }
+        slot->_trap = trap;
+        slot->_attempts = 0;
+        if (++_count > _peak) {
+            _peak = _count;
+        }
+    }
+
+    /**
+     * @brief Removes a datagram from the queue.
+     *
+     * The slot is moved after the queued ones.
+     *
+     * @param position Position of the datagram in the queue.
+     */
+    void remove(const uint8_t position) {
+        const uint8_t slot = _order[position];
+        for (uint8_t index = position; index + 1 < N; ++index) {
+            _order[index] = _order[index + 1];
+        }
+        _order[N - 1] = slot;
+        _count--;
+    }
+
+    /** %SNMP agent. */
+    Agent &_agent;
+    /** True if attached. */
+    bool _running = false;
+    /** Overflow policy. */
+    uint8_t _policy = Policy::DropTraps;
+    /** Delay in milliseconds after a refused datagram. */
+    uint16_t _backoff = BACKOFF;
+    /** True if the last datagram was refused by the transport. */
+    bool _busy = false;
+    /** Time of the last refused datagram. */
+    unsigned long _refused = 0;
+    /** Count of attempts to send a datagram. */
+    uint8_t _attempts = ATTEMPTS;
+    /** Slots. */
+    Slot _slots[N];
+    /** Indexes of slots, queued ones first, oldest first. */
+    uint8_t _order[N];
+    /** Count of datagrams queued. */
+    uint8_t _count = 0;
+    /** Highest count of datagrams queued. */
+    uint8_t _peak = 0;
+    /** Count of datagrams sent. */
+    uint32_t _sent = 0;
+    /** Count of datagrams dropped, other datagrams then traps. */
+    uint32_t _dropped[2] = { 0, 0 };
+    /** Count of datagrams dropped after all attempts failed. */
+    uint32_t _failed = 0;
+};
+
+} // namespace SNMP
+
+#endif /* SNMPOUTBOX_H_ */
@@ -0,0 +1,372 @@
+#ifndef SNMPPARTITION_H_
+#define SNMPPARTITION_H_
+
+#include "SNMP.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @class Partition
+ * @brief Partition of targets between managers.
+ *
+ * Several managers share the same list of targets. Each manager only polls
+ * the targets it owns. Ownership is given by rendezvous hashing: a target is
+ * owned by the alive member with the highest hash of member and target
+ * addresses.
+ *
+ * - All members compute the same owner without coordination.
+ * - When a member leaves, only its targets move, spread over the other
+ * members. When it joins again, only those targets move back.
+ *
+ * Membership is a static list of addresses, the same on all members. With
+ * heartbeats enabled, each member sends an SNMPV2TRAP to the other members
+ * periodically, and a member not heard within the timeout is considered dead.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Manager snmp;
+ * SNMP::Partition<4> partition(snmp);
+ *
+ * const IPAddress MEMBERS[] = { IPAddress(192, 168, 2, 2), IPAddress(192, 168, 2, 3) };
+ *
+ * void setup() {
+ *     // ...
+ *     partition.setHeartbeat(1000, 3500);
+ *     partition.begin(MEMBERS, 2, IPAddress(192, 168, 2, 2));
+ * }
+ *
+ * void poll(const IPAddress target) {
+ *     if (partition.owns(target)) {
+ *         // Send request to target...
+ *     }
+ * }
+ * ```
+ *
+ * @tparam M Maximum count of members, self included.
+ */
+template<const uint8_t M>
+class Partition: public Handler {
+    static_assert(M > 1, "M must be at least 2");
+
+public:
+    /**
+     * @brief On change event user handler type.
+     *
+     * Called when a member is considered dead or alive again.
+     *
+     * @param member IP address of the member.
+     * @param alive true if alive, false if dead.
+     */
+    using Event = void (*)(const IPAddress, const bool);
+
+    /**
+     * @brief Creates a Partition object.
+     *
+     * @param manager %SNMP manager used to send and receive heartbeats.
+     */
+    Partition(Manager &manager) :
+            _manager(manager) {
+    }
+
+    /**
+     * @brief Partition destructor.
+     */
+    virtual ~Partition() {
+        stop();
+    }
+
+    /**
+     * @brief Starts the partition.
+     *
+     * All members are alive at start.
+     *
+     * @param members IP addresses of the members, self may be included.
+     * @param count Count of members.
+     * @param self IP address of this manager.
+     * @return true if success, false if there are more than M members.
+     */
+    bool begin(const IPAddress *members, const uint8_t count,
+            const IPAddress self) {
+        stop();
+        _self = Encoding::toInteger(self);
+        _count = 0;
+        const unsigned long now = Clock::millis();
+        for (uint8_t index = 0; index < count; ++index) {
+            const uint32_t address = Encoding::toInteger(members[index]);
+            if (address == _self) {
+                continue;
+            }
+            if (_count == M - 1) {
+                return false;
+            }
+            _members[_count++] = { address, now, true };
+        }
+        _last = now - _interval;
+        _running = true;
+        _manager.attach(*this);
+        return true;
+    }
+
+    /**
+     * @brief Stops the partition.
+     */
+    void stop() {
+        if (_running) {
+            _manager.detach(*this);
+            _running = false;
+        }
+    }
+
+    /**
+     * @brief Sets heartbeats.
+     *
+     * @param interval Interval between heartbeats in milliseconds, 0 for a
+     * static membership without heartbeats.
+     * @param timeout Time without heartbeat before a member is considered dead,
+     * in milliseconds.
+     */
+    void setHeartbeat(const uint16_t interval, const uint16_t timeout) {
+        _interval = interval;
+        _timeout = timeout;
+    }
+
+    /**
+     * @brief Sets the community of heartbeats.
+     *
+     * @param community %SNMP community, not copied.
+     */
+    void setCommunity(const char *community) {
+        _community = community;
+    }
+
+    /**
+     * @brief Sets on change event user handler.
+     *
+     * @param event Event handler.
+     */
+    void onChange(Event event) {
+        _onChange = event;
+    }
+
+    /**
+     * @brief Checks if this manager owns a target.
+     *
+     * @param target IP address of the target.
+     * @return true if owned, false otherwise.
+     */
+    bool owns(const IPAddress target) const {
+        return owner(Encoding::toInteger(target)) == _self;
+    }
+
+    /**
+     * @brief Gets the owner of a target.
+     *
+     * @param target IP address of the target.
+     * @return IP address of the alive member owning the target.
+     */
+    IPAddress getOwner(const IPAddress target) const {
+        return Encoding::toAddress(owner(Encoding::toInteger(target)));
+    }
+
+    /**
+     * @brief Gets the count of alive members.
+     *
+     * @return Count of members, self included.
+     */
+    const uint8_t getAlive() const {
+        uint8_t alive = 1;
+        for (uint8_t index = 0; index < _count; ++index) {
+            if (_members[index]._alive) {
+                alive++;
+            }
+        }
+        return alive;
+    }
+
+    /**
+     * @brief Processes an incoming message.
+     *
+     * Consumes heartbeats from members.
+     *
+     * @param message %SNMP message to process.
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     * @return true if the message is a heartbeat from a member.
+     */
+    virtual bool message(const Message *message, const IPAddress remote,
+            const uint16_t port) {
+        if ((message->getType() != Type::SNMPv2Trap)
+                || ((message->getRequestID() & 0xFF000000) != ID)) {
+            return false;
+        }
+        const uint32_t address = Encoding::toInteger(remote);
+        for (uint8_t index = 0; index < _count; ++index) {
+            Member &member = _members[index];
+            if (member._address == address) {
+                member._last = Clock::millis();
+                if (!member._alive) {
+                    member._alive = true;
+                    if (_onChange) {
+                        _onChange(remote, true);
+                    }
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Processes pending work.
+     *
+     * - Sends heartbeats to the other members.
+     * - Marks dead the members not heard within the timeout.
+     */
+    virtual void loop() {
+        if (!_interval) {
+            return;
+        }
+        const unsigned long now = Clock::millis();
+        for (uint8_t index = 0; index < _count; ++index) {
+            Member &member = _members[index];
+            if (member._alive && (now - member._last >= _timeout)) {
+                member._alive = false;
+                if (_onChange) {
+                    _onChange(Encoding::toAddress(member._address), false);
+                }
+            }
+        }
+        if (now - _last >= _interval) {
+            _last = now;
+            heartbeat();
+        }
+    }
+
+private:
+    /** Request identifier prefix of heartbeats. */
+    static constexpr uint32_t ID = 0x42000000;
+    /** Default interval between heartbeats in milliseconds. */
+    static constexpr uint16_t INTERVAL = 1000;
+    /** Default timeout in milliseconds. */
+    static constexpr uint16_t TIMEOUT = 3500;
+    /** snmpTrapOID.0 of heartbeats, under reserved enterprise 0. */
+    static constexpr char *HEARTBEAT = "1.3.6.1.4.1.0.1";
+
+    /**
+     * @struct Member
+     * @brief Other member of the partition.
+     */
+    struct Member {
+        /** Address of the member. */
+        uint32_t _address;
+        /** Time of last heartbeat received. */
+        unsigned long _last;
+        /** True if alive. */
+        bool _alive;
+    };
+
+    /**
+     * @brief Sends a heartbeat to the other members.
+     *
+     * The message is encoded once.
+     */
+    void heartbeat() {
+        Message *message = new Message(Version::V2C, _community,
+                Type::SNMPv2Trap);
+        message->setRequestID(ID | (_sequence++ & 0xFFFFFF));
+        message->setSNMPTrapOID(HEARTBEAT);
+        const uint32_t length = message->getSize(true);
+        uint8_t *buffer = static_cast<uint8_t*>(malloc(length));
+        if (buffer) {
+            message->build(buffer);
+            for (uint8_t index = 0; index < _count; ++index) {
+                _manager.send(buffer, length,
+                        Encoding::toAddress(_members[index]._address), Port::Trap);
+            }
+            free(buffer);
+        }
+        delete message;
+    }
+
+    /**
+     * @brief Gets the owner of a target.
+     *
+     * @param target Address of the target.
+     * @return Address of the alive member with the highest score.
+     */
+    uint32_t owner(const uint32_t target) const {
+        uint32_t best = _self;
+        uint32_t score = weight(_self, target);
+        for (uint8_t index = 0; index < _count; ++index) {
+            const Member &member = _members[index];
+            if (member._alive) {
+                const uint32_t candidate = weight(member._address, target);
+                // Ties are broken by address, so all members agree
+                if ((candidate > score)
+                        || ((candidate == score) && (member._address > best))) {
+                    best = member._address;
+                    score = candidate;
+                }
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief Computes the rendezvous score of a member for a target.
+     *
+     * @param member Address of the member.
+     * @param target Address of the target.
+     * @return Score.
+     */
+    static uint32_t weight(const uint32_t member, const uint32_t target) {
+        return mix(member ^ mix(target));
+    }
+
+    /**
+     * @brief Mixes the bits of an integer.
+     *
+     * @param value Integer.
+     * @return Mixed integer, MurmurHash3 finalizer.
+     */
+    static uint32_t mix(uint32_t value) {
+        value ^= value >> 16;
+        value *= 0x85EBCA6BUL;
+        value ^= value >> 13;
+        value *= 0xC2B2AE35UL;
+        value ^= value >> 16;
+        return value;
+    }
+
+    /** %SNMP manager. */
+    Manager &_manager;
+    /** On change event user handler. */
+    Event _onChange = nullptr;
+    /** True if running. */
+    bool _running = false;
+    /** Address of this manager. */
+    uint32_t _self = 0;
+    /** Other members. */
+    Member _members[M - 1];
+    /** Count of other members. */
+    uint8_t _count = 0;
+    /** Interval between heartbeats, 0 for a static membership. */
+    uint16_t _interval = INTERVAL;
+    /** Timeout of heartbeats. */
+    uint16_t _timeout = TIMEOUT;
+    /** Community of heartbeats. */
+    const char *_community = "public";
+    /** Time of last heartbeat sent. */
+    unsigned long _last = 0;
+    /** Sequence number of heartbeats. */
+    uint32_t _sequence = 0;
+};
+
+} // namespace SNMP
+
+#endif /* SNMPPARTITION_H_ */
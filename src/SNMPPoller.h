@@ -0,0 +1,647 @@
+#ifndef SNMPPOLLER_H_
+#define SNMPPOLLER_H_
+
+#include "SNMP.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @class Poller
+ * @brief Poll scheduler with intervals adapted to the change rate of series.
+ *
+ * A series is an OID of a target. Each series has its own interval, within
+ * configured bounds, adapted after each sample.
+ *
+ * - Value unchanged, the interval is doubled.
+ * - Numeric value changing at a steady rate, the interval is stretched by a
+ * quarter. The rate is the derivative, increase per second.
+ * - Rate changed by more than an eighth, or other value changed, the interval
+ * is halved.
+ *
+ * Due series of a target are grouped in one GETREQUEST, with the series of
+ * the same target due within a quarter of their interval. A request is not
+ * sent again, its series are backed off as if unchanged.
+ *
+ * Intervals and last samples are saved and restored with SNMP::save() and
+ * SNMP::restore(), so a restarted poller does not learn the series again.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Manager snmp;
+ * SNMP::Poller<64> poller(snmp);
+ *
+ * void onSample(const uint16_t series, const IPAddress target, const char *oid, SNMP::BER *value) {
+ *     // User code here...
+ * }
+ *
+ * void setup() {
+ *     // ...
+ *     poller.add(IPAddress(192, 168, 2, 3), "1.3.6.1.2.1.2.2.1.10.1");
+ *     poller.add(IPAddress(192, 168, 2, 3), "1.3.6.1.2.1.1.5.0");
+ *     poller.setBounds(5000, 600000);
+ *     poller.onSample(onSample);
+ *     poller.begin(SNMP::Version::V2C, "public");
+ * }
+ * ```
+ *
+ * @warning OIDs and community are not copied and must remain valid until
+ * stopped.
+ *
+ * @tparam S Maximum count of series.
+ * @tparam U Maximum count of requests in flight, up to 255.
+ */
+template<const uint16_t S, const uint8_t U = 8>
+class Poller: public Handler {
+public:
+    /**
+     * @brief On sample event user handler type.
+     *
+     * @param series Index of the series.
+     * @param target IP address of the target.
+     * @param oid OID of the series.
+     * @param value Value received.
+     */
+    using Event = void (*)(const uint16_t, const IPAddress, const char*, BER*);
+
+    /**
+     * @brief Creates a Poller object.
+     *
+     * @param manager %SNMP manager used to send requests and receive responses.
+     */
+    Poller(Manager &manager) :
+            _manager(manager) {
+    }
+
+    /**
+     * @brief Poller destructor.
+     */
+    virtual ~Poller() {
+        stop();
+    }
+
+    /**
+     * @brief Adds a series.
+     *
+     * A new series starts at the lower bound and is due at once.
+     *
+     * @param target IP address of the target.
+     * @param oid OID to poll.
+     * @return Index of the series, -1 if S series are already added.
+     */
+    int32_t add(const IPAddress target, const char *oid) {
+        if (_count == S) {
+            return -1;
+        }
+        Series &series = _series[_count];
+        series = { };
+        for (uint8_t index = 0; index < 4; ++index) {
+            series._address[index] = target[index];
+        }
+        series._oid = oid;
+        series._interval = _minimum;
+        series._due = Clock::millis();
+        return _count++;
+    }
+
+    /**
+     * @brief Sets the bounds of the intervals.
+     *
+     * @param minimum Lower bound in milliseconds.
+     * @param maximum Upper bound in milliseconds.
+     */
+    void setBounds(const uint32_t minimum, const uint32_t maximum) {
+        _minimum = minimum;
+        _maximum = maximum;
+        for (uint16_t index = 0; index < _count; ++index) {
+            _series[index]._interval = bound(_series[index]._interval);
+        }
+    }
+
+    /**
+     * @brief Sets the request timeout.
+     *
+     * @param timeout Timeout in milliseconds before a request is given up.
+     */
+    void setTimeout(const uint16_t timeout) {
+        _timeout = timeout;
+    }
+
+    /**
+     * @brief Sets on sample event user handler.
+     *
+     * @param event User handler.
+     */
+    void onSample(Event event) {
+        _onSample = event;
+    }
+
+    /**
+     * @brief Starts polling.
+     *
+     * @param version %SNMP version.
+     * @param community %SNMP community.
+     * @param port UDP port of the targets.
+     */
+    void begin(const uint8_t version, const char *community,
+            const uint16_t port = Port::SNMP) {
+        _version = version;
+        _community = community;
+        _port = port;
+        if (!_running) {
+            _manager.attach(*this);
+            _running = true;
+        }
+    }
+
+    /**
+     * @brief Stops polling.
+     */
+    void stop() {
+        if (_running) {
+            _manager.detach(*this);
+            _running = false;
+        }
+    }
+
+    /**
+     * @brief Gets the interval of a series.
+     *
+     * @param series Index of the series.
+     * @return Interval in milliseconds.
+     */
+    const uint32_t getInterval(const uint16_t series) const {
+        return _series[series]._interval;
+    }
+
+    /**
+     * @brief Gets the change frequency of a series.
+     *
+     * Moving average of the samples that changed.
+     *
+     * @param series Index of the series.
+     * @return Frequency, from 0 never changes to 248 always changes.
+     */
+    const uint8_t getFrequency(const uint16_t series) const {
+        return _series[series]._frequency;
+    }
+
+    /**
+     * @brief Gets the rate of a numeric series.
+     *
+     * @param series Index of the series.
+     * @return Increase per second of the last 2 samples, counters wrapped
+     * modulo 2^32 or 2^64.
+     */
+    const int64_t getRate(const uint16_t series) const {
+        return _series[series]._rate;
+    }
+
+    /**
+     * @brief Gets the count of requests sent.
+     *
+     * @return Count of requests.
+     */
+    const uint32_t getRequests() const {
+        return _requests;
+    }
+
+    /**
+     * @brief Gets the count of samples received.
+     *
+     * @return Count of samples.
+     */
+    const uint32_t getSamples() const {
+        return _samples;
+    }
+
+    /**
+     * @brief Gets the kind of checkpoint record.
+     *
+     * @return Kind.
+     */
+    virtual const uint8_t getKind() const {
+        return KIND;
+    }
+
+    /**
+     * @brief Gets the fingerprint of the poller configuration.
+     *
+     * @return Hash of version, community, port and series.
+     */
+    virtual const uint32_t getFingerprint() const {
+        uint32_t hash = Checkpoint::hash(Checkpoint::BASIS, &_version, 1);
+        hash = Checkpoint::hash(hash, _community);
+        hash = Checkpoint::hash(hash, &_port, sizeof(_port));
+        for (uint16_t index = 0; index < _count; ++index) {
+            hash = Checkpoint::hash(hash, _series[index]._address, 4);
+            hash = Checkpoint::hash(hash, _series[index]._oid);
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Saves the intervals and last samples of the series.
+     *
+     * Times are saved relative to now, so they survive a restart.
+     *
+     * @param print Destination.
+     */
+    virtual void save(Print &print) const {
+        const unsigned long now = Clock::millis();
+        Checkpoint::write(print, _count, 2);
+        Checkpoint::write(print, 0, 2);
+        Checkpoint::write(print, _requests, 4);
+        Checkpoint::write(print, _samples, 4);
+        for (uint16_t index = 0; index < _count; ++index) {
+            const Series &series = _series[index];
+            const long due = static_cast<long>(series._due - now);
+            Checkpoint::write(print, series._interval, 4);
+            Checkpoint::write(print, due > 0 ? due : 0, 4);
+            Checkpoint::write(print, now - series._time, 4);
+            Checkpoint::write(print, series._hash, 4);
+            Checkpoint::write(print, series._value, 4);
+            Checkpoint::write(print, static_cast<uint64_t>(series._value) >> 32, 4);
+            Checkpoint::write(print, series._rate, 4);
+            Checkpoint::write(print, static_cast<uint64_t>(series._rate) >> 32, 4);
+            Checkpoint::write(print, series._frequency, 1);
+            Checkpoint::write(print, series._sampled | (series._derived << 1), 1);
+            Checkpoint::write(print, 0, 2);
+        }
+    }
+
+    /**
+     * @brief Restores the intervals and last samples of the series.
+     *
+     * The poller must be started with the same series. Requests in flight are
+     * abandoned.
+     *
+     * @param data Pointer to the record payload.
+     * @param length Length of the payload.
+     * @return true if success, false otherwise.
+     */
+    virtual bool restore(const uint8_t *data, const uint32_t length) {
+        const uint8_t *pointer = data;
+        if ((length < 12) || (Checkpoint::read(pointer, 2) != _count)
+                || (length < 12 + static_cast<uint32_t>(RECORD) * _count)) {
+            return false;
+        }
+        pointer += 2;
+        _requests = Checkpoint::read(pointer, 4);
+        _samples = Checkpoint::read(pointer, 4);
+        const unsigned long now = Clock::millis();
+        for (uint16_t index = 0; index < _count; ++index) {
+            Series &series = _series[index];
+            series._interval = bound(Checkpoint::read(pointer, 4));
+            series._due = now + Checkpoint::read(pointer, 4);
+            series._time = now - Checkpoint::read(pointer, 4);
+            series._hash = Checkpoint::read(pointer, 4);
+            uint64_t value = Checkpoint::read(pointer, 4);
+            series._value = value | static_cast<uint64_t>(Checkpoint::read(pointer, 4)) << 32;
+            value = Checkpoint::read(pointer, 4);
+            series._rate = value | static_cast<uint64_t>(Checkpoint::read(pointer, 4)) << 32;
+            series._frequency = *pointer++;
+            series._sampled = *pointer & 1;
+            series._derived = *pointer & 2;
+            pointer += 3;
+            series._pending = false;
+        }
+        for (uint8_t slot = 0; slot < U; ++slot) {
+            _inflight[slot]._count = 0;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Processes an incoming message.
+     *
+     * Matches a GETRESPONSE to a request in flight by request identifier and
+     * sender, then samples its series.
+     *
+     * @param message %SNMP message to process.
+     * @param remote IP address of the sender.
+     * @param port UDP port of the sender.
+     * @return true if the message answers a request in flight.
+     */
+    virtual bool message(const Message *message, const IPAddress remote,
+            const uint16_t port) {
+        const uint32_t id = message->getRequestID();
+        if ((message->getType() != Type::GetResponse)
+                || ((id & 0xFF000000) != ID)) {
+            return false;
+        }
+        const uint8_t slot = id & 0xFF;
+        if (slot >= U) {
+            return false;
+        }
+        Request &request = _inflight[slot];
+        if (!request._count || (request._id != id)) {
+            return false;
+        }
+        const Series &first = _series[request._series[0]];
+        if (!(IPAddress(first._address[0], first._address[1],
+                first._address[2], first._address[3]) == remote)) {
+            return false;
+        }
+        const unsigned long now = Clock::millis();
+        VarBindList *varbindlist = message->getVarBindList();
+        for (uint8_t index = 0; index < request._count; ++index) {
+            const uint16_t number = request._series[index];
+            Series &series = _series[number];
+            series._pending = false;
+            if ((message->getErrorStatus() != Error::NoError)
+                    || (index >= varbindlist->count())) {
+                series._interval = bound(series._interval * 2);
+            } else {
+                BER *value = (*varbindlist)[index]->getValue();
+                sample(series, value, now);
+                _samples++;
+                if (_onSample) {
+                    _onSample(number, remote, series._oid, value);
+                }
+            }
+            series._due = now + series._interval;
+        }
+        request._count = 0;
+        return true;
+    }
+
+    /**
+     * @brief Processes pending work.
+     *
+     * - Gives up timed out requests.
+     * - Sends a request for each target with due series.
+     */
+    virtual void loop() {
+        const unsigned long now = Clock::millis();
+        for (uint8_t slot = 0; slot < U; ++slot) {
+            Request &request = _inflight[slot];
+            if (request._count && (now - request._time >= _timeout)) {
+                SNMP_PROBE(timeout, request._id, Type::GetRequest,
+                        target(request), _port, 0, 1);
+                for (uint8_t index = 0; index < request._count; ++index) {
+                    // Unreachable target is backed off like a static series
+                    Series &series = _series[request._series[index]];
+                    series._pending = false;
+                    series._interval = bound(series._interval * 2);
+                    series._due = now + series._interval;
+                }
+                request._count = 0;
+            }
+        }
+        for (uint16_t index = 0; index < _count; ++index) {
+            const Series &series = _series[index];
+            if (!series._pending
+                    && (static_cast<long>(now - series._due) >= 0)) {
+                if (!poll(index, now)) {
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    /**
+     * Request identifier prefix of the requests.
+     *
+     * Tag in the second byte, slot in the first one.
+     */
+    static constexpr uint32_t ID = 0x44000000;
+    /** Maximum count of variable bindings of a request. */
+    static constexpr uint8_t LIMIT = SNMP_VECTOR ? 32 : SNMP_CAPACITY;
+    /** Default lower bound of the intervals. */
+    static constexpr uint32_t MINIMUM = 10000;
+    /** Default upper bound of the intervals. */
+    static constexpr uint32_t MAXIMUM = 3600000;
+    /** Default request timeout. */
+    static constexpr uint16_t TIMEOUT = 2000;
+    /** Kind of checkpoint record. */
+    static constexpr uint8_t KIND = 'P';
+    /** Size of a series in a checkpoint record. */
+    static constexpr uint8_t RECORD = 36;
+    /** Size of the content buffer of a sample. */
+    static constexpr uint8_t CHUNK = 16;
+
+    /**
+     * @struct Series
+     * @brief OID of a target.
+     */
+    struct Series {
+        /** IP address of the target. */
+        uint8_t _address[4];
+        /** OID. */
+        const char *_oid;
+        /** Interval. */
+        uint32_t _interval;
+        /** Time of next poll. */
+        unsigned long _due;
+        /** Time of last sample. */
+        unsigned long _time;
+        /** Numeric value of last sample. */
+        int64_t _value;
+        /** Increase per second. */
+        int64_t _rate;
+        /** Hash of last sample. */
+        uint32_t _hash;
+        /** Change frequency. */
+        uint8_t _frequency;
+        /** True if sampled once. */
+        bool _sampled;
+        /** True if sampled twice, rate is valid. */
+        bool _derived;
+        /** True if in a request in flight. */
+        bool _pending;
+    };
+
+    /**
+     * @struct Request
+     * @brief Request in flight.
+     */
+    struct Request {
+        /** Request identifier. */
+        uint32_t _id;
+        /** Time of sending. */
+        unsigned long _time;
+        /** Indexes of the series. */
+        uint16_t _series[LIMIT];
+        /** Count of series, 0 if free. */
+        uint8_t _count;
+        /** Tag incremented on each use of the slot. */
+        uint8_t _tag;
+    };
+
+    /**
+     * @brief Gets the target of a request.
+     *
+     * @param request Request in flight.
+     * @return IP address of the target.
+     */
+    IPAddress target(const Request &request) const {
+        const uint8_t *address = _series[request._series[0]]._address;
+        return IPAddress(address[0], address[1], address[2], address[3]);
+    }
+
+    /**
+     * @brief Bounds an interval.
+     *
+     * @param interval Interval.
+     * @return Interval within bounds.
+     */
+    uint32_t bound(const uint32_t interval) const {
+        return interval < _minimum ? _minimum :
+                interval > _maximum ? _maximum : interval;
+    }
+
+    /**
+     * @brief Sends a request for a due series, with the series of the same
+     * target due soon.
+     *
+     * @param index Index of the due series.
+     * @param now Current time.
+     * @return true if sent, false if no request slot is free.
+     */
+    bool poll(const uint16_t index, const unsigned long now) {
+        uint8_t slot = 0;
+        while ((slot < U) && _inflight[slot]._count) {
+            slot++;
+        }
+        if (slot == U) {
+            return false;
+        }
+        Request &request = _inflight[slot];
+        request._id = ID | (static_cast<uint32_t>(++request._tag) << 8) | slot;
+        request._time = now;
+        const Series &due = _series[index];
+        Message *message = new Message(_version, _community, Type::GetRequest);
+        message->setRequestID(request._id);
+        for (uint16_t other = index; (other < _count)
+                && (request._count < LIMIT); ++other) {
+            Series &series = _series[other];
+            if (series._pending
+                    || memcmp(series._address, due._address, 4)
+                    || (static_cast<long>(now + series._interval / 4
+                            - series._due) < 0)) {
+                continue;
+            }
+            message->add(series._oid);
+            series._pending = true;
+            request._series[request._count++] = other;
+        }
+        _manager.send(message, IPAddress(due._address[0], due._address[1],
+                due._address[2], due._address[3]), _port);
+        delete message;
+        _requests++;
+        return true;
+    }
+
+    /**
+     * @brief Samples a series and adapts its interval.
+     *
+     * @param series Series.
+     * @param value Value received.
+     * @param now Current time.
+     */
+    void sample(Series &series, BER *value, const unsigned long now) {
+        const uint8_t type = value->getType();
+        uint8_t chunk[CHUNK];
+        const unsigned int length = value->getContent(chunk, CHUNK);
+        const bool numeric = (length <= 8) && ((type == Type::Integer)
+                || (type == Type::Counter32) || (type == Type::Gauge32)
+                || (type == Type::TimeTicks) || (type == Type::Counter64));
+        int64_t number = (type == Type::Integer) && length
+                && (chunk[0] & 0x80) ? -1 : 0;
+        for (uint8_t index = 0; numeric && (index < length); ++index) {
+            number = static_cast<int64_t>(static_cast<uint64_t>(number) << 8)
+                    | chunk[index];
+        }
+        // Type and content octets, hashed by chunks
+        uint32_t hash = Checkpoint::hash(Checkpoint::BASIS, &type, 1);
+        for (unsigned int offset = 0; offset < length; offset += CHUNK) {
+            if (offset) {
+                value->getContent(chunk, CHUNK, offset);
+            }
+            hash = Checkpoint::hash(hash, chunk,
+                    length - offset < CHUNK ? length - offset : CHUNK);
+        }
+        const bool changed = series._sampled && (hash != series._hash);
+        series._frequency = series._frequency - (series._frequency >> 3)
+                + (changed ? 31 : 0);
+        if (series._sampled) {
+            if (!changed) {
+                series._interval = bound(series._interval * 2);
+            } else if (numeric) {
+                const unsigned long elapsed = now - series._time;
+                int64_t rate = 0;
+                if (elapsed && ((type == Type::Counter32)
+                        || (type == Type::Counter64))) {
+                    // Counters wrap, increase is modulo 2^32 or 2^64
+                    uint64_t increase = static_cast<uint64_t>(number)
+                            - static_cast<uint64_t>(series._value);
+                    if (type == Type::Counter32) {
+                        increase = static_cast<uint32_t>(increase);
+                    }
+                    rate = increase / elapsed * 1000
+                            + increase % elapsed * 1000 / elapsed;
+                } else if (elapsed) {
+                    rate = (number - series._value) * 1000
+                            / static_cast<int64_t>(elapsed);
+                }
+                const int64_t drift = rate - series._rate;
+                const int64_t tolerance = (series._rate < 0 ?
+                        -series._rate : series._rate) / 8;
+                if (series._derived && (drift <= tolerance)
+                        && (-drift <= tolerance)) {
+                    series._interval = bound(series._interval
+                            + series._interval / 4);
+                } else {
+                    series._interval = bound(series._interval / 2);
+                }
+                series._rate = rate;
+                series._derived = true;
+            } else {
+                series._interval = bound(series._interval / 2);
+            }
+        }
+        series._value = number;
+        series._hash = hash;
+        series._time = now;
+        series._sampled = true;
+    }
+
+    /** %SNMP manager. */
+    Manager &_manager;
+    /** On sample event user handler. */
+    Event _onSample = nullptr;
+    /** True if attached. */
+    bool _running = false;
+    /** %SNMP version. */
+    uint8_t _version = Version::V2C;
+    /** %SNMP community. */
+    const char *_community = "public";
+    /** UDP port of the targets. */
+    uint16_t _port = Port::SNMP;
+    /** Lower bound of the intervals. */
+    uint32_t _minimum = MINIMUM;
+    /** Upper bound of the intervals. */
+    uint32_t _maximum = MAXIMUM;
+    /** Request timeout. */
+    uint16_t _timeout = TIMEOUT;
+    /** Count of series. */
+    uint16_t _count = 0;
+    /** Count of requests sent. */
+    uint32_t _requests = 0;
+    /** Count of samples received. */
+    uint32_t _samples = 0;
+    /** Series. */
+    Series _series[S];
+    /** Requests in flight. */
+    Request _inflight[U] = { };
+};
+
+} // namespace SNMP
+
+#endif /* SNMPPOLLER_H_ */
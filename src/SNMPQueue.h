@@ -0,0 +1,296 @@
+#ifndef SNMPQUEUE_H_
+#define SNMPQUEUE_H_
+
+#include "SNMP.h"
+
+#include <atomic>
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @class Queue
+ * @brief Multiple producers submission queue of outgoing datagrams.
+ *
+ * Application threads submit messages or encoded datagrams to send. The
+ * thread calling SNMP::loop() drains the queue in batches and writes to the
+ * UDP object, which is never shared.
+ *
+ * - The queue is a bounded ring of N preallocated slots of S bytes.
+ * - A producer claims a slot with a compare and swap, encodes into it, then
+ * publishes it. No mutex, a producer never blocks on the socket.
+ * - When the queue is full, or the datagram is longer than S bytes, submit()
+ * fails and the datagram is counted as dropped.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Manager snmp;
+ * SNMP::Queue<16> queue(snmp);
+ *
+ * void setup() {
+ *     // ...
+ *     queue.begin();
+ * }
+ *
+ * // Any thread
+ * void poll(SNMP::Message *message) {
+ *     queue.submit(message, IPAddress(192, 168, 2, 3), SNMP::Port::SNMP);
+ * }
+ * ```
+ *
+ * @warning Requires std::atomic, not available on AVR.
+ *
+ * @tparam N Count of slots, a power of 2.
+ * @tparam S Size of a slot in bytes.
+ */
+template<const uint16_t N, const uint16_t S = 484>
+class Queue: public Handler {
+    static_assert(N && !(N & (N - 1)), "N must be a power of 2");
+
+public:
+    /**
+     * @brief Creates a Queue object.
+     *
+     * @param snmp %SNMP agent or manager used to send datagrams.
+     */
+    Queue(SNMP &snmp) :
+            _snmp(snmp) {
+        for (uint16_t index = 0; index < N; ++index) {
+            _slots[index]._sequence.store(index, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Queue destructor.
+     */
+    virtual ~Queue() {
+        stop();
+    }
+
+    /**
+     * @brief Starts draining the queue from SNMP::loop().
+     */
+    void begin() {
+        if (!_running) {
+            _snmp.attach(*this);
+            _running = true;
+        }
+    }
+
+    /**
+     * @brief Stops draining the queue from SNMP::loop().
+     */
+    void stop() {
+        if (_running) {
+            _snmp.detach(*this);
+            _running = false;
+        }
+    }
+
+    /**
+     * @brief Sets the maximum count of datagrams sent by each loop.
+     *
+     * @param batch Count of datagrams.
+     */
+    void setBatch(const uint16_t batch) {
+        _batch = batch;
+    }
+
+    /**
+     * @brief Submits a message.
+     *
+     * The message is encoded in the queue, it can be deleted on return.
+     *
+     * @note Like with SNMP::send(), a message is built once and can not be
+     * submitted again, even on failure.
+     *
+     * @param message %SNMP message to send.
+     * @param ip IP address to send to.
+     * @param port UDP port to send to.
+     * @return true if submitted, false if the queue is full or the message is
+     * too long.
+     */
+    bool submit(Message *message, const IPAddress ip, const uint16_t port) {
+        const uint32_t length = message->getSize(true);
+        Slot *slot = length <= S ? claim() : nullptr;
+        if (!slot) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        message->build(slot->_buffer);
+        publish(slot, length, ip, port);
+        return true;
+    }
+
+    /**
+     * @brief Submits an encoded datagram.
+     *
+     * The datagram is copied in the queue.
+     *
+     * @param buffer Pointer to the encoded message.
+     * @param length Length of the encoded message.
+     * @param ip IP address to send to.
+     * @param port UDP port to send to.
+     * @return true if submitted, false if the queue is full or the datagram is
+     * too long.
+     */
+    bool submit(const uint8_t *buffer, const uint32_t length,
+            const IPAddress ip, const uint16_t port) {
+        Slot *slot = length <= S ? claim() : nullptr;
+        if (!slot) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        memcpy(slot->_buffer, buffer, length);
+        publish(slot, length, ip, port);
+        return true;
+    }
+
+    /**
+     * @brief Sends submitted datagrams.
+     *
+     * Must be called from the thread owning the UDP object only.
+     *
+     * @param count Maximum count of datagrams to send.
+     * @return Count of datagrams sent.
+     */
+    uint16_t drain(const uint16_t count) {
+        uint16_t sent = 0;
+        while (sent < count) {
+            Slot &slot = _slots[_head & (N - 1)];
+            if (slot._sequence.load(std::memory_order_acquire) != _head + 1) {
+                break;
+            }
+            _snmp.send(slot._buffer, slot._length,
+                    IPAddress(slot._address[0], slot._address[1],
+                            slot._address[2], slot._address[3]), slot._port);
+            slot._sequence.store(_head + N, std::memory_order_release);
+            _head++;
+            sent++;
+        }
+        _sent.fetch_add(sent, std::memory_order_relaxed);
+        return sent;
+    }
+
+    /**
+     * @brief Gets the count of datagrams sent.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getSent() const {
+        return _sent.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Gets the count of datagrams dropped.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getDropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Processes pending work.
+     *
+     * Sends a batch of submitted datagrams.
+     */
+    virtual void loop() {
+        drain(_batch);
+    }
+
+private:
+    /** Default count of datagrams sent by each loop. */
+    static constexpr uint16_t BATCH = 8;
+
+    /**
+     * @struct Slot
+     * @brief Slot of the ring.
+     *
+     * The sequence tells the state of the slot for a position p of the ring:
+     * p free, p + 1 published.
+     */
+    struct Slot {
+        /** Sequence. */
+        std::atomic<uint32_t> _sequence;
+        /** Length of the datagram. */
+        uint16_t _length;
+        /** UDP port to send to. */
+        uint16_t _port;
+        /** IP address to send to. */
+        uint8_t _address[4];
+        /** Encoded datagram. */
+        uint8_t _buffer[S];
+    };
+
+    /**
+     * @brief Claims a free slot.
+     *
+     * @return Pointer to the slot, nullptr if the queue is full.
+     */
+    Slot* claim() {
+        uint32_t position = _tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = _slots[position & (N - 1)];
+            const int32_t difference =
+                    static_cast<int32_t>(slot._sequence.load(
+                            std::memory_order_acquire) - position);
+            if (difference == 0) {
+                if (_tail.compare_exchange_weak(position, position + 1,
+                        std::memory_order_relaxed)) {
+                    return &slot;
+                }
+            } else if (difference < 0) {
+                return nullptr;
+            } else {
+                position = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Publishes a claimed slot to the consumer.
+     *
+     * @param slot Slot claimed.
+     * @param length Length of the datagram.
+     * @param ip IP address to send to.
+     * @param port UDP port to send to.
+     */
+    void publish(Slot *slot, const uint32_t length, const IPAddress &ip,
+            const uint16_t port) {
+        slot->_length = length;
+        slot->_port = port;
+        for (uint8_t index = 0; index < 4; ++index) {
+            slot->_address[index] = ip[index];
+        }
+        // The slot position is its sequence when claimed
+        slot->_sequence.store(
+                slot->_sequence.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+    }
+
+    /** %SNMP agent or manager. */
+    SNMP &_snmp;
+    /** True if attached. */
+    bool _running = false;
+    /** Maximum count of datagrams sent by each loop. */
+    uint16_t _batch = BATCH;
+    /** Slots. */
+    Slot _slots[N];
+    /** Position of the next slot to claim, shared by producers. */
+    alignas(64) std::atomic<uint32_t> _tail { 0 };
+    /** Position of the next slot to send, owned by the consumer. */
+    alignas(64) uint32_t _head = 0;
+    /** Count of datagrams sent. */
+    std::atomic<uint32_t> _sent { 0 };
+    /** Count of datagrams dropped. */
+    std::atomic<uint32_t> _dropped { 0 };
+};
+
+} // namespace SNMP
+
+#endif /* SNMPQUEUE_H_ */
@@ -0,0 +1,346 @@
+#ifndef SNMPSEGMENTS_H_
+#define SNMPSEGMENTS_H_
+
+#include "SNMP.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @class Sink
+ * @brief Receiver of borrowed values while a message is encoded.
+ *
+ * Only one sink is active at a time, set by Segments::build().
+ */
+class Sink {
+public:
+    /**
+     * @brief Sink destructor.
+     */
+    virtual ~Sink() {
+    }
+
+    /**
+     * @brief Records a borrowed value.
+     *
+     * @param position Position of the value in the encoded message.
+     * @param data Pointer to the value.
+     * @param length Length of the value.
+     * @return true if recorded, false if the value must be copied.
+     */
+    virtual bool borrow(uint8_t *position, const uint8_t *data,
+            const uint32_t length) = 0;
+
+    /**
+     * @brief Gets the active sink.
+     *
+     * @return Reference to the pointer to the active sink, nullptr if none.
+     */
+    static Sink*& active() {
+        static Sink *sink = nullptr;
+        return sink;
+    }
+};
+
+/**
+ * @class BorrowedOctetStringBER
+ * @brief BER object to handle an octet string not owned.
+ *
+ * The value is neither allocated nor copied. It must stay valid until the
+ * message is sent. When a message is encoded by Segments::build(), the value
+ * is a segment of its own and is never copied in user space.
+ *
+ * Use it for large constant values: descriptions, blobs.
+ */
+class BorrowedOctetStringBER: public OctetStringBER {
+public:
+    /**
+     * @brief Creates a BorrowedOctetStringBER object.
+     *
+     * @param value Pointer to a null-terminated array of char, not copied.
+     */
+    BorrowedOctetStringBER(const char *value) :
+            BorrowedOctetStringBER(value, strlen(value)) {
+    }
+
+    /**
+     * @brief Creates a BorrowedOctetStringBER object.
+     *
+     * @param value Pointer to an array of char, not copied.
+     * @param length Value length.
+     */
+    BorrowedOctetStringBER(const char *value, const uint32_t length) :
+            OctetStringBER(Type::OctetString) {
+        _value = const_cast<char*>(value);
+        _length = length;
+    }
+
+    /**
+     * @brief BorrowedOctetStringBER destructor.
+     *
+     * The value is not released.
+     */
+    virtual ~BorrowedOctetStringBER() {
+        _value = nullptr;
+    }
+
+#if !SNMP_STREAM
+    /**
+     * @brief Encodes BorrowedOctetStringBER to memory buffer.
+     *
+     * If a sink is active, only type and length are encoded and the value is
+     * recorded by the sink.
+     *
+     * @param buffer Pointer to the buffer.
+     * @return Pointer after the encoded BER.
+     */
+    virtual uint8_t* encode(uint8_t *buffer) {
+        Sink *sink = Sink::active();
+        uint8_t *pointer = BER::encode(buffer);
+        if (sink && sink->borrow(pointer,
+                reinterpret_cast<const uint8_t*>(_value), _length)) {
+            return pointer;
+        }
+        memcpy(pointer, _value, _length);
+        return pointer + _length;
+    }
+#endif
+};
+
+/**
+ * @class Segments
+ * @brief Gather-write encoding of a message.
+ *
+ * The message is encoded as a list of segments: headers and small values are
+ * written in a scratch buffer, values of BorrowedOctetStringBER are pointers
+ * to their own buffer. On Linux, the list is sent with a single sendmsg().
+ *
+ * - A borrowed value takes 2 segments, the scratch before it and itself.
+ * - If the message needs more than N segments, it is encoded as a single
+ * segment, values are copied.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Segments<8> segments;
+ *
+ * void onMessage(const SNMP::Message *message, const IPAddress remote, const uint16_t port) {
+ *     SNMP::Message *response = new SNMP::Message(message->getVersion(),
+ *             message->getCommunity(), SNMP::Type::GetResponse);
+ *     response->setRequestID(message->getRequestID());
+ *     response->add(DESCRIPTION_OID,
+ *             new SNMP::BorrowedOctetStringBER(description, length));
+ *     if (segments.build(response)) {
+ *         segments.send(socket, remote, port);
+ *     }
+ *     delete response;
+ * }
+ * ```
+ *
+ * @warning With SNMP_STREAM set to 1, the message is always encoded as a single
+ * segment.
+ *
+ * @tparam N Maximum count of segments.
+ */
+template<const uint8_t N = 8>
+class Segments: public Sink {
+public:
+    /**
+     * @brief Segments destructor.
+     */
+    virtual ~Segments() {
+        free(_buffer);
+    }
+
+    /**
+     * @brief Encodes a message.
+     *
+     * Segments are valid until the next build, and borrowed values until
+     * the message is deleted.
+     *
+     * @note Like with SNMP::send(), a message is built once.
+     *
+     * @param message %SNMP message to encode.
+     * @return true if success, false if memory is exhausted.
+     */
+    bool build(Message *message) {
+        _count = 0;
+        _size = message->getSize(true);
+        free(_buffer);
+        _buffer = static_cast<uint8_t*>(malloc(_size));
+        if (!_buffer) {
+            return false;
+        }
+#if !SNMP_STREAM
+        _mark = _buffer;
+        _borrowed = 0;
+        _overflow = false;
+        Sink::active() = this;
+        message->build(_buffer);
+        Sink::active() = nullptr;
+        if (!_overflow) {
+            const uint32_t length = _buffer + _size - _borrowed - _mark;
+            if (length) {
+                append(_mark, length);
+            }
+            if (!_overflow) {
+                return true;
+            }
+        }
+        // Too many segments, values are copied
+        _count = 0;
+#endif
+        message->build(_buffer);
+        append(_buffer, _size);
+        return true;
+    }
+
+    /**
+     * @brief Gets the count of segments.
+     *
+     * @return Count of segments.
+     */
+    const uint8_t getCount() const {
+        return _count;
+    }
+
+    /**
+     * @brief Gets a segment data.
+     *
+     * @param index Index of the segment.
+     * @return Pointer to the segment data.
+     */
+    const uint8_t* getData(const uint8_t index) const {
+        return _segments[index]._data;
+    }
+
+    /**
+     * @brief Gets a segment length.
+     *
+     * @param index Index of the segment.
+     * @return Length of the segment.
+     */
+    const uint32_t getLength(const uint8_t index) const {
+        return _segments[index]._length;
+    }
+
+    /**
+     * @brief Gets the size of the encoded message.
+     *
+     * @return Size in bytes, sum of the segments lengths.
+     */
+    const uint32_t getSize() const {
+        return _size;
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    /**
+     * @brief Sends the segments as one datagram.
+     *
+     * @param socket UDP socket.
+     * @param ip IP address to send to.
+     * @param port UDP port to send to.
+     * @return Count of bytes sent, -1 on error.
+     */
+    ssize_t send(const int socket, const IPAddress ip, const uint16_t port) {
+        struct sockaddr_in address = { };
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl((static_cast<uint32_t>(ip[0]) << 24)
+                | (static_cast<uint32_t>(ip[1]) << 16)
+                | (static_cast<uint32_t>(ip[2]) << 8) | ip[3]);
+        struct iovec vectors[N];
+        for (uint8_t index = 0; index < _count; ++index) {
+            vectors[index].iov_base = const_cast<uint8_t*>(_segments[index]._data);
+            vectors[index].iov_len = _segments[index]._length;
+        }
+        struct msghdr header = { };
+        header.msg_name = &address;
+        header.msg_namelen = sizeof(address);
+        header.msg_iov = vectors;
+        header.msg_iovlen = _count;
+        return sendmsg(socket, &header, 0);
+    }
+#endif
+
+    /**
+     * @brief Records a borrowed value.
+     *
+     * The scratch before the value is closed as a segment. Following headers
+     * are written at the position of the value.
+     *
+     * @param position Position of the value in the scratch buffer.
+     * @param data Pointer to the value.
+     * @param length Length of the value.
+     * @return true if recorded, false if the value must be copied.
+     */
+    virtual bool borrow(uint8_t *position, const uint8_t *data,
+            const uint32_t length) {
+        if (_overflow || (_count + 2 > N)) {
+            // Encoding continues, done again in a single segment
+            _overflow = true;
+            return false;
+        }
+        if (position > _mark) {
+            append(_mark, position - _mark);
+        }
+        append(data, length);
+        _mark = position;
+        _borrowed += length;
+        return true;
+    }
+
+private:
+    /**
+     * @struct Segment
+     * @brief Contiguous part of the encoded message.
+     */
+    struct Segment {
+        /** Pointer to the data. */
+        const uint8_t *_data;
+        /** Length of the data. */
+        uint32_t _length;
+    };
+
+    /**
+     * @brief Appends a segment.
+     *
+     * @param data Pointer to the data.
+     * @param length Length of the data.
+     */
+    void append(const uint8_t *data, const uint32_t length) {
+        if (_count < N) {
+            _segments[_count++] = { data, length };
+        } else {
+            _overflow = true;
+        }
+    }
+
+    /** Scratch buffer. */
+    uint8_t *_buffer = nullptr;
+    /** Start of the scratch not yet in a segment. */
+    uint8_t *_mark = nullptr;
+    /** Size of the encoded message. */
+    uint32_t _size = 0;
+    /** Length of the borrowed values. */
+    uint32_t _borrowed = 0;
+    /** True if more than N segments are needed. */
+    bool _overflow = false;
+    /** Segments. */
+    Segment _segments[N];
+    /** Count of segments. */
+    uint8_t _count = 0;
+};
+
+} // namespace SNMP
+
+#endif /* SNMPSEGMENTS_H_ */
@@ -0,0 +1,833 @@
+#ifndef SNMPSIMULATOR_H_
+#define SNMPSIMULATOR_H_
+
+#include "SNMP.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+class SimulatedUDP;
+
+/**
+ * @class Simulator
+ * @brief Discrete event network simulator with a virtual clock.
+ *
+ * Datagrams sent through SimulatedUDP objects are scheduled for delivery
+ * after a simulated latency. Time is virtual: it only advances when step() or
+ * advance() is called, and jumps directly to the next delivery or to the next
+ * timer deadline of the SNMP objects added. Hours of polling can be replayed in
+ * seconds.
+ *
+ * - Latency, jitter and loss apply to all datagrams.
+ * - Service time applies to datagrams sent by a SimulatedUDP, see
+ * SimulatedUDP::setServiceTime().
+ * - Datagrams sent to no endpoint are counted as unreachable and dropped.
+ * - Random numbers are generated from a seed, so runs are reproducible.
+ *
+ * Once started with begin(), the simulator is the time source of the library.
+ * Timeouts, retries and rates of handlers such as Discovery or Campaign run on
+ * virtual time.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Simulator simulator;
+ * SNMP::SimulatedUDP managerUDP(simulator, IPAddress(10, 0, 0, 1));
+ * // One endpoint answers for 10.1.0.0/16
+ * SNMP::SimulatedUDP agentUDP(simulator, IPAddress(10, 1, 0, 0), IPAddress(255, 255, 0, 0));
+ *
+ * SNMP::Manager manager;
+ * SNMP::Agent agent;
+ *
+ * void setup() {
+ *     simulator.setLatency(20, 10);
+ *     simulator.setLoss(10);
+ *     agentUDP.setServiceTime(5);
+ *     simulator.begin();
+ *     simulator.add(manager);
+ *     manager.begin(managerUDP);
+ *     agent.begin(agentUDP);
+ *     // ...
+ * }
+ *
+ * void loop() {
+ *     manager.loop();
+ *     agent.loop();
+ *     simulator.step();
+ * }
+ * ```
+ */
+class Simulator {
+public:
+    /** Maximum datagram size, in bytes. */
+    static constexpr uint16_t MTU = 1472;
+
+    /**
+     * @brief Creates a Simulator object.
+     */
+    Simulator() {
+    }
+
+    /**
+     * @brief Simulator destructor.
+     *
+     * Stops the simulator and drops datagrams in flight.
+     */
+    ~Simulator() {
+        end();
+        while (_count) {
+            free(_heap[--_count]);
+        }
+        free(_heap);
+    }
+
+    /**
+     * @brief Starts the simulator.
+     *
+     * Sets the virtual clock as the time source of the library.
+     */
+    void begin() {
+        current() = this;
+        Clock::set(Simulator::millis);
+    }
+
+    /**
+     * @brief Stops the simulator.
+     *
+     * Restores Arduino millis() as the time source of the library.
+     */
+    void end() {
+        if (current() == this) {
+            current() = nullptr;
+            Clock::set(nullptr);
+        }
+    }
+
+    /**
+     * @brief Gets virtual time of the running simulator.
+     *
+     * @return Time in milliseconds.
+     */
+    static unsigned long millis() {
+        return current() ? current()->_now : 0;
+    }
+
+    /**
+     * @brief Gets virtual time.
+     *
+     * @return Time in milliseconds.
+     */
+    const unsigned long getTime() const {
+        return _now;
+    }
+
+    /**
+     * @brief Sets latency.
+     *
+     * Each datagram is delivered after latency plus a random delay up to
+     * jitter. Jitter may reorder datagrams.
+     *
+     * @param latency Latency in milliseconds.
+     * @param jitter Maximum jitter in milliseconds.
+     */
+    void setLatency(const uint16_t latency, const uint16_t jitter = 0) {
+        _latency = latency;
+        _jitter = jitter;
+    }
+
+    /**
+     * @brief Sets loss rate.
+     *
+     * @param loss Loss rate in per mille.
+     */
+    void setLoss(const uint16_t loss) {
+        _loss = loss;
+    }
+
+    /**
+     * @brief Adds an SNMP object whose timers bound step().
+     *
+     * @param snmp SNMP object, a manager or an agent.
+     * @return true if success, false if too many objects are added.
+     */
+    bool add(SNMP &snmp) {
+        for (uint8_t index = 0; index < OBJECTS; ++index) {
+            if (_objects[index] == &snmp) {
+                return true;
+            }
+            if (!_objects[index]) {
+                _objects[index] = &snmp;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Sets the time step of step() when idle.
+     *
+     * Time based handlers only run when their loop() is called. The resolution
+     * bounds how late they may run when no datagram is in flight and no timer
+     * is armed.
+     *
+     * @param resolution Resolution in milliseconds.
+     */
+    void setResolution(const uint16_t resolution) {
+        _resolution = resolution ? resolution : 1;
+    }
+
+    /**
+     * @brief Sets the seed of the random number generator.
+     *
+     * @param seed Seed, must not be 0.
+     */
+    void setSeed(const uint32_t seed) {
+        _seed = seed ? seed : SEED;
+    }
+
+    /**
+     * @brief Checks if a datagram is in flight.
+     *
+     * @param time Set to the delivery time of the next datagram.
+     * @return true if a datagram is in flight, false otherwise.
+     */
+    bool next(unsigned long &time) const {
+        if (_count) {
+            time = _heap[0]->_time;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Advances virtual time to the next event.
+     *
+     * Datagrams already due are delivered, then time jumps to the next delivery
+     * or to the next timer deadline of the SNMP objects added, whichever comes
+     * first, and datagrams due are delivered. When idle, time advances by
+     * resolution. Time always advances, even if datagrams are sent without
+     * latency on every step.
+     */
+    void step() {
+        advance(_now);
+        unsigned long delay = 0xFFFFFFFF;
+        if (_count) {
+            delay = _heap[0]->_time - _now;
+        }
+        for (uint8_t index = 0; (index < OBJECTS) && _objects[index]; ++index) {
+            const unsigned long deadline = _objects[index]->nextDeadline();
+            if (deadline < delay) {
+                delay = deadline;
+            }
+        }
+        if (delay == 0xFFFFFFFF) {
+            delay = _resolution;
+        }
+        advance(_now + (delay ? delay : 1));
+    }
+
+    /**
+     * @brief Advances virtual time.
+     *
+     * All datagrams due are delivered.
+     *
+     * @param time Virtual time in milliseconds, ignored if in the past.
+     */
+    void advance(const unsigned long time) {
+        if (static_cast<long>(time - _now) > 0) {
+            _now = time;
+        }
+        while (_count && (static_cast<long>(_heap[0]->_time - _now) <= 0)) {
+            deliver(pop());
+        }
+    }
+
+    /**
+     * @brief Gets the count of datagrams sent.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getSent() const {
+        return _sent;
+    }
+
+    /**
+     * @brief Gets the count of datagrams delivered.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getDelivered() const {
+        return _delivered;
+    }
+
+    /**
+     * @brief Gets the count of datagrams lost.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getLost() const {
+        return _lost;
+    }
+
+    /**
+     * @brief Gets the count of datagrams sent to no endpoint.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getUnreachable() const {
+        return _unreachable;
+    }
+
+    /**
+     * @brief Gets the count of datagrams dropped by a full receive queue.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getOverflow() const {
+        return _overflow;
+    }
+
+    /**
+     * @brief Gets the count of datagrams in flight.
+     *
+     * @return Count of datagrams.
+     */
+    const uint32_t getInFlight() const {
+        return _count;
+    }
+
+private:
+    /** Default seed of the random number generator. */
+    static constexpr uint32_t SEED = 2463534242;
+    /** Maximum count of SNMP objects added. */
+    static constexpr uint8_t OBJECTS = 4;
+
+    /**
+     * @struct Packet
+     * @brief Datagram in flight or in a receive queue.
+     *
+     * Data follows the structure in the same allocation. Addresses are stored
+     * as bytes, the structure is allocated with malloc().
+     */
+    struct Packet {
+        /** Next datagram in the receive queue. */
+        Packet *_next;
+        /** Delivery time. */
+        unsigned long _time;
+        /** Send order, to deliver datagrams due at the same time in order. */
+        uint32_t _sequence;
+        /** Source address. */
+        uint8_t _source[4];
+        /** Destination address. */
+        uint8_t _destination[4];
+        /** Source port. */
+        uint16_t _sourcePort;
+        /** Destination port. */
+        uint16_t _destinationPort;
+        /** Length of data. */
+        uint16_t _length;
+
+        /**
+         * @brief Gets data.
+         *
+         * @return Pointer to data.
+         */
+        uint8_t* data() {
+            return reinterpret_cast<uint8_t*>(this + 1);
+        }
+    };
+
+    /**
+     * @brief Gets the running simulator.
+     *
+     * @return Reference to pointer to the running simulator.
+     */
+    static Simulator*& current() {
+        static Simulator *simulator = nullptr;
+        return simulator;
+    }
+
+    /**
+     * @brief Generates a random number.
+     *
+     * @return Random number.
+     */
+    uint32_t random() {
+        _seed ^= _seed << 13;
+        _seed ^= _seed >> 17;
+        _seed ^= _seed << 5;
+        return _seed;
+    }
+
+    /**
+     * @brief Schedules a datagram.
+     *
+     * @param source Source address.
+     * @param sourcePort Source port.
+     * @param data Pointer to data.
+     * @param length Length of data.
+     * @param destination Destination address.
+     * @param port Destination port.
+     * @param delay Delay added to latency, in milliseconds.
+     * @return true if the datagram is scheduled or lost, false if out of
+     * memory.
+     */
+    bool send(const IPAddress source, const uint16_t sourcePort,
+            const uint8_t *data, const uint16_t length,
+            const IPAddress destination, const uint16_t port,
+            const unsigned long delay) {
+        _sent++;
+        if (_loss && ((random() % 1000) < _loss)) {
+            _lost++;
+            return true;
+        }
+        if ((_count == _capacity) && !grow()) {
+            return false;
+        }
+        Packet *packet = static_cast<Packet*>(malloc(sizeof(Packet) + length));
+        if (!packet) {
+            return false;
+        }
+        packet->_next = nullptr;
+        packet->_time = _now + delay + _latency
+                + (_jitter ? random() % (_jitter + 1) : 0);
+        packet->_sequence = _sequence++;
+        for (uint8_t index = 0; index < 4; ++index) {
+            packet->_source[index] = source[index];
+            packet->_destination[index] = destination[index];
+        }
+        packet->_sourcePort = sourcePort;
+        packet->_destinationPort = port;
+        packet->_length = length;
+        memcpy(packet->data(), data, length);
+        push(packet);
+        return true;
+    }
+
+    /**
+     * @brief Grows the heap of datagrams in flight.
+     *
+     * @return true if success, false if out of memory.
+     */
+    bool grow() {
+        const uint32_t capacity = _capacity ? _capacity * 2 : 16;
+        Packet **heap = static_cast<Packet**>(realloc(_heap,
+                capacity * sizeof(Packet*)));
+        if (!heap) {
+            return false;
+        }
+        _heap = heap;
+        _capacity = capacity;
+        return true;
+    }
+
+    /**
+     * @brief Compares delivery order of two datagrams.
+     *
+     * @return true if a is delivered before b.
+     */
+    static bool before(const Packet *a, const Packet *b) {
+        const long difference = static_cast<long>(a->_time - b->_time);
+        return difference ?
+                difference < 0 :
+                static_cast<int32_t>(a->_sequence - b->_sequence) < 0;
+    }
+
+    /**
+     * @brief Adds a datagram to the heap.
+     *
+     * @param packet Datagram to add.
+     */
+    void push(Packet *packet) {
+        uint32_t index = _count++;
+        while (index) {
+            const uint32_t parent = (index - 1) / 2;
+            if (!before(packet, _heap[parent])) {
+                break;
+            }
+            _heap[index] = _heap[parent];
+            index = parent;
+        }
+        _heap[index] = packet;
+    }
+
+    /**
+     * @brief Removes the next datagram from the heap.
+     *
+     * @return Next datagram.
+     */
+    Packet* pop() {
+        Packet *first = _heap[0];
+        Packet *last = _heap[--_count];
+        uint32_t index = 0;
+        while (true) {
+            uint32_t child = 2 * index + 1;
+            if (child >= _count) {
+                break;
+            }
+            if ((child + 1 < _count) && before(_heap[child + 1], _heap[child])) {
+                child++;
+            }
+            if (!before(_heap[child], last)) {
+                break;
+            }
+            _heap[index] = _heap[child];
+            index = child;
+        }
+        _heap[index] = last;
+        return first;
+    }
+
+    /**
+     * @brief Delivers a datagram to its endpoint.
+     *
+     * @param packet Datagram to deliver.
+     */
+    inline void deliver(Packet *packet);
+
+    /** Virtual time in milliseconds. */
+    unsigned long _now = 0;
+    /** Latency in milliseconds. */
+    uint16_t _latency = 0;
+    /** Maximum jitter in milliseconds. */
+    uint16_t _jitter = 0;
+    /** Loss rate in per mille. */
+    uint16_t _loss = 0;
+    /** Time step of step() when idle, in milliseconds. */
+    uint16_t _resolution = 1;
+    /** State of the random number generator. */
+    uint32_t _seed = SEED;
+    /** Send order of the next datagram. */
+    uint32_t _sequence = 0;
+    /** Heap of datagrams in flight, ordered by delivery time. */
+    Packet **_heap = nullptr;
+    /** Count of datagrams in flight. */
+    uint32_t _count = 0;
+    /** Capacity of the heap. */
+    uint32_t _capacity = 0;
+    /** SNMP objects whose timers bound step(). */
+    SNMP *_objects[OBJECTS] = { };
+    /** Endpoints bound to a port. */
+    SimulatedUDP *_endpoints = nullptr;
+    /** Count of datagrams sent. */
+    uint32_t _sent = 0;
+    /** Count of datagrams delivered. */
+    uint32_t _delivered = 0;
+    /** Count of datagrams lost. */
+    uint32_t _lost = 0;
+    /** Count of datagrams sent to no endpoint. */
+    uint32_t _unreachable = 0;
+    /** Count of datagrams dropped by a full receive queue. */
+    uint32_t _overflow = 0;
+
+    friend class SimulatedUDP;
+};
+
+/**
+ * @class SimulatedUDP
+ * @brief UDP endpoint of a Simulator.
+ *
+ * An endpoint receives datagrams sent to its address and port. With a mask,
+ * one endpoint answers for a whole subnet: a single Agent can then simulate
+ * thousands of agents. Datagrams sent in reply use the address the last
+ * datagram was received on as source.
+ */
+class SimulatedUDP: public UDP {
+public:
+    /**
+     * @brief Creates a SimulatedUDP object.
+     *
+     * @param simulator Simulator of the endpoint.
+     * @param address IP address of the endpoint.
+     * @param mask Mask of the addresses the endpoint answers for.
+     */
+    SimulatedUDP(Simulator &simulator, const IPAddress address,
+            const IPAddress mask = IPAddress(255, 255, 255, 255)) :
+            _simulator(simulator), _address(address), _mask(mask), _local(
+                    address) {
+    }
+
+    /**
+     * @brief SimulatedUDP destructor.
+     */
+    virtual ~SimulatedUDP() {
+        stop();
+        free(_output);
+    }
+
+    /**
+     * @brief Sets the service time.
+     *
+     * Service time is added to the latency of each datagram sent by the
+     * endpoint. It simulates the time an agent takes to answer.
+     *
+     * @param time Service time in milliseconds.
+     * @param jitter Maximum random service time added, in milliseconds.
+     */
+    void setServiceTime(const uint16_t time, const uint16_t jitter = 0) {
+        _service = time;
+        _serviceJitter = jitter;
+    }
+
+    /**
+     * @brief Sets the receive queue size.
+     *
+     * Datagrams delivered to a full receive queue are dropped.
+     *
+     * @param size Maximum count of datagrams queued, 0 for no limit.
+     */
+    void setQueueSize(const uint16_t size) {
+        _size = size;
+    }
+
+    /**
+     * @brief Gets the count of datagrams in the receive queue.
+     *
+     * @return Count of datagrams.
+     */
+    const uint16_t getQueued() const {
+        return _queued;
+    }
+
+    virtual uint8_t begin(uint16_t port) {
+        stop();
+        _port = port;
+        _next = _simulator._endpoints;
+        _simulator._endpoints = this;
+        _bound = true;
+        return 1;
+    }
+
+    virtual void stop() {
+        if (_bound) {
+            SimulatedUDP **endpoint = &_simulator._endpoints;
+            while (*endpoint != this) {
+                endpoint = &(*endpoint)->_next;
+            }
+            *endpoint = _next;
+            _bound = false;
+        }
+        while (_head) {
+            Simulator::Packet *packet = _head;
+            _head = packet->_next;
+            free(packet);
+        }
+        _tail = nullptr;
+        _queued = 0;
+        free(_input);
+        _input = nullptr;
+    }
+
+    virtual int beginPacket(IPAddress ip, uint16_t port) {
+        if (!_output) {
+            _output = static_cast<uint8_t*>(malloc(Simulator::MTU));
+            if (!_output) {
+                return 0;
+            }
+        }
+        _remote = ip;
+        _remotePort = port;
+        _length = 0;
+        _overrun = false;
+        return 1;
+    }
+
+    virtual int beginPacket(const char *host, uint16_t port) {
+        return 0;
+    }
+
+    virtual int endPacket() {
+        if (!_output || _overrun) {
+            return 0;
+        }
+        const unsigned long delay = _service
+                + (_serviceJitter ?
+                        _simulator.random() % (_serviceJitter + 1) : 0);
+        return _simulator.send(_local, _port, _output, _length, _remote,
+                _remotePort, delay);
+    }
+
+    virtual size_t write(uint8_t byte) {
+        if (_output && (_length < Simulator::MTU)) {
+            _output[_length++] = byte;
+            return 1;
+        }
+        _overrun = true;
+        return 0;
+    }
+
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t count = 0;
+        while (size-- && write(*buffer++)) {
+            count++;
+        }
+        return count;
+    }
+
+    virtual int parsePacket() {
+        free(_input);
+        _input = _head;
+        if (!_input) {
+            return 0;
+        }
+        _head = _input->_next;
+        if (!_head) {
+            _tail = nullptr;
+        }
+        _queued--;
+        _position = 0;
+        _local = IPAddress(_input->_destination);
+        return _input->_length;
+    }
+
+    virtual int available() {
+        return _input ? _input->_length - _position : 0;
+    }
+
+    virtual int read() {
+        return _input && (_position < _input->_length) ?
+                _input->data()[_position++] : -1;
+    }
+
+    virtual int read(unsigned char *buffer, size_t length) {
+        size_t count = 0;
+        while ((count < length) && (available() > 0)) {
+            buffer[count++] = _input->data()[_position++];
+        }
+        return count;
+    }
+
+    virtual int read(char *buffer, size_t length) {
+        return read(reinterpret_cast<unsigned char*>(buffer), length);
+    }
+
+    virtual int peek() {
+        return _input && (_position < _input->_length) ?
+                _input->data()[_position] : -1;
+    }
+
+    virtual void flush() {
+    }
+
+    virtual IPAddress remoteIP() {
+        return _input ? IPAddress(_input->_source) : IPAddress();
+    }
+
+    virtual uint16_t remotePort() {
+        return _input ? _input->_sourcePort : 0;
+    }
+
+private:
+    /**
+     * @brief Checks if the endpoint receives a datagram.
+     *
+     * @param address Destination address.
+     * @param port Destination port.
+     * @return true if the endpoint receives the datagram, false otherwise.
+     */
+    bool accept(const uint8_t *address, const uint16_t port) const {
+        if (port != _port) {
+            return false;
+        }
+        for (uint8_t index = 0; index < 4; ++index) {
+            if ((address[index] & _mask[index])
+                    != (_address[index] & _mask[index])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Adds a datagram to the receive queue.
+     *
+     * @param packet Datagram to add.
+     * @return true if queued, false if the queue is full.
+     */
+    bool enqueue(Simulator::Packet *packet) {
+        if (_size && (_queued >= _size)) {
+            return false;
+        }
+        packet->_next = nullptr;
+        if (_tail) {
+            _tail->_next = packet;
+        } else {
+            _head = packet;
+        }
+        _tail = packet;
+        _queued++;
+        return true;
+    }
+
+    /** Simulator of the endpoint. */
+    Simulator &_simulator;
+    /** IP address of the endpoint. */
+    IPAddress _address;
+    /** Mask of the addresses the endpoint answers for. */
+    IPAddress _mask;
+    /** Address the last datagram was received on. */
+    IPAddress _local;
+    /** Bound port. */
+    uint16_t _port = 0;
+    /** true if bound to a port. */
+    bool _bound = false;
+    /** Next bound endpoint. */
+    SimulatedUDP *_next = nullptr;
+    /** Service time in milliseconds. */
+    uint16_t _service = 0;
+    /** Maximum random service time added, in milliseconds. */
+    uint16_t _serviceJitter = 0;
+    /** Maximum count of datagrams queued, 0 for no limit. */
+    uint16_t _size = 0;
+    /** Count of datagrams queued. */
+    uint16_t _queued = 0;
+    /** First datagram of the receive queue. */
+    Simulator::Packet *_head = nullptr;
+    /** Last datagram of the receive queue. */
+    Simulator::Packet *_tail = nullptr;
+    /** Datagram being read. */
+    Simulator::Packet *_input = nullptr;
+    /** Position of the next byte to read. */
+    uint16_t _position = 0;
+    /** Buffer of the datagram being written. */
+    uint8_t *_output = nullptr;
+    /** Length of the datagram being written. */
+    uint16_t _length = 0;
+    /** true if the datagram being written is larger than MTU. */
+    bool _overrun = false;
+    /** Destination address of the datagram being written. */
+    IPAddress _remote;
+    /** Destination port of the datagram being written. */
+    uint16_t _remotePort = 0;
+
+    friend class Simulator;
+};
+
+/**
+ * @brief Delivers a datagram to its endpoint.
+ *
+ * @param packet Datagram to deliver.
+ */
+void Simulator::deliver(Packet *packet) {
+    for (SimulatedUDP *endpoint = _endpoints; endpoint;
+            endpoint = endpoint->_next) {
+        if (endpoint->accept(packet->_destination, packet->_destinationPort)) {
+            if (endpoint->enqueue(packet)) {
+                _delivered++;
+            } else {
+                _overflow++;
+                free(packet);
+            }
+            return;
+        }
+    }
+    _unreachable++;
+    free(packet);
+}
+
+}  // namespace SNMP
+
+#endif /* SNMPSIMULATOR_H_ */
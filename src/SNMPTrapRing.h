@@ -0,0 +1,283 @@
+#ifndef SNMPTRAPRING_H_
+#define SNMPTRAPRING_H_
+
+#include "SNMP.h"
+
+/**
+ * @namespace SNMP
+ * @brief %SNMP library namespace.
+ */
+namespace SNMP {
+
+/**
+ * @class TrapRing
+ * @brief Traps raised from interrupt handlers.
+ *
+ * Building a message allocates memory and can not be done in an interrupt
+ * handler. raise() only records a compact descriptor in a preallocated ring:
+ * trap index, up to V integer values and a timestamp. No allocation, no
+ * library call. SNMP::loop() encodes and sends the SNMPV2TRAP messages later.
+ *
+ * - Traps are declared in a table. A trap has an snmpTrapOID.0 value and the
+ * OIDs of its variable bindings.
+ * - When the ring is full, the trap is dropped and counted.
+ * - sysUpTime.0 is the timestamp given to raise(), in milliseconds, or the
+ * time the trap is sent if none.
+ *
+ * Example
+ *
+ * ```cpp
+ * SNMP::Agent snmp;
+ * SNMP::TrapRing<8> traps(snmp);
+ *
+ * const SNMP::TrapRing<8>::Trap TRAPS[] = {
+ *         { "1.3.6.1.4.1.65000.0.1", { "1.3.6.1.4.1.65000.1.1.0" } },
+ * };
+ *
+ * void onOvercurrent() {
+ *     int32_t current = analogRead(A0);
+ *     traps.raise(0, &current, 1);
+ * }
+ *
+ * void setup() {
+ *     // ...
+ *     traps.begin(TRAPS, 1, IPAddress(192, 168, 2, 1));
+ *     attachInterrupt(digitalPinToInterrupt(2), onOvercurrent, RISING);
+ * }
+ * ```
+ *
+ * @warning The ring has a single producer. Raise traps from interrupt
+ * handlers of the same priority, which do not preempt each other, or from the
+ * main program with interrupts disabled.
+ *
+ * @tparam N Count of descriptors, a power of 2 up to 128.
+ * @tparam V Maximum count of values of a trap.
+ */
+template<const uint8_t N, const uint8_t V = 2>
+class TrapRing: public Handler {
+    static_assert(N && !(N & (N - 1)) && (N <= 128),
+            "N must be a power of 2 up to 128");
+
+public:
+    /**
+     * @struct Trap
+     * @brief Declaration of a trap.
+     */
+    struct Trap {
+        /** snmpTrapOID.0 value. */
+        const char *_oid;
+        /** OIDs of the variable bindings. */
+        const char *_names[V];
+    };
+
+    /**
+     * @brief Creates a TrapRing object.
+     *
+     * @param agent %SNMP agent used to send traps.
+     */
+    TrapRing(Agent &agent) :
+            _agent(agent) {
+    }
+
+    /**
+     * @brief TrapRing destructor.
+     */
+    virtual ~TrapRing() {
+        stop();
+    }
+
+    /**
+     * @brief Starts sending traps from SNMP::loop().
+     *
+     * @param traps Table of traps, not copied.
+     * @param count Count of traps.
+     * @param destination IP address of the manager.
+     * @param port UDP port of the manager.
+     */
+    void begin(const Trap *traps, const uint8_t count,
+            const IPAddress destination, const uint16_t port = Port::Trap) {
+        _traps = traps;
+        _count = count;
+        _destination = destination;
+        _port = port;
+        if (!_running) {
+            _agent.attach(*this);
+            _running = true;
+        }
+    }
+
+    /**
+     * @brief Stops sending traps.
+     *
+     * Traps still in the ring are kept.
+     */
+    void stop() {
+        if (_running) {
+            _agent.detach(*this);
+            _running = false;
+        }
+    }
+
+    /**
+     * @brief Sets the community of traps.
+     *
+     * @param community %SNMP community, not copied.
+     */
+    void setCommunity(const char *community) {
+        _community = community;
+    }
+
+    /**
+     * @brief Raises a trap.
+     *
+     * Safe to call from an interrupt handler.
+     *
+     * @param trap Index of the trap in the table.
+     * @param values Values of the variable bindings, copied.
+     * @param count Count of values, V at most.
+     * @param time Timestamp in milliseconds, 0 to use the time the trap is
+     * sent.
+     * @return true if recorded, false if the ring is full.
+     */
+    bool raise(const uint8_t trap, const int32_t *values = nullptr,
+            const uint8_t count = 0, const unsigned long time = 0) {
+        const uint8_t head = _head;
+        if (static_cast<uint8_t>(head - _tail) == N) {
+            _overflow++;
+            return false;
+        }
+        Descriptor &descriptor = _descriptors[head & (N - 1)];
+        descriptor._trap = trap;
+        descriptor._count = count < V ? count : V;
+        descriptor._time = time;
+        for (uint8_t index = 0; index < descriptor._count; ++index) {
+            descriptor._values[index] = values[index];
+        }
+        // Descriptor is written before it is published
+        barrier();
+        _head = head + 1;
+        return true;
+    }
+
+    /**
+     * @brief Gets the count of traps sent.
+     *
+     * @return Count of traps.
+     */
+    const uint32_t getSent() const {
+        return _sent;
+    }
+
+    /**
+     * @brief Gets the count of traps dropped because the ring was full.
+     *
+     * Updated by SNMP::loop().
+     *
+     * @return Count of traps.
+     */
+    const uint32_t getDropped() const {
+        return _dropped;
+    }
+
+    /**
+     * @brief Processes pending work.
+     *
+     * Sends the traps recorded in the ring.
+     */
+    virtual void loop() {
+        // 8 bits counters are read atomically
+        const uint8_t overflow = _overflow;
+        _dropped += static_cast<uint8_t>(overflow - _seen);
+        _seen = overflow;
+        while (_tail != _head) {
+            barrier();
+            const Descriptor descriptor = _descriptors[_tail & (N - 1)];
+            // Descriptor is copied before the slot is released
+            barrier();
+            _tail = _tail + 1;
+            if (descriptor._trap < _count) {
+                send(descriptor);
+            }
+        }
+    }
+
+private:
+    /**
+     * @struct Descriptor
+     * @brief Trap recorded in the ring.
+     */
+    struct Descriptor {
+        /** Timestamp in milliseconds. */
+        unsigned long _time;
+        /** Values of the variable bindings. */
+        int32_t _values[V];
+        /** Index of the trap. */
+        uint8_t _trap;
+        /** Count of values. */
+        uint8_t _count;
+    };
+
+    /**
+     * @brief Prevents the compiler from reordering memory accesses.
+     */
+    static inline void barrier() {
+        asm volatile("" ::: "memory");
+    }
+
+    /**
+     * @brief Encodes and sends a trap.
+     *
+     * @param descriptor Trap recorded.
+     */
+    void send(const Descriptor &descriptor) {
+        const Trap &trap = _traps[descriptor._trap];
+        Message *message = new Message(Version::V2C, _community,
+                Type::SNMPv2Trap);
+        const unsigned long time =
+                descriptor._time ? descriptor._time : Clock::millis();
+        message->setSNMPTrapOID(trap._oid, time / 10);
+        for (uint8_t index = 0; index < descriptor._count; ++index) {
+            if (trap._names[index]) {
+                message->add(trap._names[index],
+                        new IntegerBER(descriptor._values[index]));
+            }
+        }
+        if (_agent.send(message, _destination, _port)) {
+            _sent++;
+        }
+        delete message;
+    }
+
+    /** %SNMP agent. */
+    Agent &_agent;
+    /** True if attached. */
+    bool _running = false;
+    /** Table of traps. */
+    const Trap *_traps = nullptr;
+    /** Count of traps in the table. */
+    uint8_t _count = 0;
+    /** IP address of the manager. */
+    IPAddress _destination;
+    /** UDP port of the manager. */
+    uint16_t _port = Port::Trap;
+    /** Community of traps. */
+    const char *_community = "public";
+    /** Descriptors. */
+    Descriptor _descriptors[N];
+    /** Position of the next descriptor to write, owned by the producer. */
+    volatile uint8_t _head = 0;
+    /** Position of the next descriptor to send, owned by the consumer. */
+    volatile uint8_t _tail = 0;
+    /** Count of overflows, owned by the producer. */
+    volatile uint8_t _overflow = 0;
+    /** Count of overflows already counted in dropped. */
+    uint8_t _seen = 0;
+    /** Count of traps sent. */
+    uint32_t _sent = 0;
+    /** Count of traps dropped. */
+    uint32_t _dropped = 0;
+};
+
+} // namespace SNMP
+
+#endif /* SNMPTRAPRING_H_ */